@@ -197,6 +197,9 @@ HEADERS += src/outcome.h
 SOURCES += src/meshresultpostprocessor.cpp
 HEADERS += src/meshresultpostprocessor.h
 
+SOURCES += src/headlessexporter.cpp
+HEADERS += src/headlessexporter.h
+
 SOURCES += src/logbrowser.cpp
 HEADERS += src/logbrowser.h
 
@@ -424,6 +427,45 @@ HEADERS += src/imagepreviewwidget.h
 SOURCES += src/mousepicker.cpp
 HEADERS += src/mousepicker.h
 
+SOURCES += src/mousepickindex.cpp
+HEADERS += src/mousepickindex.h
+
+SOURCES += src/aabbtree.cpp
+HEADERS += src/aabbtree.h
+
+SOURCES += src/historysnapshot.cpp
+HEADERS += src/historysnapshot.h
+
+SOURCES += src/meshdiskcache.cpp
+HEADERS += src/meshdiskcache.h
+
+SOURCES += src/microbenchmark.cpp
+HEADERS += src/microbenchmark.h
+
+SOURCES += src/triangletopology.cpp
+HEADERS += src/triangletopology.h
+
+SOURCES += src/optimizevertexcache.cpp
+HEADERS += src/optimizevertexcache.h
+
+SOURCES += src/linearblendskinning.cpp
+HEADERS += src/linearblendskinning.h
+
+SOURCES += src/clothcollision.cpp
+HEADERS += src/clothcollision.h
+
+SOURCES += src/motionframetrack.cpp
+HEADERS += src/motionframetrack.h
+
+SOURCES += src/profiler.cpp
+HEADERS += src/profiler.h
+
+SOURCES += src/pipelinebenchmark.cpp
+HEADERS += src/pipelinebenchmark.h
+
+SOURCES += src/jobscheduler.cpp
+HEADERS += src/jobscheduler.h
+
 SOURCES += src/paintmode.cpp
 HEADERS += src/paintmode.h
 
@@ -822,6 +864,7 @@ INCLUDEPATH += thirdparty/json
 win32 {
     LIBS += -luser32
 	LIBS += -lopengl32
+	LIBS += -lpsapi
 
 	isEmpty(BOOST_INCLUDEDIR) {
 		BOOST_INCLUDEDIR = $$(BOOST_INCLUDEDIR)
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include "aabbtree.h"
+
+void AabbTree::Box::update(const QVector3D &position)
+{
+    for (int i = 0; i < 3; ++i) {
+        if (position[i] < lower[i])
+            lower[i] = position[i];
+        if (position[i] > upper[i])
+            upper[i] = position[i];
+    }
+}
+
+void AabbTree::Box::merge(const Box &other)
+{
+    update(other.lower);
+    update(other.upper);
+}
+
+bool AabbTree::Box::intersects(const Box &other) const
+{
+    for (int i = 0; i < 3; ++i) {
+        if (upper[i] < other.lower[i] || lower[i] > other.upper[i])
+            return false;
+    }
+    return true;
+}
+
+bool AabbTree::Box::intersectsSegment(const QVector3D &from, const QVector3D &to) const
+{
+    float enter = 0.0f;
+    float leave = 1.0f;
+    auto direction = to - from;
+    for (int i = 0; i < 3; ++i) {
+        if (std::abs(direction[i]) < std::numeric_limits<float>::epsilon()) {
+            if (from[i] < lower[i] || from[i] > upper[i])
+                return false;
+            continue;
+        }
+        float inverse = 1.0f / direction[i];
+        float near = (lower[i] - from[i]) * inverse;
+        float far = (upper[i] - from[i]) * inverse;
+        if (near > far)
+            std::swap(near, far);
+        enter = std::max(enter, near);
+        leave = std::min(leave, far);
+        if (enter > leave)
+            return false;
+    }
+    return true;
+}
+
+AabbTree::Box AabbTree::Box::expanded(float distance) const
+{
+    Box box = *this;
+    box.lower -= QVector3D(distance, distance, distance);
+    box.upper += QVector3D(distance, distance, distance);
+    return box;
+}
+
+AabbTree::AabbTree(const std::vector<Box> &boxes, size_t maxLeafSize) :
+    m_boxes(boxes),
+    m_maxLeafSize(std::max(maxLeafSize, (size_t)1))
+{
+    if (m_boxes.empty())
+        return;
+    m_indices.resize(m_boxes.size());
+    for (size_t i = 0; i < m_indices.size(); ++i)
+        m_indices[i] = i;
+    m_nodes.reserve(m_boxes.size() * 2 / m_maxLeafSize + 1);
+    build(0, m_indices.size());
+}
+
+bool AabbTree::isEmpty() const
+{
+    return m_nodes.empty();
+}
+
+size_t AabbTree::build(size_t begin, size_t end)
+{
+    size_t nodeIndex = m_nodes.size();
+    m_nodes.push_back(Node());
+
+    Box box = m_boxes[m_indices[begin]];
+    Box centerBox;
+    centerBox.lower = centerBox.upper = (box.lower + box.upper) * 0.5f;
+    for (size_t i = begin + 1; i < end; ++i) {
+        const auto &it = m_boxes[m_indices[i]];
+        box.merge(it);
+        centerBox.update((it.lower + it.upper) * 0.5f);
+    }
+    m_nodes[nodeIndex].box = box;
+    m_nodes[nodeIndex].begin = begin;
+    m_nodes[nodeIndex].end = end;
+    if (end - begin <= m_maxLeafSize)
+        return nodeIndex;
+
+    // Split at the median of the longest axis of the box centers
+    auto extent = centerBox.upper - centerBox.lower;
+    int axis = 0;
+    if (extent[1] > extent[axis])
+        axis = 1;
+    if (extent[2] > extent[axis])
+        axis = 2;
+    size_t middle = begin + (end - begin) / 2;
+    std::nth_element(m_indices.begin() + begin, m_indices.begin() + middle, m_indices.begin() + end,
+            [&](size_t first, size_t second) {
+        return m_boxes[first].lower[axis] + m_boxes[first].upper[axis] <
+            m_boxes[second].lower[axis] + m_boxes[second].upper[axis];
+    });
+
+    size_t left = build(begin, middle);
+    size_t right = build(middle, end);
+    m_nodes[nodeIndex].left = left;
+    m_nodes[nodeIndex].right = right;
+    return nodeIndex;
+}
+
+void AabbTree::querySegment(const QVector3D &from, const QVector3D &to, std::vector<size_t> *indices) const
+{
+    if (m_nodes.empty())
+        return;
+    std::vector<size_t> stack = {0};
+    while (!stack.empty()) {
+        const auto &node = m_nodes[stack.back()];
+        stack.pop_back();
+        if (!node.box.intersectsSegment(from, to))
+            continue;
+        if (node.isLeaf()) {
+            for (size_t i = node.begin; i < node.end; ++i) {
+                size_t index = m_indices[i];
+                if (m_boxes[index].intersectsSegment(from, to))
+                    indices->push_back(index);
+            }
+            continue;
+        }
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+    }
+}
+
+void AabbTree::queryBox(const Box &box, std::vector<size_t> *indices) const
+{
+    if (m_nodes.empty())
+        return;
+    std::vector<size_t> stack = {0};
+    while (!stack.empty()) {
+        const auto &node = m_nodes[stack.back()];
+        stack.pop_back();
+        if (!node.box.intersects(box))
+            continue;
+        if (node.isLeaf()) {
+            for (size_t i = node.begin; i < node.end; ++i) {
+                size_t index = m_indices[i];
+                if (m_boxes[index].intersects(box))
+                    indices->push_back(index);
+            }
+            continue;
+        }
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+    }
+}
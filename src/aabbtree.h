@@ -0,0 +1,48 @@
+#ifndef DUST3D_AABB_TREE_H
+#define DUST3D_AABB_TREE_H
+#include <QVector3D>
+#include <vector>
+
+class AabbTree
+{
+public:
+    struct Box
+    {
+        QVector3D lower;
+        QVector3D upper;
+
+        void update(const QVector3D &position);
+        void merge(const Box &other);
+        bool intersects(const Box &other) const;
+        bool intersectsSegment(const QVector3D &from, const QVector3D &to) const;
+        Box expanded(float distance) const;
+    };
+
+    AabbTree(const std::vector<Box> &boxes, size_t maxLeafSize=4);
+    bool isEmpty() const;
+    void querySegment(const QVector3D &from, const QVector3D &to, std::vector<size_t> *indices) const;
+    void queryBox(const Box &box, std::vector<size_t> *indices) const;
+
+private:
+    struct Node
+    {
+        Box box;
+        size_t left = 0;
+        size_t right = 0;
+        size_t begin = 0;
+        size_t end = 0;
+        bool isLeaf() const
+        {
+            return 0 == left && 0 == right;
+        }
+    };
+
+    std::vector<Box> m_boxes;
+    std::vector<size_t> m_indices;
+    std::vector<Node> m_nodes;
+    size_t m_maxLeafSize = 4;
+
+    size_t build(size_t begin, size_t end);
+};
+
+#endif
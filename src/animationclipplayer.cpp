@@ -10,17 +10,16 @@ void AnimationClipPlayer::setSpeedMode(SpeedMode speedMode)
     m_speedMode = speedMode;
 }
 
-void AnimationClipPlayer::updateFrameMeshes(std::vector<std::pair<float, MeshLoader *>> &frameMeshes)
+void AnimationClipPlayer::updateFrameTrack(MotionFrameTrack *frameTrack)
 {
     clear();
     
-    m_frameMeshes = frameMeshes;
-    frameMeshes.clear();
+    m_frameTrack = frameTrack;
     
     m_currentPlayIndex = 0;
     m_countForFrame.restart();
     
-    if (!m_frameMeshes.empty())
+    if (nullptr != m_frameTrack && m_frameTrack->frameCount() > 0)
         m_timerForFrame.singleShot(0, this, &AnimationClipPlayer::frameReadyToShow);
 }
 
@@ -33,15 +32,17 @@ void AnimationClipPlayer::clear()
 
 void AnimationClipPlayer::freeFrames()
 {
-    for (auto &it: m_frameMeshes) {
+    for (auto &it: m_recentFrameMeshes) {
         delete it.second;
     }
-    m_frameMeshes.clear();
+    m_recentFrameMeshes.clear();
+    delete m_frameTrack;
+    m_frameTrack = nullptr;
 }
 
 int AnimationClipPlayer::getFrameDurationMillis(int frame)
 {
-    int millis = m_frameMeshes[frame].first * 1000;
+    int millis = m_frameTrack->frameDuration(frame) * 1000;
     if (SpeedMode::Slow == m_speedMode) {
         millis *= 2;
     } else if (SpeedMode::Fast == m_speedMode) {
@@ -50,9 +51,29 @@ int AnimationClipPlayer::getFrameDurationMillis(int frame)
     return millis;
 }
 
+MeshLoader *AnimationClipPlayer::frameMesh(int frame)
+{
+    // Recently shown frames are kept, so short clips are only skinned during the first loop
+    for (auto it = m_recentFrameMeshes.begin(); it != m_recentFrameMeshes.end(); ++it) {
+        if (it->first == frame) {
+            m_recentFrameMeshes.splice(m_recentFrameMeshes.begin(), m_recentFrameMeshes, it);
+            return m_recentFrameMeshes.front().second;
+        }
+    }
+    MeshLoader *mesh = m_frameTrack->createFrameMesh(frame);
+    if (nullptr == mesh)
+        return nullptr;
+    m_recentFrameMeshes.push_front({frame, mesh});
+    if (m_recentFrameMeshes.size() > m_maxRecentFrameMeshes) {
+        delete m_recentFrameMeshes.back().second;
+        m_recentFrameMeshes.pop_back();
+    }
+    return mesh;
+}
+
 MeshLoader *AnimationClipPlayer::takeFrameMesh()
 {
-    if (m_currentPlayIndex >= (int)m_frameMeshes.size()) {
+    if (nullptr == m_frameTrack || m_currentPlayIndex >= (int)m_frameTrack->frameCount()) {
         if (nullptr != m_lastFrameMesh)
             return new MeshLoader(*m_lastFrameMesh);
         return nullptr;
@@ -64,11 +85,14 @@ MeshLoader *AnimationClipPlayer::takeFrameMesh()
             return new MeshLoader(*m_lastFrameMesh);
         return nullptr;
     }
-    m_currentPlayIndex = (m_currentPlayIndex + 1) % m_frameMeshes.size();
+    m_currentPlayIndex = (m_currentPlayIndex + 1) % m_frameTrack->frameCount();
     m_countForFrame.restart();
 
-    MeshLoader *mesh = new MeshLoader(*m_frameMeshes[m_currentPlayIndex].second);
+    MeshLoader *sourceMesh = frameMesh(m_currentPlayIndex);
     m_timerForFrame.singleShot(getFrameDurationMillis(m_currentPlayIndex), this, &AnimationClipPlayer::frameReadyToShow);
+    if (nullptr == sourceMesh)
+        return nullptr;
+    MeshLoader *mesh = new MeshLoader(*sourceMesh);
     delete m_lastFrameMesh;
     m_lastFrameMesh = new MeshLoader(*mesh);
     return mesh;
@@ -3,7 +3,9 @@
 #include <QObject>
 #include <QTimer>
 #include <QTime>
+#include <list>
 #include "meshloader.h"
+#include "motionframetrack.h"
 
 class AnimationClipPlayer : public QObject
 {
@@ -22,7 +24,7 @@ public:
     
     ~AnimationClipPlayer();
     MeshLoader *takeFrameMesh();
-    void updateFrameMeshes(std::vector<std::pair<float, MeshLoader *>> &frameMeshes);
+    void updateFrameTrack(MotionFrameTrack *frameTrack);
     void clear();
     
 public slots:
@@ -31,10 +33,13 @@ public slots:
 private:
     void freeFrames();
     int getFrameDurationMillis(int frame);
+    MeshLoader *frameMesh(int frame);
 
     MeshLoader *m_lastFrameMesh = nullptr;
     int m_currentPlayIndex = 0;
-    std::vector<std::pair<float, MeshLoader *>> m_frameMeshes;
+    MotionFrameTrack *m_frameTrack = nullptr;
+    std::list<std::pair<int, MeshLoader *>> m_recentFrameMeshes;
+    static const size_t m_maxRecentFrameMeshes = 64;
     QTime m_countForFrame;
     QTimer m_timerForFrame;
     SpeedMode m_speedMode = SpeedMode::Normal;
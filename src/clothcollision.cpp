@@ -0,0 +1,179 @@
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <CGAL/Simple_cartesian.h>
+#include <CGAL/AABB_tree.h>
+#include <CGAL/AABB_traits.h>
+#include <CGAL/Polyhedron_3.h>
+#include <CGAL/Polyhedron_incremental_builder_3.h>
+#include <CGAL/boost/graph/graph_traits_Polyhedron_3.h>
+#include <CGAL/AABB_face_graph_triangle_primitive.h>
+#include <CGAL/algorithm.h>
+#include <CGAL/Side_of_triangle_mesh.h>
+#include <cmath>
+#include <algorithm>
+#include "clothcollision.h"
+
+typedef CGAL::Simple_cartesian<double> K;
+typedef K::Point_3 Point;
+typedef CGAL::Polyhedron_3<K> Polyhedron;
+typedef Polyhedron::HalfedgeDS HalfedgeDS;
+typedef CGAL::AABB_face_graph_triangle_primitive<Polyhedron> Primitive;
+typedef CGAL::AABB_traits<K, Primitive> Traits;
+typedef CGAL::AABB_tree<Traits> Tree;
+typedef CGAL::Side_of_triangle_mesh<Polyhedron, K> Point_inside;
+
+template <class HDS>
+class Build_mesh : public CGAL::Modifier_base<HDS> {
+public:
+    Build_mesh(const std::vector<QVector3D> *vertices,
+            const std::vector<std::vector<size_t>> *faces) :
+        m_vertices(vertices),
+        m_faces(faces)
+    {
+    };
+    void operator()(HDS& hds)
+    {
+        // Postcondition: hds is a valid polyhedral surface.
+        CGAL::Polyhedron_incremental_builder_3<HDS> B(hds, false);
+        B.begin_surface(m_vertices->size(), m_faces->size());
+        typedef typename HDS::Vertex   Vertex;
+        typedef typename Vertex::Point Point;
+        for (const auto &it: *m_vertices)
+            B.add_vertex(Point(it.x(), it.y(), it.z()));
+        for (const auto &it: *m_faces) {
+            B.begin_facet();
+            B.add_vertex_to_facet(it[0]);
+            B.add_vertex_to_facet(it[1]);
+            B.add_vertex_to_facet(it[2]);
+            B.end_facet();
+        }
+        B.end_surface();
+    };
+private:
+    const std::vector<QVector3D> *m_vertices = nullptr;
+    const std::vector<std::vector<size_t>> *m_faces = nullptr;
+};
+
+struct ClothCollisionMesh
+{
+    Polyhedron polyhedron;
+    Tree *aabbTree = nullptr;
+    Point_inside *insideTester = nullptr;
+    
+    ~ClothCollisionMesh()
+    {
+        delete insideTester;
+        delete aabbTree;
+    }
+};
+
+class ClothCollisionCellClassifier
+{
+public:
+    ClothCollisionCellClassifier(ClothCollision *collision) :
+        m_collision(collision)
+    {
+    }
+    void operator()(const tbb::blocked_range<size_t> &range) const
+    {
+        const auto &cellCounts = m_collision->m_cellCounts;
+        double cellSize = m_collision->m_cellSize;
+        // The body surface is farther than the cell center to any of its corners, so the whole cell is on the same side
+        double halfDiagonal = cellSize * std::sqrt(3.0) * 0.5 * 1.001;
+        for (size_t i = range.begin(); i != range.end(); ++i) {
+            size_t x = i % cellCounts[0];
+            size_t y = (i / cellCounts[0]) % cellCounts[1];
+            size_t z = i / ((size_t)cellCounts[0] * cellCounts[1]);
+            Point center(m_collision->m_origin[0] + (x + 0.5) * cellSize,
+                m_collision->m_origin[1] + (y + 0.5) * cellSize,
+                m_collision->m_origin[2] + (z + 0.5) * cellSize);
+            if (m_collision->m_mesh->aabbTree->squared_distance(center) <= halfDiagonal * halfDiagonal)
+                continue;
+            m_collision->m_cellSides[i] = (*m_collision->m_mesh->insideTester)(center) == CGAL::ON_UNBOUNDED_SIDE ?
+                ClothCollision::CellSide::Outside : ClothCollision::CellSide::Inside;
+        }
+    }
+private:
+    ClothCollision *m_collision = nullptr;
+};
+
+ClothCollision::ClothCollision(const std::vector<QVector3D> &vertices,
+    const std::vector<std::vector<size_t>> &triangles)
+{
+    if (triangles.empty() || vertices.empty())
+        return;
+    
+    m_mesh = new ClothCollisionMesh;
+    Build_mesh<HalfedgeDS> mesh(&vertices, &triangles);
+    m_mesh->polyhedron.delegate(mesh);
+    m_mesh->aabbTree = new Tree(faces(m_mesh->polyhedron).first, faces(m_mesh->polyhedron).second, m_mesh->polyhedron);
+    // Build everything up front, the lazy builds are not safe under concurrent queries
+    m_mesh->aabbTree->build();
+    m_mesh->aabbTree->accelerate_distance_queries();
+    m_mesh->insideTester = new Point_inside(*m_mesh->aabbTree);
+    
+    const int maxCellCount = 32;
+    double minPosition[3] = {vertices[0].x(), vertices[0].y(), vertices[0].z()};
+    double maxPosition[3] = {minPosition[0], minPosition[1], minPosition[2]};
+    for (const auto &vertex: vertices) {
+        for (int i = 0; i < 3; ++i) {
+            minPosition[i] = std::min(minPosition[i], (double)vertex[i]);
+            maxPosition[i] = std::max(maxPosition[i], (double)vertex[i]);
+        }
+    }
+    double maxExtent = std::max(std::max(maxPosition[0] - minPosition[0], maxPosition[1] - minPosition[1]), maxPosition[2] - minPosition[2]);
+    m_cellSize = std::max(maxExtent / maxCellCount, 1e-6);
+    for (int i = 0; i < 3; ++i) {
+        m_origin[i] = minPosition[i] - m_cellSize;
+        m_cellCounts[i] = (int)std::ceil((maxPosition[i] - minPosition[i]) / m_cellSize) + 2;
+    }
+    m_cellSides.resize((size_t)m_cellCounts[0] * m_cellCounts[1] * m_cellCounts[2], CellSide::Unknown);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, m_cellSides.size()),
+        ClothCollisionCellClassifier(this));
+}
+
+ClothCollision::~ClothCollision()
+{
+    delete m_mesh;
+}
+
+ClothCollision::CellSide ClothCollision::cellSide(const float *point) const
+{
+    size_t cellIndex = 0;
+    size_t stride = 1;
+    for (int i = 0; i < 3; ++i) {
+        double offset = (point[i] - m_origin[i]) / m_cellSize;
+        // Nothing lies outside of the grid, which is one cell larger than the body on every side
+        if (!(offset >= 0 && offset < m_cellCounts[i]))
+            return CellSide::Outside;
+        cellIndex += (size_t)offset * stride;
+        stride *= m_cellCounts[i];
+    }
+    return m_cellSides[cellIndex];
+}
+
+bool ClothCollision::isInside(const float *point) const
+{
+    if (nullptr == m_mesh)
+        return false;
+    switch (cellSide(point)) {
+    case CellSide::Outside:
+        return false;
+    case CellSide::Inside:
+        return true;
+    default:
+        break;
+    }
+    return (*m_mesh->insideTester)(Point(point[0], point[1], point[2])) != CGAL::ON_UNBOUNDED_SIDE;
+}
+
+bool ClothCollision::pushOut(float *point) const
+{
+    if (!isInside(point))
+        return false;
+    Point closestPoint = m_mesh->aabbTree->closest_point(Point(point[0], point[1], point[2]));
+    point[0] = closestPoint.x();
+    point[1] = closestPoint.y();
+    point[2] = closestPoint.z();
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef DUST3D_CLOTH_COLLISION_H
+#define DUST3D_CLOTH_COLLISION_H
+#include <QVector3D>
+#include <vector>
+#include <cstdint>
+
+struct ClothCollisionMesh;
+
+// Body mesh collision shared read-only by all the cloth simulators of one generation.
+// A coarse grid tells whether each cell lies entirely outside or inside the body,
+// so only points in cells crossing the surface pay for the exact inside test.
+class ClothCollision
+{
+public:
+    ClothCollision(const std::vector<QVector3D> &vertices,
+        const std::vector<std::vector<size_t>> &triangles);
+    ~ClothCollision();
+    bool isInside(const float *point) const;
+    bool pushOut(float *point) const;
+private:
+    enum class CellSide : uint8_t
+    {
+        Unknown = 0,
+        Outside,
+        Inside
+    };
+    ClothCollisionMesh *m_mesh = nullptr;
+    double m_origin[3] = {0, 0, 0};
+    double m_cellSize = 0;
+    int m_cellCounts[3] = {0, 0, 0};
+    std::vector<CellSide> m_cellSides;
+    CellSide cellSide(const float *point) const;
+    friend class ClothCollisionCellClassifier;
+};
+
+#endif
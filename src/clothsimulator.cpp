@@ -1,59 +1,11 @@
 #include <MassSpringSolver.h>
 #include <set>
-#include <CGAL/Simple_cartesian.h>
-#include <CGAL/AABB_tree.h>
-#include <CGAL/AABB_traits.h>
-#include <CGAL/Polyhedron_3.h>
-#include <CGAL/Polyhedron_incremental_builder_3.h>
-#include <CGAL/boost/graph/graph_traits_Polyhedron_3.h>
-#include <CGAL/AABB_face_graph_triangle_primitive.h>
-#include <CGAL/algorithm.h>
-#include <CGAL/Side_of_triangle_mesh.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 #include "clothsimulator.h"
+#include "clothcollision.h"
 #include "booleanmesh.h"
 
-typedef CGAL::Simple_cartesian<double> K;
-typedef K::Point_3 Point;
-typedef K::Triangle_3 Triangle;
-typedef CGAL::Polyhedron_3<K> Polyhedron;
-typedef Polyhedron::HalfedgeDS HalfedgeDS;
-typedef CGAL::AABB_face_graph_triangle_primitive<Polyhedron> Primitive;
-typedef CGAL::AABB_traits<K, Primitive> Traits;
-typedef CGAL::AABB_tree<Traits> Tree;
-typedef CGAL::Side_of_triangle_mesh<Polyhedron, K> Point_inside;
-
-template <class HDS>
-class Build_mesh : public CGAL::Modifier_base<HDS> {
-public:
-    Build_mesh(const std::vector<QVector3D> *vertices,
-            const std::vector<std::vector<size_t>> *faces) :
-        m_vertices(vertices),
-        m_faces(faces)
-    {
-    };
-    void operator()(HDS& hds)
-    {
-        // Postcondition: hds is a valid polyhedral surface.
-        CGAL::Polyhedron_incremental_builder_3<HDS> B(hds, false);
-        B.begin_surface(m_vertices->size(), m_faces->size());
-        typedef typename HDS::Vertex   Vertex;
-        typedef typename Vertex::Point Point;
-        for (const auto &it: *m_vertices)
-            B.add_vertex(Point(it.x(), it.y(), it.z()));
-        for (const auto &it: *m_faces) {
-            B.begin_facet();
-            B.add_vertex_to_facet(it[0]);
-            B.add_vertex_to_facet(it[1]);
-            B.add_vertex_to_facet(it[2]);
-            B.end_facet();
-        }
-        B.end_surface();
-    };
-private:
-    const std::vector<QVector3D> *m_vertices = nullptr;
-    const std::vector<std::vector<size_t>> *m_faces = nullptr;
-};
-
 // System parameters
 //namespace SystemParam {
 //    static const int n = 61; // must be odd, n * n = n_vertices | 61
@@ -63,33 +15,36 @@ private:
 //    static const float g = 9.8f * m; // gravitational force | 9.8f
 //}
 
+class ClothCollisionSatisfier
+{
+public:
+    ClothCollisionSatisfier(const ClothCollision *collision, float *vbuff) :
+        m_collision(collision),
+        m_vbuff(vbuff)
+    {
+    }
+    void operator()(const tbb::blocked_range<size_t> &range) const
+    {
+        for (size_t i = range.begin(); i != range.end(); ++i)
+            m_collision->pushOut(m_vbuff + 3 * i);
+    }
+private:
+    const ClothCollision *m_collision = nullptr;
+    float *m_vbuff = nullptr;
+};
+
 // Point - mesh collision node
 class CgMeshCollisionNode : public CgPointNode {
 private:
-    Tree *m_aabbTree = nullptr;
-    Point_inside *m_insideTester = nullptr;
-    Polyhedron m_polyhedron;
+    const ClothCollision *m_collision = nullptr;
 public:
     CgMeshCollisionNode(mass_spring_system *system, float *vbuff,
-            const std::vector<QVector3D> &collisionVertices,
-            const std::vector<std::vector<size_t>> &collisionTriangles) :
-        CgPointNode(system, vbuff)
+            const ClothCollision *collision) :
+        CgPointNode(system, vbuff),
+        m_collision(collision)
     {
-        if (!collisionTriangles.empty()) {
-            Build_mesh<HalfedgeDS> mesh(&collisionVertices, &collisionTriangles);
-            m_polyhedron.delegate(mesh);
-            m_aabbTree = new Tree(faces(m_polyhedron).first, faces(m_polyhedron).second, m_polyhedron);
-            m_aabbTree->accelerate_distance_queries();
-            m_insideTester = new Point_inside(*m_aabbTree);
-        }
     }
     
-    ~CgMeshCollisionNode()
-    {
-        delete m_insideTester;
-        delete m_aabbTree;
-    };
-    
     bool query(unsigned int i) const
     {
         return false;
@@ -97,59 +52,40 @@ public:
     
     void satisfy()
     {
-        for (unsigned int i = 0; i < system->n_points; i++) {
-            auto offset = 3 * i;
-            Point point(vbuff[offset + 0],
-                vbuff[offset + 1],
-                vbuff[offset + 2]);
-            if (nullptr != m_insideTester &&
-                    (*m_insideTester)(point) != CGAL::ON_UNBOUNDED_SIDE) {
-                Point closestPoint = m_aabbTree->closest_point(point);
-                vbuff[offset + 0] = closestPoint.x();
-                vbuff[offset + 1] = closestPoint.y();
-                vbuff[offset + 2] = closestPoint.z();
-            }
-        }
+        if (nullptr == m_collision)
+            return;
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, system->n_points, 256),
+            ClothCollisionSatisfier(m_collision, vbuff));
     }
     
     void fixPoints(CgPointFixNode *fixNode)
     {
+        if (nullptr == m_collision)
+            return;
         for (unsigned int i = 0; i < system->n_points; i++) {
-            auto offset = 3 * i;
-            Point point(vbuff[offset + 0],
-                vbuff[offset + 1],
-                vbuff[offset + 2]);
-            if (nullptr != m_insideTester &&
-                    (*m_insideTester)(point) != CGAL::ON_UNBOUNDED_SIDE) {
+            if (m_collision->isInside(vbuff + 3 * i))
                 fixNode->fixPoint(i);
-            }
         }
     }
     
     void collectErrorPoints(std::vector<size_t> *points)
     {
+        if (nullptr == m_collision)
+            return;
         for (unsigned int i = 0; i < system->n_points; i++) {
-            auto offset = 3 * i;
-            Point point(vbuff[offset + 0],
-                vbuff[offset + 1],
-                vbuff[offset + 2]);
-            if (nullptr != m_insideTester &&
-                    (*m_insideTester)(point) != CGAL::ON_UNBOUNDED_SIDE) {
+            if (m_collision->isInside(vbuff + 3 * i))
                 points->push_back(i);
-            }
         }
     }
 };
 
 ClothSimulator::ClothSimulator(const std::vector<QVector3D> &vertices,
         const std::vector<std::vector<size_t>> &faces,
-        const std::vector<QVector3D> &collisionVertices,
-        const std::vector<std::vector<size_t>> &collisionTriangles,
+        const ClothCollision *collision,
         const std::vector<QVector3D> &externalForces) :
     m_vertices(vertices),
     m_faces(faces),
-    m_collisionVertices(collisionVertices),
-    m_collisionTriangles(collisionTriangles),
+    m_collision(collision),
     m_externalForces(externalForces)
 {
 }
@@ -279,8 +215,7 @@ void ClothSimulator::create()
     m_rootNode->addChild(m_deformationNode);
 
     m_meshCollisionNode = new CgMeshCollisionNode(m_massSpringSystem, m_clothPointBuffer.data(),
-        m_collisionVertices,
-        m_collisionTriangles);
+        m_collision);
     
     m_fixNode = new CgPointFixNode(m_massSpringSystem, m_clothPointBuffer.data());
     m_meshCollisionNode->fixPoints(m_fixNode);
@@ -10,6 +10,7 @@ class CgRootNode;
 class CgSpringDeformationNode;
 class CgMeshCollisionNode;
 class CgPointFixNode;
+class ClothCollision;
 
 class ClothSimulator : public QObject
 {
@@ -17,8 +18,7 @@ class ClothSimulator : public QObject
 public:
     ClothSimulator(const std::vector<QVector3D> &vertices,
         const std::vector<std::vector<size_t>> &faces,
-        const std::vector<QVector3D> &collisionVertices,
-        const std::vector<std::vector<size_t>> &collisionTriangles,
+        const ClothCollision *collision,
         const std::vector<QVector3D> &externalForces);
     ~ClothSimulator();
     void setStiffness(float stiffness);
@@ -28,8 +28,7 @@ public:
 private:
     std::vector<QVector3D> m_vertices;
     std::vector<std::vector<size_t>> m_faces;
-    std::vector<QVector3D> m_collisionVertices;
-    std::vector<std::vector<size_t>> m_collisionTriangles;
+    const ClothCollision *m_collision = nullptr;
     std::vector<QVector3D> m_externalForces;
     std::vector<float> m_clothPointBuffer;
     std::vector<size_t> m_clothPointSources;
@@ -1,4 +1,5 @@
 #include <QImage>
+#include <QGuiApplication>
 #include <QPainter>
 #include <cmath>
 #include <QUuid>
@@ -23,6 +24,7 @@ ContourToPartConverter::ContourToPartConverter(const QPolygonF &mainProfile,
 void ContourToPartConverter::process()
 {
     convert();
+    this->moveToThread(QGuiApplication::instance()->thread());
     emit finished();
 }
 
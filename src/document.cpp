@@ -1,6 +1,5 @@
 #include <QFileDialog>
 #include <QDebug>
-#include <QThread>
 #include <QGuiApplication>
 #include <QClipboard>
 #include <QMimeData>
@@ -10,16 +9,20 @@
 #include <QtCore/qbuffer.h>
 #include <QElapsedTimer>
 #include <queue>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include "document.h"
 #include "util.h"
 #include "snapshotxml.h"
 #include "materialpreviewsgenerator.h"
 #include "motionsgenerator.h"
+#include "motionframetrack.h"
 #include "skeletonside.h"
 #include "scriptrunner.h"
 #include "mousepicker.h"
 #include "imageforever.h"
 #include "contourtopartconverter.h"
+#include "jobscheduler.h"
 
 unsigned long Document::m_maxSnapshot = 1000;
 const float Component::defaultClothStiffness = 0.5f;
@@ -117,6 +120,8 @@ Document::~Document()
     delete textureBorderImage;
     delete m_resultTextureMesh;
     delete m_resultRigWeightMesh;
+    for (auto &it: m_posePreviewCache)
+        delete it.second;
 }
 
 void Document::uiReady()
@@ -339,10 +344,7 @@ void Document::addPartByPolygons(const QPolygonF &mainProfile, const QPolygonF &
     if (mainProfile.empty() || sideProfile.empty())
         return;
     
-    QThread *thread = new QThread;
     ContourToPartConverter *contourToPartConverter = new ContourToPartConverter(mainProfile, sideProfile, canvasSize);
-    contourToPartConverter->moveToThread(thread);
-    connect(thread, &QThread::started, contourToPartConverter, &ContourToPartConverter::process);
     connect(contourToPartConverter, &ContourToPartConverter::finished, this, [=]() {
         const auto &snapshot = contourToPartConverter->getSnapshot();
         if (!snapshot.nodes.empty()) {
@@ -351,9 +353,9 @@ void Document::addPartByPolygons(const QPolygonF &mainProfile, const QPolygonF &
         }
         delete contourToPartConverter;
     });
-    connect(contourToPartConverter, &ContourToPartConverter::finished, thread, &QThread::quit);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    JobScheduler::instance().schedule(JobScheduler::Kind::ContourToPart, contourToPartConverter, [=]() {
+        contourToPartConverter->process();
+    });
 }
 
 void Document::addNodeWithId(QUuid nodeId, float x, float y, float z, float radius, QUuid fromNodeId)
@@ -1083,6 +1085,24 @@ void Document::resetDirtyFlags()
     }
 }
 
+void Document::restoreDirtyFlags(const Snapshot &snapshot)
+{
+    for (const auto &partIt: snapshot.parts) {
+        if (!isTrueValueString(valueOfKeyInMapOrEmpty(partIt.second, "dirty")))
+            continue;
+        auto part = partMap.find(QUuid(partIt.first));
+        if (part != partMap.end())
+            part->second.dirty = true;
+    }
+    for (const auto &componentIt: snapshot.components) {
+        if (!isTrueValueString(valueOfKeyInMapOrEmpty(componentIt.second, "dirty")))
+            continue;
+        auto component = componentMap.find(QUuid(componentIt.first));
+        if (component != componentMap.end())
+            component->second.dirty = true;
+    }
+}
+
 void Document::markAllDirty()
 {
     for (auto &part: partMap) {
@@ -1098,6 +1118,7 @@ void Document::toSnapshot(Snapshot *snapshot, const std::set<QUuid> &limitNodeId
 {
     if (DocumentToSnapshotFor::Document == forWhat ||
             DocumentToSnapshotFor::Nodes == forWhat) {
+        bool fillTables = snapshot->nodes.empty() && snapshot->edges.empty();
         std::set<QUuid> limitPartIds;
         std::set<QUuid> limitComponentIds;
         for (const auto &nodeId: limitNodeIds) {
@@ -1194,6 +1215,16 @@ void Document::toSnapshot(Snapshot *snapshot, const std::set<QUuid> &limitNodeId
             }
             if (!nodeIt.second.name.isEmpty())
                 node["name"] = nodeIt.second.name;
+            if (fillTables) {
+                const auto &cutFaceIt = node.find("cutFace");
+                bool hasCutFace = cutFaceIt != node.end();
+                snapshot->nodeTable.add(nodeIt.second.id, nodeIt.second.partId,
+                    nodeIt.second.radius, nodeIt.second.getX(), nodeIt.second.getY(), nodeIt.second.getZ(),
+                    nodeIt.second.boneMark,
+                    hasCutFace,
+                    hasCutFace ? cutFaceIt->second : QString(),
+                    hasCutFace ? nodeIt.second.cutRotation : 0);
+            }
             snapshot->nodes[node["id"]] = node;
         }
         for (const auto &edgeIt: edgeMap) {
@@ -1210,8 +1241,13 @@ void Document::toSnapshot(Snapshot *snapshot, const std::set<QUuid> &limitNodeId
             edge["partId"] = edgeIt.second.partId.toString();
             if (!edgeIt.second.name.isEmpty())
                 edge["name"] = edgeIt.second.name;
+            if (fillTables) {
+                snapshot->edgeTable.add(edgeIt.second.id, edgeIt.second.partId,
+                    edgeIt.second.nodeIds[0], edgeIt.second.nodeIds[1]);
+            }
             snapshot->edges[edge["id"]] = edge;
         }
+        snapshot->tablesResolved = fillTables;
         for (const auto &componentIt: componentMap) {
             if (!limitComponentIds.empty() && limitComponentIds.find(componentIt.first) == limitComponentIds.end())
                 continue;
@@ -1898,6 +1934,27 @@ MeshLoader *Document::takeResultRigWeightMesh()
 
 void Document::meshReady()
 {
+    if (m_meshGenerator->isCancelled()) {
+        // Parts finished before the cancellation are still good, keep their previews and drop the rest
+        for (auto &partId: m_meshGenerator->generatedPreviewPartIds()) {
+            auto part = partMap.find(partId);
+            if (part != partMap.end()) {
+                MeshLoader *resultPartPreviewMesh = m_meshGenerator->takePartPreviewMesh(partId);
+                if (nullptr == resultPartPreviewMesh)
+                    continue;
+                part->second.updatePreviewMesh(resultPartPreviewMesh);
+                emit partPreviewChanged(partId);
+            }
+        }
+        delete m_meshGenerator;
+        m_meshGenerator = nullptr;
+        qDebug() << "Mesh generation cancelled";
+        if (m_isResultMeshObsolete) {
+            generateMesh();
+        }
+        return;
+    }
+    
     MeshLoader *resultMesh = m_meshGenerator->takeResultMesh();
     Outcome *outcome = m_meshGenerator->takeOutcome();
     bool isSucceed = m_meshGenerator->isSucceed();
@@ -1924,8 +1981,9 @@ void Document::meshReady()
     
     m_isMeshGenerationSucceed = isSucceed;
     
-    delete m_currentOutcome;
-    m_currentOutcome = outcome;
+    m_currentOutcome.reset(outcome);
+    
+    m_currentMousePickIndex.reset(m_meshGenerator->takeMousePickIndex());
     
     if (nullptr == m_resultMesh) {
         qDebug() << "Result mesh is null";
@@ -2016,7 +2074,13 @@ void Document::enableWeld(bool enabled)
 
 void Document::generateMesh()
 {
-    if (nullptr != m_meshGenerator || m_batchChangeRefCount > 0) {
+    // A generation still waiting for a thread is replaced by this newer one
+    bool replacePending = nullptr != m_meshGenerator && 0 == m_batchChangeRefCount &&
+        JobScheduler::instance().isPending(m_meshGenerator);
+    if (!replacePending && (nullptr != m_meshGenerator || m_batchChangeRefCount > 0)) {
+        // The running generation is superseded, let it stop at its next check instead of finishing stale work
+        if (nullptr != m_meshGenerator)
+            m_meshGenerator->cancel();
         m_isResultMeshObsolete = true;
         return;
     }
@@ -2029,8 +2093,9 @@ void Document::generateMesh()
     
     m_isResultMeshObsolete = false;
     
-    QThread *thread = new QThread;
-    
+    // The replaced generation never ran, what it was to regenerate is still dirty
+    if (replacePending)
+        restoreDirtyFlags(*m_meshGenerator->snapshot());
     Snapshot *snapshot = new Snapshot;
     toSnapshot(snapshot);
     resetDirtyFlags();
@@ -2041,17 +2106,20 @@ void Document::generateMesh()
     if (!m_smoothNormal) {
         m_meshGenerator->setSmoothShadingThresholdAngleDegrees(0);
     }
-    m_meshGenerator->moveToThread(thread);
-    connect(thread, &QThread::started, m_meshGenerator, &MeshGenerator::process);
     connect(m_meshGenerator, &MeshGenerator::finished, this, &Document::meshReady);
-    connect(m_meshGenerator, &MeshGenerator::finished, thread, &QThread::quit);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    MeshGenerator *meshGenerator = m_meshGenerator;
+    JobScheduler::instance().schedule(JobScheduler::Kind::Mesh, meshGenerator, [=]() {
+        meshGenerator->process();
+    }, [=]() {
+        delete meshGenerator;
+    }, [=]() {
+        meshGenerator->cancel();
+    });
 }
 
 void Document::generateTexture()
 {
-    if (nullptr != m_textureGenerator) {
+    if (nullptr != m_textureGenerator && !JobScheduler::instance().isPending(m_textureGenerator)) {
         m_isTextureObsolete = true;
         return;
     }
@@ -2064,14 +2132,14 @@ void Document::generateTexture()
     Snapshot *snapshot = new Snapshot;
     toSnapshot(snapshot);
     
-    QThread *thread = new QThread;
     m_textureGenerator = new TextureGenerator(*m_postProcessedOutcome, snapshot);
-    m_textureGenerator->moveToThread(thread);
-    connect(thread, &QThread::started, m_textureGenerator, &TextureGenerator::process);
     connect(m_textureGenerator, &TextureGenerator::finished, this, &Document::textureReady);
-    connect(m_textureGenerator, &TextureGenerator::finished, thread, &QThread::quit);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    TextureGenerator *textureGenerator = m_textureGenerator;
+    JobScheduler::instance().schedule(JobScheduler::Kind::Texture, textureGenerator, [=]() {
+        textureGenerator->process();
+    }, [=]() {
+        delete textureGenerator;
+    });
 }
 
 void Document::textureReady()
@@ -2143,14 +2211,12 @@ void Document::postProcess()
     qDebug() << "Post processing..";
     emit postProcessing();
 
-    QThread *thread = new QThread;
-    m_postProcessor = new MeshResultPostProcessor(*m_currentOutcome);
-    m_postProcessor->moveToThread(thread);
-    connect(thread, &QThread::started, m_postProcessor, &MeshResultPostProcessor::process);
+    m_postProcessor = new MeshResultPostProcessor(m_currentOutcome);
     connect(m_postProcessor, &MeshResultPostProcessor::finished, this, &Document::postProcessedMeshResultReady);
-    connect(m_postProcessor, &MeshResultPostProcessor::finished, thread, &QThread::quit);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    MeshResultPostProcessor *postProcessor = m_postProcessor;
+    JobScheduler::instance().schedule(JobScheduler::Kind::PostProcess, postProcessor, [=]() {
+        postProcessor->process();
+    });
 }
 
 void Document::postProcessedMeshResultReady()
@@ -2187,15 +2253,14 @@ void Document::doPickMouseTarget()
     
     m_isMouseTargetResultObsolete = false;
     
-    if (!m_currentOutcome) {
-        qDebug() << "MeshLoader is null";
+    if (!m_currentMousePickIndex) {
+        qDebug() << "Mouse pick index is null";
         return;
     }
     
     //qDebug() << "Mouse picking..";
 
-    QThread *thread = new QThread;
-    m_mousePicker = new MousePicker(*m_currentOutcome, m_mouseRayNear, m_mouseRayFar);
+    m_mousePicker = new MousePicker(m_currentMousePickIndex, m_mouseRayNear, m_mouseRayFar);
     
     std::map<QUuid, QUuid> paintImages;
     for (const auto &it: partMap) {
@@ -2210,12 +2275,11 @@ void Document::doPickMouseTarget()
         m_mousePicker->setMaskNodeIds(m_mousePickMaskNodeIds);
     }
     
-    m_mousePicker->moveToThread(thread);
-    connect(thread, &QThread::started, m_mousePicker, &MousePicker::process);
     connect(m_mousePicker, &MousePicker::finished, this, &Document::mouseTargetReady);
-    connect(m_mousePicker, &MousePicker::finished, thread, &QThread::quit);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    MousePicker *mousePicker = m_mousePicker;
+    JobScheduler::instance().schedule(JobScheduler::Kind::MousePick, mousePicker, [=]() {
+        mousePicker->process();
+    });
 }
 
 void Document::mouseTargetReady()
@@ -3128,19 +3192,19 @@ void Document::setPartColorState(QUuid partId, bool hasColor, QColor color)
 
 void Document::saveSnapshot()
 {
-    HistoryItem item;
     QElapsedTimer elapsedTimer;
     elapsedTimer.start();
-    toSnapshot(&item.snapshot);
-    //item.hash = item.snapshot.hash();
-    //if (!m_undoItems.empty() && item.hash == m_undoItems[m_undoItems.size() - 1].hash) {
-    //    qDebug() << "Snapshot has the same hash:" << item.hash << "skipped";
-    //    return;
-    //}
+    Snapshot snapshot;
+    toSnapshot(&snapshot);
+    HistoryItem item(HistorySnapshot(snapshot, m_undoItems.empty() ? nullptr : &m_undoItems.back().snapshot));
+    if (!m_undoItems.empty() && item.snapshot.isSameAs(m_undoItems.back().snapshot)) {
+        qDebug() << "Snapshot has the same hash:" << item.snapshot.hash() << "skipped";
+        return;
+    }
     if (m_undoItems.size() + 1 > m_maxSnapshot)
         m_undoItems.pop_front();
     m_undoItems.push_back(item);
-    qDebug() << "Snapshot saved with hash:" << item.hash << " Time consumed:" << elapsedTimer.elapsed() << "History count:" << m_undoItems.size();
+    qDebug() << "Snapshot saved with hash:" << item.snapshot.hash() << " Time consumed:" << elapsedTimer.elapsed() << "History count:" << m_undoItems.size() << "New bytes:" << item.snapshot.unsharedMemoryUsage();
 }
 
 void Document::undo()
@@ -3150,7 +3214,9 @@ void Document::undo()
     m_redoItems.push_back(m_undoItems.back());
     m_undoItems.pop_back();
     const auto &item = m_undoItems.back();
-    fromSnapshot(item.snapshot);
+    Snapshot snapshot;
+    item.snapshot.toSnapshot(&snapshot);
+    fromSnapshot(snapshot);
     qDebug() << "Undo/Redo items:" << m_undoItems.size() << m_redoItems.size();
 }
 
@@ -3160,11 +3226,24 @@ void Document::redo()
         return;
     m_undoItems.push_back(m_redoItems.back());
     const auto &item = m_redoItems.back();
-    fromSnapshot(item.snapshot);
+    Snapshot snapshot;
+    item.snapshot.toSnapshot(&snapshot);
+    fromSnapshot(snapshot);
     m_redoItems.pop_back();
     qDebug() << "Undo/Redo items:" << m_undoItems.size() << m_redoItems.size();
 }
 
+size_t Document::historyMemoryUsage() const
+{
+    std::set<const void *> visited;
+    size_t memoryUsage = 0;
+    for (const auto &item: m_undoItems)
+        item.snapshot.collectMemoryUsage(&visited, &memoryUsage);
+    for (const auto &item: m_redoItems)
+        item.snapshot.collectMemoryUsage(&visited, &memoryUsage);
+    return memoryUsage;
+}
+
 void Document::clearHistories()
 {
     m_undoItems.clear();
@@ -3470,7 +3549,7 @@ void Document::unlockDescendantComponents(QUuid componentId)
 
 void Document::generateRig()
 {
-    if (nullptr != m_rigGenerator) {
+    if (nullptr != m_rigGenerator && !JobScheduler::instance().isPending(m_rigGenerator)) {
         m_isRigObsolete = true;
         return;
     }
@@ -3478,20 +3557,24 @@ void Document::generateRig()
     m_isRigObsolete = false;
     
     if (RigType::None == rigType || nullptr == m_currentOutcome) {
+        // A waiting generation can't be taken back, its result is replaced once it's done
+        if (nullptr != m_rigGenerator)
+            m_isRigObsolete = true;
         removeRigResults();
         return;
     }
     
     qDebug() << "Rig generating..";
     
-    QThread *thread = new QThread;
-    m_rigGenerator = new RigGenerator(rigType, *m_postProcessedOutcome);
-    m_rigGenerator->moveToThread(thread);
-    connect(thread, &QThread::started, m_rigGenerator, &RigGenerator::process);
+    // The rig only needs the generated outcome, not the UVs, so it runs alongside the post processing
+    m_rigGenerator = new RigGenerator(rigType, m_currentOutcome);
     connect(m_rigGenerator, &RigGenerator::finished, this, &Document::rigReady);
-    connect(m_rigGenerator, &RigGenerator::finished, thread, &QThread::quit);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    RigGenerator *rigGenerator = m_rigGenerator;
+    JobScheduler::instance().schedule(JobScheduler::Kind::Rig, rigGenerator, [=]() {
+        rigGenerator->process();
+    }, [=]() {
+        delete rigGenerator;
+    });
 }
 
 void Document::rigReady()
@@ -3509,11 +3592,12 @@ void Document::rigReady()
     
     m_resultRigMessages = m_rigGenerator->messages();
     
-    delete m_riggedOutcome;
-    m_riggedOutcome = m_rigGenerator->takeOutcome();
+    m_riggedOutcome = m_rigGenerator->outcome();
     if (nullptr == m_riggedOutcome)
-        m_riggedOutcome = new Outcome;
+        m_riggedOutcome = std::make_shared<Outcome>();
     
+    m_resultRigDigest = rigResultDigest(m_resultRigBones, m_resultRigWeights, *m_riggedOutcome);
+
     delete m_rigGenerator;
     m_rigGenerator = nullptr;
     
@@ -3549,6 +3633,8 @@ void Document::removeRigResults()
     delete m_resultRigWeightMesh;
     m_resultRigWeightMesh = nullptr;
     
+    m_resultRigDigest.clear();
+    
     m_resultRigMessages.clear();
     
     m_currentRigSucceed = false;
@@ -3588,7 +3674,7 @@ bool Document::currentRigSucceed() const
 
 void Document::generateMotions()
 {
-    if (nullptr != m_motionsGenerator) {
+    if (nullptr != m_motionsGenerator && !JobScheduler::instance().isPending(m_motionsGenerator)) {
         return;
     }
     
@@ -3599,6 +3685,16 @@ void Document::generateMotions()
         return;
     }
     
+    // A generation still waiting for a thread is replaced by this newer one, which takes over its motions
+    MotionsGenerator *pendingMotionsGenerator = m_motionsGenerator;
+    if (nullptr != pendingMotionsGenerator) {
+        for (const auto &motionId: pendingMotionsGenerator->requiredMotionIds()) {
+            auto motion = motionMap.find(motionId);
+            if (motion != motionMap.end())
+                motion->second.dirty = true;
+        }
+    }
+    
     m_motionsGenerator = new MotionsGenerator(rigType, rigBones, rigWeights, currentRiggedOutcome());
     bool hasDirtyMotion = false;
     for (const auto &pose: poseMap) {
@@ -3614,20 +3710,21 @@ void Document::generateMotions()
     }
     if (!hasDirtyMotion) {
         delete m_motionsGenerator;
-        m_motionsGenerator = nullptr;
-        checkExportReadyState();
+        m_motionsGenerator = pendingMotionsGenerator;
+        if (nullptr == m_motionsGenerator)
+            checkExportReadyState();
         return;
     }
     
     qDebug() << "Motions generating..";
     
-    QThread *thread = new QThread;
-    m_motionsGenerator->moveToThread(thread);
-    connect(thread, &QThread::started, m_motionsGenerator, &MotionsGenerator::process);
     connect(m_motionsGenerator, &MotionsGenerator::finished, this, &Document::motionsReady);
-    connect(m_motionsGenerator, &MotionsGenerator::finished, thread, &QThread::quit);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    MotionsGenerator *motionsGenerator = m_motionsGenerator;
+    JobScheduler::instance().schedule(JobScheduler::Kind::Motions, motionsGenerator, [=]() {
+        motionsGenerator->process();
+    }, [=]() {
+        delete motionsGenerator;
+    });
 }
 
 void Document::motionsReady()
@@ -3635,8 +3732,13 @@ void Document::motionsReady()
     for (auto &motionId: m_motionsGenerator->generatedMotionIds()) {
         auto motion = motionMap.find(motionId);
         if (motion != motionMap.end()) {
-            auto resultPreviewMeshs = m_motionsGenerator->takeResultPreviewMeshs(motionId);
-            motion->second.updatePreviewMeshs(resultPreviewMeshs);
+            // Only the middle frame is skinned for the motion list preview
+            MotionFrameTrack *frameTrack = m_motionsGenerator->takeResultFrameTrack(motionId);
+            MeshLoader *previewMesh = nullptr;
+            if (nullptr != frameTrack && frameTrack->frameCount() > 0)
+                previewMesh = frameTrack->createFrameMesh(std::max((int)frameTrack->frameCount() / 2 - 1, (int)0));
+            delete frameTrack;
+            motion->second.updatePreviewMesh(previewMesh);
             motion->second.jointNodeTrees = m_motionsGenerator->takeResultJointNodeTrees(motionId);
             emit motionPreviewChanged(motionId);
             emit motionResultChanged(motionId);
@@ -3653,7 +3755,7 @@ void Document::motionsReady()
 
 void Document::generatePosePreviews()
 {
-    if (nullptr != m_posePreviewsGenerator) {
+    if (nullptr != m_posePreviewsGenerator && !JobScheduler::instance().isPending(m_posePreviewsGenerator)) {
         return;
     }
     
@@ -3663,37 +3765,55 @@ void Document::generatePosePreviews()
     if (nullptr == rigBones || nullptr == rigWeights) {
         return;
     }
+    
+    // A generation still waiting for a thread is replaced by this newer one, which takes over its poses
+    PosePreviewsGenerator *pendingPosePreviewsGenerator = m_posePreviewsGenerator;
+    if (nullptr != pendingPosePreviewsGenerator) {
+        for (const auto &poseId: pendingPosePreviewsGenerator->poseIds()) {
+            auto pose = poseMap.find(poseId);
+            if (pose != poseMap.end())
+                pose->second.dirty = true;
+            m_generatingPosePreviewKeys.erase(poseId);
+        }
+    }
 
     m_posePreviewsGenerator = new PosePreviewsGenerator(rigType, rigBones,
-        rigWeights, *m_riggedOutcome);
+        rigWeights, m_riggedOutcome);
     bool hasDirtyPose = false;
     for (auto &poseIt: poseMap) {
         if (!poseIt.second.dirty)
             continue;
         if (poseIt.second.frames.empty())
             continue;
+        poseIt.second.dirty = false;
+        // Poses marked dirty without a change of their previewed parameters or the rig, like the ones recreated by undo, reuse the last preview
+        QByteArray key = posePreviewKey(poseIt.second);
+        auto findCached = m_posePreviewCache.find(key);
+        if (findCached != m_posePreviewCache.end()) {
+            poseIt.second.updatePreviewMesh(new MeshLoader(*findCached->second));
+            emit posePreviewChanged(poseIt.first);
+            continue;
+        }
         int middle = poseIt.second.frames.size() / 2;
-        if (middle >= (int)poseIt.second.frames.size())
-            middle = 0;
         m_posePreviewsGenerator->addPose({poseIt.first, middle}, poseIt.second.frames[middle].second);
-        poseIt.second.dirty = false;
+        m_generatingPosePreviewKeys[poseIt.first] = key;
         hasDirtyPose = true;
     }
     if (!hasDirtyPose) {
         delete m_posePreviewsGenerator;
-        m_posePreviewsGenerator = nullptr;
+        m_posePreviewsGenerator = pendingPosePreviewsGenerator;
         return;
     }
     
     qDebug() << "Pose previews generating..";
     
-    QThread *thread = new QThread;
-    m_posePreviewsGenerator->moveToThread(thread);
-    connect(thread, &QThread::started, m_posePreviewsGenerator, &PosePreviewsGenerator::process);
     connect(m_posePreviewsGenerator, &PosePreviewsGenerator::finished, this, &Document::posePreviewsReady);
-    connect(m_posePreviewsGenerator, &PosePreviewsGenerator::finished, thread, &QThread::quit);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    PosePreviewsGenerator *posePreviewsGenerator = m_posePreviewsGenerator;
+    JobScheduler::instance().schedule(JobScheduler::Kind::PosePreviews, posePreviewsGenerator, [=]() {
+        posePreviewsGenerator->process();
+    }, [=]() {
+        delete posePreviewsGenerator;
+    });
 }
 
 void Document::posePreviewsReady()
@@ -3702,19 +3822,99 @@ void Document::posePreviewsReady()
         auto pose = poseMap.find(poseIdAndFrame.first);
         if (pose != poseMap.end()) {
             MeshLoader *resultPartPreviewMesh = m_posePreviewsGenerator->takePreview(poseIdAndFrame);
+            auto findKey = m_generatingPosePreviewKeys.find(poseIdAndFrame.first);
+            if (nullptr != resultPartPreviewMesh && findKey != m_generatingPosePreviewKeys.end()) {
+                auto &cached = m_posePreviewCache[findKey->second];
+                delete cached;
+                cached = new MeshLoader(*resultPartPreviewMesh);
+            }
             pose->second.updatePreviewMesh(resultPartPreviewMesh);
             emit posePreviewChanged(poseIdAndFrame.first);
         }
     }
+    m_generatingPosePreviewKeys.clear();
 
     delete m_posePreviewsGenerator;
     m_posePreviewsGenerator = nullptr;
     
+    // Keep only the previews of the current poses on the current rig
+    std::set<QByteArray> usedKeys;
+    for (const auto &poseIt: poseMap) {
+        if (!poseIt.second.frames.empty())
+            usedKeys.insert(posePreviewKey(poseIt.second));
+    }
+    for (auto it = m_posePreviewCache.begin(); it != m_posePreviewCache.end(); ) {
+        if (usedKeys.find(it->first) == usedKeys.end()) {
+            delete it->second;
+            it = m_posePreviewCache.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    
     qDebug() << "Pose previews generation done";
     
     generatePosePreviews();
 }
 
+QByteArray Document::rigResultDigest(const std::vector<RiggerBone> *bones, const std::map<int, RiggerVertexWeights> *weights,
+    const Outcome &riggedOutcome)
+{
+    if (nullptr == bones || nullptr == weights)
+        return QByteArray();
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << (quint32)bones->size();
+    for (const auto &bone: *bones) {
+        stream << bone.name << (qint32)bone.parent << bone.headPosition << bone.tailPosition;
+    }
+    stream << (quint32)weights->size();
+    for (const auto &it: *weights) {
+        stream << (qint32)it.first;
+        for (size_t i = 0; i < 4; ++i)
+            stream << (qint32)it.second.boneIndices[i] << it.second.boneWeights[i];
+    }
+    
+    // Pose previews are skinned from the rigged outcome, its geometry, normals and colors are part of the identity
+    std::map<std::pair<QUuid, QUuid>, QColor> sourceNodeToColorMap;
+    for (const auto &node: riggedOutcome.nodes)
+        sourceNodeToColorMap.insert({{node.partId, node.nodeId}, node.color});
+    const std::vector<std::vector<QVector3D>> *triangleVertexNormals = riggedOutcome.triangleVertexNormals();
+    const std::vector<std::pair<QUuid, QUuid>> *triangleSourceNodes = riggedOutcome.triangleSourceNodes();
+    stream << (quint32)riggedOutcome.vertices.size();
+    for (const auto &vertex: riggedOutcome.vertices)
+        stream << vertex;
+    stream << (quint32)riggedOutcome.triangles.size();
+    for (size_t i = 0; i < riggedOutcome.triangles.size(); ++i) {
+        const auto &triangle = riggedOutcome.triangles[i];
+        for (const auto &index: triangle)
+            stream << (quint32)index;
+        if (nullptr != triangleVertexNormals && i < triangleVertexNormals->size()) {
+            for (const auto &normal: (*triangleVertexNormals)[i])
+                stream << normal;
+        }
+        if (nullptr != triangleSourceNodes && i < triangleSourceNodes->size())
+            stream << sourceNodeToColorMap[(*triangleSourceNodes)[i]].rgba();
+    }
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+QByteArray Document::posePreviewKey(const Pose &pose) const
+{
+    // Strings are written with their lengths, different parameters never serialize the same
+    const auto &parameters = pose.frames[pose.frames.size() / 2].second;
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << QString(RigTypeToString(rigType)) << m_resultRigDigest;
+    stream << (quint32)parameters.size();
+    for (const auto &boneIt: parameters) {
+        stream << boneIt.first << (quint32)boneIt.second.size();
+        for (const auto &it: boneIt.second)
+            stream << it.first << it.second;
+    }
+    return key;
+}
+
 void Document::addMaterial(QUuid materialId, QString name, std::vector<MaterialLayer> layers)
 {
     QUuid newMaterialId = materialId;
@@ -3783,7 +3983,6 @@ void Document::generateMaterialPreviews()
         return;
     }
 
-    QThread *thread = new QThread;
     m_materialPreviewsGenerator = new MaterialPreviewsGenerator();
     bool hasDirtyMaterial = false;
     for (auto &materialIt: materialMap) {
@@ -3796,18 +3995,16 @@ void Document::generateMaterialPreviews()
     if (!hasDirtyMaterial) {
         delete m_materialPreviewsGenerator;
         m_materialPreviewsGenerator = nullptr;
-        delete thread;
         return;
     }
     
     qDebug() << "Material previews generating..";
     
-    m_materialPreviewsGenerator->moveToThread(thread);
-    connect(thread, &QThread::started, m_materialPreviewsGenerator, &MaterialPreviewsGenerator::process);
     connect(m_materialPreviewsGenerator, &MaterialPreviewsGenerator::finished, this, &Document::materialPreviewsReady);
-    connect(m_materialPreviewsGenerator, &MaterialPreviewsGenerator::finished, thread, &QThread::quit);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-    thread->start();
+    MaterialPreviewsGenerator *materialPreviewsGenerator = m_materialPreviewsGenerator;
+    JobScheduler::instance().schedule(JobScheduler::Kind::MaterialPreviews, materialPreviewsGenerator, [=]() {
+        materialPreviewsGenerator->process();
+    });
 }
 
 void Document::materialPreviewsReady()
@@ -3960,20 +4157,17 @@ void Document::runScript()
     
     qDebug() << "Script running..";
     
-    QThread *thread = new QThread;
-
     m_scriptRunner = new ScriptRunner();
-    m_scriptRunner->moveToThread(thread);
     m_scriptRunner->setScript(new QString(m_script));
     m_scriptRunner->setVariables(new std::map<QString, std::map<QString, QString>>(
         m_mergedVariables.empty() ? m_cachedVariables : m_mergedVariables
         ));
-    connect(thread, &QThread::started, m_scriptRunner, &ScriptRunner::process);
     connect(m_scriptRunner, &ScriptRunner::finished, this, &Document::scriptResultReady);
-    connect(m_scriptRunner, &ScriptRunner::finished, thread, &QThread::quit);
-    connect(thread, &QThread::finished, thread, &QThread::deleteLater);
     emit scriptRunning();
-    thread->start();
+    ScriptRunner *scriptRunner = m_scriptRunner;
+    JobScheduler::instance().schedule(JobScheduler::Kind::Script, scriptRunner, [=]() {
+        scriptRunner->process();
+    });
 }
 
 void Document::scriptResultReady()
@@ -10,6 +10,7 @@
 #include <cmath>
 #include <algorithm>
 #include <QPolygon>
+#include <memory>
 #include "snapshot.h"
 #include "meshloader.h"
 #include "meshgenerator.h"
@@ -31,6 +32,8 @@
 #include "proceduralanimation.h"
 #include "componentlayer.h"
 #include "clothforce.h"
+#include "mousepickindex.h"
+#include "historysnapshot.h"
 
 class MaterialPreviewsGenerator;
 class MotionsGenerator;
@@ -40,8 +43,11 @@ class MousePicker;
 class HistoryItem
 {
 public:
-    uint32_t hash;
-    Snapshot snapshot;
+    HistoryItem(const HistorySnapshot &snapshot) :
+        snapshot(snapshot)
+    {
+    }
+    HistorySnapshot snapshot;
 };
 
 class Component
@@ -320,36 +326,27 @@ public:
     }
     ~Motion()
     {
-        releasePreviewMeshs();
+        delete m_previewMesh;
     }
     QUuid id;
     QString name;
     bool dirty = true;
     std::vector<MotionClip> clips;
     std::vector<std::pair<float, JointNodeTree>> jointNodeTrees;
-    void updatePreviewMeshs(std::vector<std::pair<float, MeshLoader *>> &previewMeshs)
+    void updatePreviewMesh(MeshLoader *previewMesh)
     {
-        releasePreviewMeshs();
-        m_previewMeshs = previewMeshs;
-        previewMeshs.clear();
+        delete m_previewMesh;
+        m_previewMesh = previewMesh;
     }
     MeshLoader *takePreviewMesh() const
     {
-        if (m_previewMeshs.empty())
+        if (nullptr == m_previewMesh)
             return nullptr;
-        int middle = std::max((int)m_previewMeshs.size() / 2 - 1, (int)0);
-        return new MeshLoader(*m_previewMeshs[middle].second);
+        return new MeshLoader(*m_previewMesh);
     }
 private:
     Q_DISABLE_COPY(Motion);
-    void releasePreviewMeshs()
-    {
-        for (const auto &item: m_previewMeshs) {
-            delete item.second;
-        }
-        m_previewMeshs.clear();
-    }
-    std::vector<std::pair<float, MeshLoader *>> m_previewMeshs;
+    MeshLoader *m_previewMesh = nullptr;
 };
 
 class MaterialMap
@@ -587,6 +584,7 @@ public:
     const std::vector<std::pair<QtMsgType, QString>> &resultRigMessages() const;
     const Outcome &currentRiggedOutcome() const;
     bool currentRigSucceed() const;
+    size_t historyMemoryUsage() const;
     bool isMeshGenerating() const;
     bool isPostProcessing() const;
     bool isTextureGenerating() const;
@@ -757,12 +755,16 @@ private:
     bool isDescendantComponent(QUuid componentId, QUuid suspiciousId);
     void removeComponentRecursively(QUuid componentId);
     void resetDirtyFlags();
+    void restoreDirtyFlags(const Snapshot &snapshot);
     void markAllDirty();
     void removeRigResults();
     void updateLinkedPart(QUuid oldPartId, QUuid newPartId);
     //void addToolToMesh(MeshLoader *mesh);
     bool updateDefaultVariables(const std::map<QString, std::map<QString, QString>> &defaultVariables);
     void checkPartGrid(QUuid partId);
+    QByteArray posePreviewKey(const Pose &pose) const;
+    static QByteArray rigResultDigest(const std::vector<RiggerBone> *bones, const std::map<int, RiggerVertexWeights> *weights,
+        const Outcome &riggedOutcome);
 private: // need initialize
     bool m_isResultMeshObsolete;
     MeshGenerator *m_meshGenerator;
@@ -771,7 +773,8 @@ private: // need initialize
     std::map<QUuid, std::map<QString, QVector2D>> *m_resultMeshNodesCutFaces;
     bool m_isMeshGenerationSucceed;
     int m_batchChangeRefCount;
-    Outcome *m_currentOutcome;
+    std::shared_ptr<const Outcome> m_currentOutcome;
+    std::shared_ptr<const MousePickIndex> m_currentMousePickIndex;
     bool m_isTextureObsolete;
     TextureGenerator *m_textureGenerator;
     bool m_isPostProcessResultObsolete;
@@ -787,8 +790,11 @@ private: // need initialize
     std::vector<RiggerBone> *m_resultRigBones;
     std::map<int, RiggerVertexWeights> *m_resultRigWeights;
     bool m_isRigObsolete;
-    Outcome *m_riggedOutcome;
+    std::shared_ptr<const Outcome> m_riggedOutcome;
     PosePreviewsGenerator *m_posePreviewsGenerator;
+    QByteArray m_resultRigDigest;
+    std::map<QByteArray, MeshLoader *> m_posePreviewCache;
+    std::map<QUuid, QByteArray> m_generatingPosePreviewKeys;
     bool m_currentRigSucceed;
     MaterialPreviewsGenerator *m_materialPreviewsGenerator;
     MotionsGenerator *m_motionsGenerator;
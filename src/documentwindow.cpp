@@ -1101,7 +1101,7 @@ DocumentWindow::DocumentWindow() :
     //});
     connect(m_document, &Document::textureChanged, m_document, &Document::generateTexture);
     connect(m_document, &Document::resultMeshChanged, m_document, &Document::postProcess);
-    connect(m_document, &Document::postProcessedResultChanged, m_document, &Document::generateRig);
+    connect(m_document, &Document::resultMeshChanged, m_document, &Document::generateRig);
     connect(m_document, &Document::rigChanged, m_document, &Document::generateRig);
     connect(m_document, &Document::postProcessedResultChanged, m_document, &Document::generateTexture);
     //connect(m_document, &SkeletonDocument::resultTextureChanged, m_document, &SkeletonDocument::bakeAmbientOcclusionTexture);
@@ -1476,11 +1476,15 @@ void DocumentWindow::saveTo(const QString &saveAsFilename)
     }
     
     for (const auto &imageId: imageIds) {
-        const QByteArray *pngByteArray = ImageForever::getPngByteArray(imageId);
-        if (nullptr == pngByteArray)
+        if (nullptr == ImageForever::get(imageId))
             continue;
-        if (pngByteArray->size() > 0)
-            ds3Writer.add("images/" + imageId.toString() + ".png", "asset", pngByteArray);
+        // Encoded on the writer's workers when the item is about to be written
+        ds3Writer.add("images/" + imageId.toString() + ".png", "asset", [=]() {
+            auto pngByteArray = ImageForever::getPngByteArray(imageId);
+            if (nullptr == pngByteArray)
+                return QByteArray();
+            return *pngByteArray;
+        });
     }
 
     if (ds3Writer.save(filename)) {
@@ -1500,22 +1504,10 @@ void DocumentWindow::openPathAs(const QString &path, const QString &asName)
     m_document->reset();
     m_document->saveSnapshot();
     
-    for (int i = 0; i < ds3Reader.items().size(); ++i) {
-        Ds3ReaderItem item = ds3Reader.items().at(i);
-        if (item.type == "asset") {
-            if (item.name.startsWith("images/")) {
-                QString filename = item.name.split("/")[1];
-                QString imageIdString = filename.split(".")[0];
-                QUuid imageId = QUuid(imageIdString);
-                if (!imageId.isNull()) {
-                    QByteArray data;
-                    ds3Reader.loadItem(item.name, &data);
-                    QImage image = QImage::fromData(data, "PNG");
-                    (void)ImageForever::add(&image, imageId);
-                }
-            }
-        }
-    }
+    std::map<QUuid, QImage> images;
+    ds3Reader.loadImages(&images);
+    for (const auto &it: images)
+        (void)ImageForever::add(&it.second, it.first);
     
     for (int i = 0; i < ds3Reader.items().size(); ++i) {
         Ds3ReaderItem item = ds3Reader.items().at(i);
@@ -1,6 +1,12 @@
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/task_scheduler_init.h>
+#include <algorithm>
 #include <QFile>
+#include <QSaveFile>
 #include <QTextStream>
 #include <QXmlStreamReader>
+#include <QDebug>
 #include "ds3file.h"
 
 QString Ds3FileReader::m_applicationName = QString("DUST3D");
@@ -41,11 +47,11 @@ Ds3FileReader::Ds3FileReader(const QString &filename) :
         return;
     }
     m_binaryOffset = tokens[3].toLongLong();
-    QFile file(m_filename);
-    if (!file.open(QIODevice::ReadOnly)) {
+    m_file.setFileName(m_filename);
+    if (!m_file.open(QIODevice::ReadOnly)) {
         return;
     }
-    QString header = QString::fromUtf8(file.read(m_binaryOffset).constData()).mid(firstLine.size()).trimmed();
+    QString header = QString::fromUtf8(m_file.read(m_binaryOffset).constData()).mid(firstLine.size()).trimmed();
     QXmlStreamReader xml(header);
     bool ds3TagEntered = false;
     while (!xml.atEnd()) {
@@ -71,6 +77,15 @@ Ds3FileReader::Ds3FileReader(const QString &filename) :
             }
         }
     }
+    // Falls back to reading item by item when the file can not be mapped, e.g. compressed resources
+    if (m_headerIsGood)
+        m_mappedData = m_file.map(0, m_file.size());
+}
+
+Ds3FileReader::~Ds3FileReader()
+{
+    if (nullptr != m_mappedData)
+        m_file.unmap((uchar *)m_mappedData);
 }
 
 void Ds3FileReader::loadItem(const QString &name, QByteArray *byteArray)
@@ -78,10 +93,16 @@ void Ds3FileReader::loadItem(const QString &name, QByteArray *byteArray)
     byteArray->clear();
     if (!m_headerIsGood)
         return;
-    if (m_itemsMap.find(name) == m_itemsMap.end()) {
+    auto findItem = m_itemsMap.find(name);
+    if (findItem == m_itemsMap.end()) {
+        return;
+    }
+    const Ds3ReaderItem &readerItem = findItem->second;
+    if (nullptr != m_mappedData) {
+        *byteArray = itemView(name);
+        byteArray->detach();
         return;
     }
-    Ds3ReaderItem readerItem = m_itemsMap[name];
     QFile file(m_filename);
     if (!file.open(QIODevice::ReadOnly)) {
         return;
@@ -92,6 +113,72 @@ void Ds3FileReader::loadItem(const QString &name, QByteArray *byteArray)
     *byteArray = file.read(readerItem.size);
 }
 
+QByteArray Ds3FileReader::itemView(const QString &name)
+{
+    if (!m_headerIsGood)
+        return QByteArray();
+    if (nullptr == m_mappedData) {
+        QByteArray byteArray;
+        loadItem(name, &byteArray);
+        return byteArray;
+    }
+    auto findItem = m_itemsMap.find(name);
+    if (findItem == m_itemsMap.end())
+        return QByteArray();
+    const Ds3ReaderItem &readerItem = findItem->second;
+    long long begin = m_binaryOffset + readerItem.offset;
+    if (readerItem.offset < 0 || readerItem.size < 0 || begin + readerItem.size > m_file.size()) {
+        qDebug() << "Ds3 item out of range:" << name;
+        return QByteArray();
+    }
+    return QByteArray::fromRawData((const char *)m_mappedData + begin, readerItem.size);
+}
+
+class Ds3ImageDecoder
+{
+public:
+    Ds3ImageDecoder(const std::vector<QByteArray> *sources, std::vector<QImage> *images) :
+        m_sources(sources),
+        m_images(images)
+    {
+    }
+    void operator()(const tbb::blocked_range<size_t> &range) const
+    {
+        for (size_t i = range.begin(); i != range.end(); ++i)
+            (*m_images)[i] = QImage::fromData((*m_sources)[i], "PNG");
+    }
+private:
+    const std::vector<QByteArray> *m_sources = nullptr;
+    std::vector<QImage> *m_images = nullptr;
+};
+
+void Ds3FileReader::loadImages(std::map<QUuid, QImage> *images)
+{
+    std::vector<QUuid> imageIds;
+    std::vector<QByteArray> sources;
+    for (const auto &item: m_items) {
+        if (item.type != "asset" || !item.name.startsWith("images/"))
+            continue;
+        QString filename = item.name.split("/")[1];
+        QString imageIdString = filename.split(".")[0];
+        QUuid imageId = QUuid(imageIdString);
+        if (imageId.isNull())
+            continue;
+        imageIds.push_back(imageId);
+        sources.push_back(itemView(item.name));
+    }
+    std::vector<QImage> decodedImages(sources.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, sources.size(), 1),
+        Ds3ImageDecoder(&sources, &decodedImages));
+    for (size_t i = 0; i < imageIds.size(); ++i) {
+        if (decodedImages[i].isNull()) {
+            qDebug() << "Decode image failed:" << imageIds[i];
+            continue;
+        }
+        (*images)[imageIds[i]] = decodedImages[i];
+    }
+}
+
 const QList<Ds3ReaderItem> &Ds3FileReader::items()
 {
     return m_items;
@@ -111,12 +198,27 @@ bool Ds3FileWriter::add(const QString &name, const QString &type, const QByteArr
     return true;
 }
 
-bool Ds3FileWriter::save(const QString &filename)
+bool Ds3FileWriter::add(const QString &name, const QString &type, const std::function<QByteArray ()> &produce)
 {
-    QFile file(filename);
-    if (!file.open(QIODevice::WriteOnly)) {
+    if (m_itemsMap.find(name) != m_itemsMap.end()) {
         return false;
     }
+    Ds3WriterItem writerItem;
+    writerItem.type = type;
+    writerItem.name = name;
+    writerItem.produce = produce;
+    m_itemsMap[name] = writerItem;
+    m_items.push_back(writerItem);
+    return true;
+}
+
+QByteArray Ds3FileWriter::makeHeader(const std::vector<long long> &sizes)
+{
+    // Numbers are zero padded to a fixed width, so the header can be written before the item sizes are known
+    // and patched in place afterwards, readers parse the padded numbers as usual
+    auto formatNumber = [](long long value) {
+        return QString("%1").arg(value, 20, 10, QChar('0'));
+    };
     
     QByteArray headerXml;
     {
@@ -130,9 +232,9 @@ bool Ds3FileWriter::save(const QString &filename)
             Ds3WriterItem *writerItem = &m_items[i];
             stream.writeStartElement(writerItem->type);
                 stream.writeAttribute("name", QString("%1").arg(writerItem->name));
-                stream.writeAttribute("offset", QString("%1").arg(offset));
-                stream.writeAttribute("size", QString("%1").arg(writerItem->byteArray.size()));
-                offset += writerItem->byteArray.size();
+                stream.writeAttribute("offset", formatNumber(offset));
+                stream.writeAttribute("size", formatNumber(sizes[i]));
+                offset += sizes[i];
             stream.writeEndElement();
         }
         
@@ -147,14 +249,69 @@ bool Ds3FileWriter::save(const QString &filename)
     unsigned int headerSize = firstLineSizeExcludeSizeSelf + 12 + headerXml.size();
     char headerSizeString[100] = {0};
     sprintf(headerSizeString, "%010u\r\n", headerSize);
-    file.write(firstLine, firstLineSizeExcludeSizeSelf);
-    file.write(headerSizeString, strlen(headerSizeString));
-    file.write(headerXml);
-    for (int i = 0; i < m_items.size(); i++) {
-        Ds3WriterItem *writerItem = &m_items[i];
-        file.write(writerItem->byteArray);
+    QByteArray header;
+    header.append(firstLine, firstLineSizeExcludeSizeSelf);
+    header.append(headerSizeString, strlen(headerSizeString));
+    header.append(headerXml);
+    return header;
+}
+
+class Ds3ItemProducer
+{
+public:
+    Ds3ItemProducer(const QList<Ds3WriterItem> *items, size_t batchBegin, std::vector<QByteArray> *byteArrays) :
+        m_items(items),
+        m_batchBegin(batchBegin),
+        m_byteArrays(byteArrays)
+    {
+    }
+    void operator()(const tbb::blocked_range<size_t> &range) const
+    {
+        for (size_t i = range.begin(); i != range.end(); ++i) {
+            const Ds3WriterItem &writerItem = m_items->at(m_batchBegin + i);
+            (*m_byteArrays)[i] = writerItem.produce ? writerItem.produce() : writerItem.byteArray;
+        }
+    }
+private:
+    const QList<Ds3WriterItem> *m_items = nullptr;
+    size_t m_batchBegin = 0;
+    std::vector<QByteArray> *m_byteArrays = nullptr;
+};
+
+bool Ds3FileWriter::save(const QString &filename)
+{
+    QSaveFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
     }
     
-    return true;
+    std::vector<long long> sizes(m_items.size(), 0);
+    QByteArray placeholderHeader = makeHeader(sizes);
+    if (file.write(placeholderHeader) != placeholderHeader.size())
+        return false;
+    
+    // Items are produced a batch at a time in parallel and written in order,
+    // only one batch is held in memory
+    size_t batchSize = std::max(tbb::task_scheduler_init::default_num_threads(), 1);
+    for (size_t batchBegin = 0; batchBegin < (size_t)m_items.size(); batchBegin += batchSize) {
+        size_t batchEnd = std::min(batchBegin + batchSize, (size_t)m_items.size());
+        std::vector<QByteArray> byteArrays(batchEnd - batchBegin);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, byteArrays.size(), 1),
+            Ds3ItemProducer(&m_items, batchBegin, &byteArrays));
+        for (size_t i = 0; i < byteArrays.size(); ++i) {
+            if (file.write(byteArrays[i]) != byteArrays[i].size())
+                return false;
+            sizes[batchBegin + i] = byteArrays[i].size();
+        }
+    }
+    
+    QByteArray header = makeHeader(sizes);
+    if (header.size() != placeholderHeader.size()) {
+        qDebug() << "Ds3 header size changed after items were written";
+        return false;
+    }
+    if (!file.seek(0) || file.write(header) != header.size())
+        return false;
+    
+    return file.commit();
 }
-
@@ -3,7 +3,12 @@
 #include <QObject>
 #include <QString>
 #include <QByteArray>
+#include <QFile>
+#include <QImage>
+#include <QUuid>
 #include <map>
+#include <vector>
+#include <functional>
 
 /*
 DUST3D 1.0 xml 12345
@@ -29,7 +34,11 @@ class Ds3FileReader : public QObject
     Q_OBJECT
 public:
     Ds3FileReader(const QString &filename);
+    ~Ds3FileReader();
     void loadItem(const QString &name, QByteArray *byteArray);
+    // Zero copy when the file could be memory mapped, the view is valid as long as the reader is alive
+    QByteArray itemView(const QString &name);
+    void loadImages(std::map<QUuid, QImage> *images);
     const QList<Ds3ReaderItem> &items();
     static QString m_applicationName;
     static QString m_fileFormatVersion;
@@ -42,6 +51,8 @@ private:
     QString readFirstLine();
     bool m_headerIsGood;
     long long m_binaryOffset;
+    QFile m_file;
+    const uchar *m_mappedData = nullptr;
 };
 
 class Ds3WriterItem
@@ -50,6 +61,7 @@ public:
     QString type;
     QString name;
     QByteArray byteArray;
+    std::function<QByteArray ()> produce;
 };
 
 class Ds3FileWriter : public QObject
@@ -57,11 +69,15 @@ class Ds3FileWriter : public QObject
     Q_OBJECT
 public:
     bool add(const QString &name, const QString &type, const QByteArray *byteArray);
+    // The content is produced when saving and released once written, so large items never pile up in memory
+    bool add(const QString &name, const QString &type, const std::function<QByteArray ()> &produce);
     bool save(const QString &filename);
 private:
     std::map<QString, Ds3WriterItem> m_itemsMap;
     QList<Ds3WriterItem> m_items;
     QString m_filename;
+private:
+    QByteArray makeHeader(const std::vector<long long> &sizes);
 };
 
 #endif
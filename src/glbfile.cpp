@@ -5,11 +5,17 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QtCore/qbuffer.h>
+#include <map>
+#include <tuple>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
 #include "glbfile.h"
 #include "version.h"
 #include "util.h"
 #include "jointnodetree.h"
 #include "meshloader.h"
+#include "optimizevertexcache.h"
 
 // Play with glTF online:
 // https://gltf-viewer.donmccurdy.com/
@@ -30,7 +36,8 @@ GlbFileWriter::GlbFileWriter(Outcome &outcome,
         QImage *textureImage,
         QImage *normalImage,
         QImage *ormImage,
-        const std::vector<std::pair<QString, std::vector<std::pair<float, JointNodeTree>>>> *motions) :
+        const std::vector<std::pair<QString, std::vector<std::pair<float, JointNodeTree>>>> *motions,
+        bool enableQuantization) :
     m_filename(filename),
     m_outputNormal(true),
     m_outputAnimation(true),
@@ -142,17 +149,107 @@ GlbFileWriter::GlbFileWriter(Outcome &outcome,
         m_json["nodes"][0]["mesh"] = 0;
     }
 
-    std::vector<QVector3D> triangleVertexPositions;
-    std::vector<size_t> triangleVertexOldIndices;
-    for (const auto &triangleIndices: outcome.triangles) {
-        for (size_t j = 0; j < 3; ++j) {
-            triangleVertexOldIndices.push_back(triangleIndices[j]);
-            triangleVertexPositions.push_back(outcome.vertices[triangleIndices[j]]);
+    // Corners with the same source vertex, normal and uv are welded, so each vertex is written once
+    auto floatBits = [](float value) {
+        quint32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    };
+    std::vector<uint32_t> triangleIndices;
+    std::vector<size_t> vertexOldIndices;
+    std::vector<QVector3D> vertexNormals;
+    std::vector<QVector2D> vertexUvs;
+    {
+        std::map<std::tuple<size_t, quint32, quint32, quint32, quint32, quint32>, uint32_t> cornerToVertexMap;
+        for (size_t i = 0; i < outcome.triangles.size(); ++i) {
+            const auto &triangle = outcome.triangles[i];
+            for (size_t j = 0; j < 3; ++j) {
+                QVector3D normal = m_outputNormal ? (*triangleVertexNormals)[i][j] : QVector3D();
+                QVector2D uv = m_outputUv ? (*triangleVertexUvs)[i][j] : QVector2D();
+                auto key = std::make_tuple(triangle[j],
+                    floatBits(normal.x()), floatBits(normal.y()), floatBits(normal.z()),
+                    floatBits(uv.x()), floatBits(uv.y()));
+                auto insertResult = cornerToVertexMap.insert({key, (uint32_t)vertexOldIndices.size()});
+                if (insertResult.second) {
+                    vertexOldIndices.push_back(triangle[j]);
+                    vertexNormals.push_back(normal);
+                    vertexUvs.push_back(uv);
+                }
+                triangleIndices.push_back(insertResult.first->second);
+            }
         }
     }
+    {
+        optimizeVertexCache(&triangleIndices, vertexOldIndices.size());
+        std::vector<uint32_t> newToOldVertices;
+        optimizeVertexFetch(&triangleIndices, vertexOldIndices.size(), &newToOldVertices);
+        std::vector<size_t> fetchOrderedOldIndices(newToOldVertices.size());
+        std::vector<QVector3D> fetchOrderedNormals(newToOldVertices.size());
+        std::vector<QVector2D> fetchOrderedUvs(newToOldVertices.size());
+        for (size_t i = 0; i < newToOldVertices.size(); ++i) {
+            fetchOrderedOldIndices[i] = vertexOldIndices[newToOldVertices[i]];
+            fetchOrderedNormals[i] = vertexNormals[newToOldVertices[i]];
+            fetchOrderedUvs[i] = vertexUvs[newToOldVertices[i]];
+        }
+        vertexOldIndices.swap(fetchOrderedOldIndices);
+        vertexNormals.swap(fetchOrderedNormals);
+        vertexUvs.swap(fetchOrderedUvs);
+    }
+    std::vector<QVector3D> vertexPositions;
+    vertexPositions.reserve(vertexOldIndices.size());
+    for (const auto &oldIndex: vertexOldIndices)
+        vertexPositions.push_back(outcome.vertices[oldIndex]);
+    
+    bool hasSkin = resultRigBones && resultRigWeights && !resultRigBones->empty();
+    bool hasWeights = resultRigWeights && !resultRigWeights->empty();
+    
+    // Skinned mesh node transforms are ignored by viewers, so positions can only be dequantized by the node when there is no skin
+    // Positions, normals, uvs and weights are written as normalized integers (KHR_mesh_quantization)
+    bool quantizePosition = enableQuantization && !hasSkin;
+    bool quantizeNormal = enableQuantization;
+    bool quantizeUv = enableQuantization;
+    if (quantizeUv) {
+        for (const auto &uv: vertexUvs) {
+            if (uv.x() < 0 || uv.x() > 1 || uv.y() < 0 || uv.y() > 1) {
+                quantizeUv = false;
+                break;
+            }
+        }
+    }
+    bool quantizeJoints = enableQuantization && boneNodes.size() <= 256;
+    bool quantizeWeights = enableQuantization;
+    if ((quantizePosition || quantizeNormal) && !vertexPositions.empty()) {
+        m_json["extensionsUsed"] = {"KHR_mesh_quantization"};
+        m_json["extensionsRequired"] = {"KHR_mesh_quantization"};
+    }
+    
+    auto beginBufferView = [&]() {
+        bufferViewFromOffset = (int)m_binByteArray.size();
+        m_json["bufferViews"][bufferViewIndex]["buffer"] = 0;
+        m_json["bufferViews"][bufferViewIndex]["byteOffset"] = bufferViewFromOffset;
+    };
+    auto endBufferView = [&](int target, int byteStride) {
+        m_json["bufferViews"][bufferViewIndex]["byteLength"] = m_binByteArray.size() - bufferViewFromOffset;
+        if (0 != target)
+            m_json["bufferViews"][bufferViewIndex]["target"] = target;
+        if (0 != byteStride)
+            m_json["bufferViews"][bufferViewIndex]["byteStride"] = byteStride;
+        alignBin();
+    };
+    auto addAccessor = [&](const QString &comment, int componentType, size_t count, const char *type, bool normalized) {
+        if (m_enableComment)
+            m_json["accessors"][bufferViewIndex]["__comment"] = QString("/accessors/%1: %2").arg(QString::number(bufferViewIndex)).arg(comment).toUtf8().constData();
+        m_json["accessors"][bufferViewIndex]["bufferView"] = bufferViewIndex;
+        m_json["accessors"][bufferViewIndex]["byteOffset"] = 0;
+        m_json["accessors"][bufferViewIndex]["componentType"] = componentType;
+        if (normalized)
+            m_json["accessors"][bufferViewIndex]["normalized"] = true;
+        m_json["accessors"][bufferViewIndex]["count"] = count;
+        m_json["accessors"][bufferViewIndex]["type"] = type;
+    };
 
     int primitiveIndex = 0;
-    if (!triangleVertexPositions.empty()) {
+    if (!vertexPositions.empty()) {
         
         m_json["meshes"][0]["primitives"][primitiveIndex]["indices"] = bufferViewIndex;
         m_json["meshes"][0]["primitives"][primitiveIndex]["material"] = primitiveIndex;
@@ -162,7 +259,7 @@ GlbFileWriter::GlbFileWriter(Outcome &outcome,
             m_json["meshes"][0]["primitives"][primitiveIndex]["attributes"]["NORMAL"] = bufferViewIndex + (++attributeIndex);
         if (m_outputUv)
             m_json["meshes"][0]["primitives"][primitiveIndex]["attributes"]["TEXCOORD_0"] = bufferViewIndex + (++attributeIndex);
-        if (resultRigWeights && !resultRigWeights->empty()) {
+        if (hasWeights) {
             m_json["meshes"][0]["primitives"][primitiveIndex]["attributes"]["JOINTS_0"] = bufferViewIndex + (++attributeIndex);
             m_json["meshes"][0]["primitives"][primitiveIndex]["attributes"]["WEIGHTS_0"] = bufferViewIndex + (++attributeIndex);
         }
@@ -185,35 +282,26 @@ GlbFileWriter::GlbFileWriter(Outcome &outcome,
         
         primitiveIndex++;
 
-        bufferViewFromOffset = (int)m_binByteArray.size();
-        for (size_t index = 0; index < triangleVertexPositions.size(); index += 3) {
-            binStream << (quint16)index << (quint16)(index + 1) << (quint16)(index + 2);
+        // 16 bits indices whenever they fit, welded vertices of larger meshes need 32 bits
+        bool useShortIndices = vertexPositions.size() <= 65535;
+        beginBufferView();
+        for (const auto &index: triangleIndices) {
+            if (useShortIndices)
+                binStream << (quint16)index;
+            else
+                binStream << (quint32)index;
         }
-        m_json["bufferViews"][bufferViewIndex]["buffer"] = 0;
-        m_json["bufferViews"][bufferViewIndex]["byteOffset"] = bufferViewFromOffset;
-        m_json["bufferViews"][bufferViewIndex]["byteLength"] = (int)triangleVertexPositions.size() * sizeof(quint16);
-        m_json["bufferViews"][bufferViewIndex]["target"] = 34963;
-        Q_ASSERT((int)triangleVertexPositions.size() * sizeof(quint16) == m_binByteArray.size() - bufferViewFromOffset);
-        alignBin();
-        if (m_enableComment)
-            m_json["accessors"][bufferViewIndex]["__comment"] = QString("/accessors/%1: triangle indices").arg(QString::number(bufferViewIndex)).toUtf8().constData();
-        m_json["accessors"][bufferViewIndex]["bufferView"] = bufferViewIndex;
-        m_json["accessors"][bufferViewIndex]["byteOffset"] = 0;
-        m_json["accessors"][bufferViewIndex]["componentType"] = 5123;
-        m_json["accessors"][bufferViewIndex]["count"] = triangleVertexPositions.size();
-        m_json["accessors"][bufferViewIndex]["type"] = "SCALAR";
+        endBufferView(34963, 0);
+        addAccessor("triangle indices", useShortIndices ? 5123 : 5125, triangleIndices.size(), "SCALAR", false);
         bufferViewIndex++;
         
-        bufferViewFromOffset = (int)m_binByteArray.size();
-        m_json["bufferViews"][bufferViewIndex]["buffer"] = 0;
-        m_json["bufferViews"][bufferViewIndex]["byteOffset"] = bufferViewFromOffset;
         float minX = 100;
         float maxX = -100;
         float minY = 100;
         float maxY = -100;
         float minZ = 100;
         float maxZ = -100;
-        for (const auto &position: triangleVertexPositions) {
+        for (const auto &position: vertexPositions) {
             if (position.x() < minX)
                 minX = position.x();
             if (position.x() > maxX)
@@ -226,76 +314,80 @@ GlbFileWriter::GlbFileWriter(Outcome &outcome,
                 minZ = position.z();
             if (position.z() > maxZ)
                 maxZ = position.z();
-            binStream << (float)position.x() << (float)position.y() << (float)position.z();
         }
-        Q_ASSERT((int)triangleVertexPositions.size() * 3 * sizeof(float) == m_binByteArray.size() - bufferViewFromOffset);
-        m_json["bufferViews"][bufferViewIndex]["byteLength"] =  triangleVertexPositions.size() * 3 * sizeof(float);
-        m_json["bufferViews"][bufferViewIndex]["target"] = 34962;
-        alignBin();
-        if (m_enableComment)
-            m_json["accessors"][bufferViewIndex]["__comment"] = QString("/accessors/%1: xyz").arg(QString::number(bufferViewIndex)).toUtf8().constData();
-        m_json["accessors"][bufferViewIndex]["bufferView"] = bufferViewIndex;
-        m_json["accessors"][bufferViewIndex]["byteOffset"] = 0;
-        m_json["accessors"][bufferViewIndex]["componentType"] = 5126;
-        m_json["accessors"][bufferViewIndex]["count"] =  triangleVertexPositions.size();
-        m_json["accessors"][bufferViewIndex]["type"] = "VEC3";
-        m_json["accessors"][bufferViewIndex]["max"] = {maxX, maxY, maxZ};
-        m_json["accessors"][bufferViewIndex]["min"] = {minX, minY, minZ};
+        beginBufferView();
+        if (quantizePosition) {
+            // Uniform scale keeps the normals valid under the dequantization transform of the node
+            QVector3D center((minX + maxX) * 0.5, (minY + maxY) * 0.5, (minZ + maxZ) * 0.5);
+            float halfExtent = std::max(std::max(maxX - minX, maxY - minY), maxZ - minZ) * 0.5;
+            float scale = halfExtent > 0 ? halfExtent / 32767 : 1.0;
+            qint16 quantizedMin[3] = {32767, 32767, 32767};
+            qint16 quantizedMax[3] = {-32767, -32767, -32767};
+            for (const auto &position: vertexPositions) {
+                QVector3D offset = (position - center) / scale;
+                for (int i = 0; i < 3; ++i) {
+                    qint16 value = (qint16)qBound(-32767, (int)std::round(offset[i]), 32767);
+                    quantizedMin[i] = std::min(quantizedMin[i], value);
+                    quantizedMax[i] = std::max(quantizedMax[i], value);
+                    binStream << value;
+                }
+                binStream << (qint16)0;
+            }
+            endBufferView(34962, 4 * sizeof(qint16));
+            addAccessor("xyz", 5122, vertexPositions.size(), "VEC3", false);
+            m_json["accessors"][bufferViewIndex]["max"] = {quantizedMax[0], quantizedMax[1], quantizedMax[2]};
+            m_json["accessors"][bufferViewIndex]["min"] = {quantizedMin[0], quantizedMin[1], quantizedMin[2]};
+            m_json["nodes"][0]["translation"] = {center.x(), center.y(), center.z()};
+            m_json["nodes"][0]["scale"] = {scale, scale, scale};
+        } else {
+            for (const auto &position: vertexPositions)
+                binStream << (float)position.x() << (float)position.y() << (float)position.z();
+            endBufferView(34962, 0);
+            addAccessor("xyz", 5126, vertexPositions.size(), "VEC3", false);
+            m_json["accessors"][bufferViewIndex]["max"] = {maxX, maxY, maxZ};
+            m_json["accessors"][bufferViewIndex]["min"] = {minX, minY, minZ};
+        }
         bufferViewIndex++;
         
         if (m_outputNormal) {
-            bufferViewFromOffset = (int)m_binByteArray.size();
-            m_json["bufferViews"][bufferViewIndex]["buffer"] = 0;
-            m_json["bufferViews"][bufferViewIndex]["byteOffset"] = bufferViewFromOffset;
+            beginBufferView();
             QStringList normalList;
-            for (const auto &normals: (*triangleVertexNormals)) {
-                for (const auto &it: normals) {
+            for (const auto &it: vertexNormals) {
+                if (quantizeNormal) {
+                    binStream << (qint8)qBound(-127, (int)std::round(it.x() * 127), 127)
+                        << (qint8)qBound(-127, (int)std::round(it.y() * 127), 127)
+                        << (qint8)qBound(-127, (int)std::round(it.z() * 127), 127)
+                        << (qint8)0;
+                } else {
                     binStream << (float)it.x() << (float)it.y() << (float)it.z();
-                    if (m_enableComment && m_outputNormal)
-                        normalList.append(QString("<%1,%2,%3>").arg(QString::number(it.x())).arg(QString::number(it.y())).arg(QString::number(it.z())));
                 }
+                if (m_enableComment)
+                    normalList.append(QString("<%1,%2,%3>").arg(QString::number(it.x())).arg(QString::number(it.y())).arg(QString::number(it.z())));
             }
-            Q_ASSERT((int)triangleVertexNormals->size() * 3 * 3 * sizeof(float) == m_binByteArray.size() - bufferViewFromOffset);
-            m_json["bufferViews"][bufferViewIndex]["byteLength"] =  triangleVertexNormals->size() * 3 * 3 * sizeof(float);
-            m_json["bufferViews"][bufferViewIndex]["target"] = 34962;
-            alignBin();
-            if (m_enableComment)
-                m_json["accessors"][bufferViewIndex]["__comment"] = QString("/accessors/%1: normal %2").arg(QString::number(bufferViewIndex)).arg(normalList.join(" ")).toUtf8().constData();
-            m_json["accessors"][bufferViewIndex]["bufferView"] = bufferViewIndex;
-            m_json["accessors"][bufferViewIndex]["byteOffset"] = 0;
-            m_json["accessors"][bufferViewIndex]["componentType"] = 5126;
-            m_json["accessors"][bufferViewIndex]["count"] =  triangleVertexNormals->size() * 3;
-            m_json["accessors"][bufferViewIndex]["type"] = "VEC3";
+            endBufferView(34962, quantizeNormal ? 4 : 0);
+            addAccessor("normal " + normalList.join(" "), quantizeNormal ? 5120 : 5126, vertexNormals.size(), "VEC3", quantizeNormal);
             bufferViewIndex++;
         }
         
         if (m_outputUv) {
-            bufferViewFromOffset = (int)m_binByteArray.size();
-            m_json["bufferViews"][bufferViewIndex]["buffer"] = 0;
-            m_json["bufferViews"][bufferViewIndex]["byteOffset"] = bufferViewFromOffset;
-            for (const auto &uvs: (*triangleVertexUvs)) {
-                for (const auto &it: uvs)
+            beginBufferView();
+            for (const auto &it: vertexUvs) {
+                if (quantizeUv) {
+                    binStream << (quint16)std::round(it.x() * 65535) << (quint16)std::round(it.y() * 65535);
+                } else {
                     binStream << (float)it.x() << (float)it.y();
+                }
             }
-            m_json["bufferViews"][bufferViewIndex]["byteLength"] = m_binByteArray.size() - bufferViewFromOffset;
-            alignBin();
-            if (m_enableComment)
-                m_json["accessors"][bufferViewIndex]["__comment"] = QString("/accessors/%1: uv").arg(QString::number(bufferViewIndex)).toUtf8().constData();
-            m_json["accessors"][bufferViewIndex]["bufferView"] = bufferViewIndex;
-            m_json["accessors"][bufferViewIndex]["byteOffset"] = 0;
-            m_json["accessors"][bufferViewIndex]["componentType"] = 5126;
-            m_json["accessors"][bufferViewIndex]["count"] =  triangleVertexUvs->size() * 3;
-            m_json["accessors"][bufferViewIndex]["type"] = "VEC2";
+            endBufferView(34962, 0);
+            addAccessor("uv", quantizeUv ? 5123 : 5126, vertexUvs.size(), "VEC2", quantizeUv);
             bufferViewIndex++;
         }
         
-        if (resultRigWeights && !resultRigWeights->empty()) {
-            bufferViewFromOffset = (int)m_binByteArray.size();
-            m_json["bufferViews"][bufferViewIndex]["buffer"] = 0;
-            m_json["bufferViews"][bufferViewIndex]["byteOffset"] = bufferViewFromOffset;
+        if (hasWeights) {
+            beginBufferView();
             QStringList boneList;
             int weightItIndex = 0;
-            for (const auto &oldIndex: triangleVertexOldIndices) {
+            for (const auto &oldIndex: vertexOldIndices) {
                 auto i = 0u;
                 if (m_enableComment)
                     boneList.append(QString("%1:<").arg(QString::number(weightItIndex)));
@@ -303,13 +395,19 @@ GlbFileWriter::GlbFileWriter(Outcome &outcome,
                 if (findWeight != resultRigWeights->end()) {
                     for (; i < MAX_WEIGHT_NUM; i++) {
                         quint16 nodeIndex = (quint16)findWeight->second.boneIndices[i];
-                        binStream << (quint16)nodeIndex;
+                        if (quantizeJoints)
+                            binStream << (quint8)nodeIndex;
+                        else
+                            binStream << (quint16)nodeIndex;
                         if (m_enableComment)
                             boneList.append(QString("%1").arg(nodeIndex));
                     }
                 }
                 for (; i < MAX_WEIGHT_NUM; i++) {
-                    binStream << (quint16)0;
+                    if (quantizeJoints)
+                        binStream << (quint8)0;
+                    else
+                        binStream << (quint16)0;
                     if (m_enableComment)
                         boneList.append(QString("%1").arg(0));
                 }
@@ -317,53 +415,50 @@ GlbFileWriter::GlbFileWriter(Outcome &outcome,
                     boneList.append(QString(">"));
                 weightItIndex++;
             }
-            m_json["bufferViews"][bufferViewIndex]["byteLength"] = m_binByteArray.size() - bufferViewFromOffset;
-            alignBin();
-            if (m_enableComment)
-                m_json["accessors"][bufferViewIndex]["__comment"] = QString("/accessors/%1: bone indices %2").arg(QString::number(bufferViewIndex)).arg(boneList.join(" ")).toUtf8().constData();
-            m_json["accessors"][bufferViewIndex]["bufferView"] = bufferViewIndex;
-            m_json["accessors"][bufferViewIndex]["byteOffset"] = 0;
-            m_json["accessors"][bufferViewIndex]["componentType"] = 5123;
-            m_json["accessors"][bufferViewIndex]["count"] =  triangleVertexOldIndices.size();
-            m_json["accessors"][bufferViewIndex]["type"] = "VEC4";
+            endBufferView(0, 0);
+            addAccessor("bone indices " + boneList.join(" "), quantizeJoints ? 5121 : 5123, vertexOldIndices.size(), "VEC4", false);
             bufferViewIndex++;
             
-            bufferViewFromOffset = (int)m_binByteArray.size();
-            m_json["bufferViews"][bufferViewIndex]["buffer"] = 0;
-            m_json["bufferViews"][bufferViewIndex]["byteOffset"] = bufferViewFromOffset;
+            beginBufferView();
             QStringList weightList;
             weightItIndex = 0;
-            for (const auto &oldIndex: triangleVertexOldIndices) {
-                auto i = 0u;
-                if (m_enableComment)
-                    weightList.append(QString("%1:<").arg(QString::number(weightItIndex)));
+            for (const auto &oldIndex: vertexOldIndices) {
+                float weights[MAX_WEIGHT_NUM] = {0};
                 auto findWeight = resultRigWeights->find(oldIndex);
                 if (findWeight != resultRigWeights->end()) {
-                    for (; i < MAX_WEIGHT_NUM; i++) {
-                        float weight = (float)findWeight->second.boneWeights[i];
-                        binStream << (float)weight;
-                        if (m_enableComment)
-                            weightList.append(QString("%1").arg(QString::number((float)weight)));
-                    }
-                }
-                for (; i < MAX_WEIGHT_NUM; i++) {
-                    binStream << (float)0.0;
-                    if (m_enableComment)
-                        weightList.append(QString("%1").arg(QString::number(0.0)));
+                    for (auto i = 0u; i < MAX_WEIGHT_NUM; i++)
+                        weights[i] = (float)findWeight->second.boneWeights[i];
                 }
                 if (m_enableComment)
+                    weightList.append(QString("%1:<").arg(QString::number(weightItIndex)));
+                if (quantizeWeights) {
+                    // Rounding error goes to the largest weight, so the quantized weights still sum up to one
+                    int quantizedWeights[MAX_WEIGHT_NUM] = {0};
+                    int sum = 0;
+                    size_t largest = 0;
+                    for (auto i = 0u; i < MAX_WEIGHT_NUM; i++) {
+                        quantizedWeights[i] = qBound(0, (int)std::round(weights[i] * 255), 255);
+                        sum += quantizedWeights[i];
+                        if (weights[i] > weights[largest])
+                            largest = i;
+                    }
+                    if (sum > 0)
+                        quantizedWeights[largest] = qBound(0, quantizedWeights[largest] + 255 - sum, 255);
+                    for (auto i = 0u; i < MAX_WEIGHT_NUM; i++)
+                        binStream << (quint8)quantizedWeights[i];
+                } else {
+                    for (auto i = 0u; i < MAX_WEIGHT_NUM; i++)
+                        binStream << (float)weights[i];
+                }
+                if (m_enableComment) {
+                    for (auto i = 0u; i < MAX_WEIGHT_NUM; i++)
+                        weightList.append(QString("%1").arg(QString::number(weights[i])));
                     weightList.append(QString(">"));
+                }
                 weightItIndex++;
             }
-            m_json["bufferViews"][bufferViewIndex]["byteLength"] = m_binByteArray.size() - bufferViewFromOffset;
-            alignBin();
-            if (m_enableComment)
-                m_json["accessors"][bufferViewIndex]["__comment"] = QString("/accessors/%1: bone weights %2").arg(QString::number(bufferViewIndex)).arg(weightList.join(" ")).toUtf8().constData();
-            m_json["accessors"][bufferViewIndex]["bufferView"] = bufferViewIndex;
-            m_json["accessors"][bufferViewIndex]["byteOffset"] = 0;
-            m_json["accessors"][bufferViewIndex]["componentType"] = 5126;
-            m_json["accessors"][bufferViewIndex]["count"] = triangleVertexOldIndices.size();
-            m_json["accessors"][bufferViewIndex]["type"] = "VEC4";
+            endBufferView(0, 0);
+            addAccessor("bone weights " + weightList.join(" "), quantizeWeights ? 5121 : 5126, vertexOldIndices.size(), "VEC4", quantizeWeights);
             bufferViewIndex++;
         }
     }
@@ -23,7 +23,8 @@ public:
         QImage *textureImage=nullptr,
         QImage *normalImage=nullptr,
         QImage *ormImage=nullptr,
-        const std::vector<std::pair<QString, std::vector<std::pair<float, JointNodeTree>>>> *motions=nullptr);
+        const std::vector<std::pair<QString, std::vector<std::pair<float, JointNodeTree>>>> *motions=nullptr,
+        bool enableQuantization=false);
     bool save();
 private:
     QString m_filename;
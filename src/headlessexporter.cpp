@@ -0,0 +1,254 @@
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/task_arena.h>
+#include <QElapsedTimer>
+#include <QXmlStreamReader>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+#include <map>
+#include "headlessexporter.h"
+#include "ds3file.h"
+#include "snapshot.h"
+#include "snapshotxml.h"
+#include "imageforever.h"
+#include "meshgenerator.h"
+#include "meshresultpostprocessor.h"
+#include "texturegenerator.h"
+#include "riggenerator.h"
+#include "rigtype.h"
+#include "glbfile.h"
+#include "fbxfile.h"
+#include "util.h"
+#include "profiler.h"
+
+// Different documents may embed the same image, keep it alive until the last exporter using it has finished
+static std::map<QUuid, int> g_imageRefCounts;
+static QMutex g_imageRefCountsMutex;
+
+HeadlessExporter::HeadlessExporter(const QString &inputFilename, const QStringList &outputFilenames) :
+    m_inputFilename(inputFilename),
+    m_outputFilenames(outputFilenames)
+{
+}
+
+HeadlessExporter::~HeadlessExporter()
+{
+    releaseImages();
+}
+
+void HeadlessExporter::setEnableQuantization(bool enabled)
+{
+    m_enableQuantization = enabled;
+}
+
+const QString &HeadlessExporter::inputFilename()
+{
+    return m_inputFilename;
+}
+
+const QStringList &HeadlessExporter::outputFilenames()
+{
+    return m_outputFilenames;
+}
+
+bool HeadlessExporter::isSucceed()
+{
+    return m_isSucceed;
+}
+
+const std::vector<std::pair<QString, qint64>> &HeadlessExporter::stageTimings()
+{
+    return m_stageTimings;
+}
+
+void HeadlessExporter::addImage(const QUuid &imageId, const QImage &image)
+{
+    if (m_imageIds.find(imageId) != m_imageIds.end())
+        return;
+    QMutexLocker locker(&g_imageRefCountsMutex);
+    (void)ImageForever::add(&image, imageId);
+    g_imageRefCounts[imageId]++;
+    m_imageIds.insert(imageId);
+}
+
+void HeadlessExporter::releaseImages()
+{
+    QMutexLocker locker(&g_imageRefCountsMutex);
+    for (const auto &imageId: m_imageIds) {
+        auto findRefCount = g_imageRefCounts.find(imageId);
+        if (findRefCount == g_imageRefCounts.end())
+            continue;
+        if (--findRefCount->second > 0)
+            continue;
+        g_imageRefCounts.erase(findRefCount);
+        ImageForever::remove(imageId);
+    }
+    m_imageIds.clear();
+}
+
+void HeadlessExporter::exportFiles()
+{
+    m_isSucceed = false;
+    m_stageTimings.clear();
+    
+    Profiler::Scope profile("export", "headless");
+
+    QElapsedTimer countTimeConsumed;
+    countTimeConsumed.start();
+    auto finishStage = [&](const QString &name) {
+        m_stageTimings.push_back({name, countTimeConsumed.restart()});
+    };
+
+    Ds3FileReader ds3Reader(m_inputFilename);
+    Snapshot snapshot;
+    bool hasModel = false;
+    std::map<QUuid, QImage> images;
+    ds3Reader.loadImages(&images);
+    for (const auto &it: images)
+        addImage(it.first, it.second);
+    for (int i = 0; i < ds3Reader.items().size(); ++i) {
+        const Ds3ReaderItem &item = ds3Reader.items().at(i);
+        if (item.type == "model") {
+            QByteArray data = ds3Reader.itemView(item.name);
+            QXmlStreamReader stream(data);
+            loadSkeletonFromXmlStream(&snapshot, stream);
+            hasModel = true;
+        }
+    }
+    if (!hasModel) {
+        qDebug() << "No model found in" << m_inputFilename;
+        return;
+    }
+    if (snapshot.canvas.find("originX") == snapshot.canvas.end() ||
+            snapshot.canvas.find("originY") == snapshot.canvas.end() ||
+            snapshot.canvas.find("originZ") == snapshot.canvas.end()) {
+        QRectF mainProfile;
+        QRectF sideProfile;
+        snapshot.resolveBoundingBox(&mainProfile, &sideProfile);
+        snapshot.canvas["originX"] = QString::number(mainProfile.x() + mainProfile.width() / 2);
+        snapshot.canvas["originY"] = QString::number(mainProfile.y() + mainProfile.height() / 2);
+        snapshot.canvas["originZ"] = QString::number(sideProfile.x() + sideProfile.width() / 2);
+    }
+    finishStage("load");
+
+    MeshGenerator *meshGenerator = new MeshGenerator(new Snapshot(snapshot));
+    meshGenerator->generate();
+    bool meshSucceed = meshGenerator->isSucceed();
+    Outcome *outcome = meshGenerator->takeOutcome();
+    MeshLoader *resultMesh = meshGenerator->takeResultMesh();
+    delete meshGenerator;
+    finishStage("mesh");
+    if (nullptr == outcome) {
+        qDebug() << "Mesh generation failed for" << m_inputFilename;
+        delete resultMesh;
+        return;
+    }
+
+    MeshResultPostProcessor *postProcessor = new MeshResultPostProcessor(*outcome);
+    postProcessor->poseProcess();
+    Outcome *postProcessedOutcome = postProcessor->takePostProcessedOutcome();
+    delete postProcessor;
+    delete outcome;
+    finishStage("postprocess");
+
+    TextureGenerator *textureGenerator = new TextureGenerator(*postProcessedOutcome, new Snapshot(snapshot));
+    textureGenerator->generate();
+    bool textureHasTransparencySettings = textureGenerator->hasTransparencySettings();
+    QImage *textureImage = textureGenerator->takeResultTextureImage();
+    QImage *textureNormalImage = textureGenerator->takeResultTextureNormalImage();
+    QImage *textureMetalnessRoughnessAmbientOcclusionImage = textureGenerator->takeResultTextureMetalnessRoughnessAmbientOcclusionImage();
+    QImage *textureMetalnessImage = textureGenerator->takeResultTextureMetalnessImage();
+    QImage *textureRoughnessImage = textureGenerator->takeResultTextureRoughnessImage();
+    QImage *textureAmbientOcclusionImage = textureGenerator->takeResultTextureAmbientOcclusionImage();
+    delete textureGenerator;
+    finishStage("texture");
+
+    std::vector<RiggerBone> *resultRigBones = nullptr;
+    std::map<int, RiggerVertexWeights> *resultRigWeights = nullptr;
+    RigType rigType = RigTypeFromString(valueOfKeyInMapOrEmpty(snapshot.canvas, "rigType").toUtf8().constData());
+    if (RigType::None != rigType) {
+        RigGenerator *rigGenerator = new RigGenerator(rigType, *postProcessedOutcome);
+        rigGenerator->generate();
+        if (rigGenerator->isSucceed()) {
+            resultRigBones = rigGenerator->takeResultBones();
+            resultRigWeights = rigGenerator->takeResultWeights();
+        }
+        delete rigGenerator;
+    }
+    finishStage("rig");
+
+    bool writeSucceed = true;
+    for (const auto &filename: m_outputFilenames) {
+        if (filename.endsWith(".obj")) {
+            if (nullptr != resultMesh)
+                resultMesh->exportAsObj(filename);
+        } else if (filename.endsWith(".fbx")) {
+            FbxFileWriter fbxFileWriter(*postProcessedOutcome, resultRigBones, resultRigWeights, filename,
+                textureImage,
+                textureNormalImage,
+                textureMetalnessImage,
+                textureRoughnessImage,
+                textureAmbientOcclusionImage);
+            if (!fbxFileWriter.save())
+                writeSucceed = false;
+        } else if (filename.endsWith(".glb")) {
+            GlbFileWriter glbFileWriter(*postProcessedOutcome, resultRigBones, resultRigWeights, filename,
+                textureHasTransparencySettings,
+                textureImage, textureNormalImage, textureMetalnessRoughnessAmbientOcclusionImage,
+                nullptr, m_enableQuantization);
+            if (!glbFileWriter.save())
+                writeSucceed = false;
+        } else {
+            qDebug() << "Unsupported export format:" << filename;
+            writeSucceed = false;
+        }
+    }
+    finishStage("write");
+
+    delete resultRigBones;
+    delete resultRigWeights;
+    delete textureImage;
+    delete textureNormalImage;
+    delete textureMetalnessRoughnessAmbientOcclusionImage;
+    delete textureMetalnessImage;
+    delete textureRoughnessImage;
+    delete textureAmbientOcclusionImage;
+    delete postProcessedOutcome;
+    delete resultMesh;
+
+    releaseImages();
+
+    m_isSucceed = meshSucceed && writeSucceed;
+}
+
+class HeadlessExportWorker
+{
+public:
+    HeadlessExportWorker(const std::vector<HeadlessExporter *> *exporters) :
+        m_exporters(exporters)
+    {
+    }
+    void operator()(const tbb::blocked_range<size_t> &range) const
+    {
+        for (size_t i = range.begin(); i != range.end(); ++i) {
+            (*m_exporters)[i]->exportFiles();
+        }
+    }
+private:
+    const std::vector<HeadlessExporter *> *m_exporters = nullptr;
+};
+
+bool HeadlessExporter::exportInParallel(const std::vector<HeadlessExporter *> &exporters, int maxConcurrency)
+{
+    tbb::task_arena arena(maxConcurrency > 0 ? maxConcurrency : tbb::task_arena::automatic);
+    arena.execute([&]() {
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, exporters.size(), 1),
+            HeadlessExportWorker(&exporters));
+    });
+    for (const auto &exporter: exporters) {
+        if (!exporter->isSucceed())
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef DUST3D_HEADLESS_EXPORTER_H
+#define DUST3D_HEADLESS_EXPORTER_H
+#include <QString>
+#include <QStringList>
+#include <QUuid>
+#include <QImage>
+#include <vector>
+#include <set>
+
+class HeadlessExporter
+{
+public:
+    HeadlessExporter(const QString &inputFilename, const QStringList &outputFilenames);
+    ~HeadlessExporter();
+    void setEnableQuantization(bool enabled);
+    const QString &inputFilename();
+    const QStringList &outputFilenames();
+    bool isSucceed();
+    const std::vector<std::pair<QString, qint64>> &stageTimings();
+    void exportFiles();
+    static bool exportInParallel(const std::vector<HeadlessExporter *> &exporters, int maxConcurrency=0);
+private:
+    QString m_inputFilename;
+    QStringList m_outputFilenames;
+    bool m_isSucceed = false;
+    bool m_enableQuantization = false;
+    std::vector<std::pair<QString, qint64>> m_stageTimings;
+    std::set<QUuid> m_imageIds;
+
+    void addImage(const QUuid &imageId, const QImage &image);
+    void releaseImages();
+};
+
+#endif
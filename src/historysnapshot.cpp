@@ -0,0 +1,211 @@
+#include <vector>
+#include "historysnapshot.h"
+
+namespace
+{
+
+// Serializes values for hashing and roughly estimates the memory they take
+class EntrySerializer
+{
+public:
+    std::vector<unsigned char> buffer;
+    size_t memoryUsage = 0;
+
+    void add(const QString &string);
+    template <class First, class Second>
+    void add(const std::pair<First, Second> &pair);
+    template <class Key, class Value>
+    void add(const std::map<Key, Value> &map);
+    template <class T>
+    void add(const std::vector<T> &vector);
+};
+
+void EntrySerializer::add(const QString &string)
+{
+    auto byteArray = string.toUtf8();
+    buffer.insert(buffer.end(), byteArray.begin(), byteArray.end());
+    // QString header, shared data header and UTF-16 payload
+    memoryUsage += sizeof(QString) + 24 + string.size() * sizeof(QChar);
+}
+
+template <class First, class Second>
+void EntrySerializer::add(const std::pair<First, Second> &pair)
+{
+    add(pair.first);
+    add(pair.second);
+}
+
+template <class Key, class Value>
+void EntrySerializer::add(const std::map<Key, Value> &map)
+{
+    // Tree node links and color
+    memoryUsage += sizeof(std::map<Key, Value>) + map.size() * 4 * sizeof(void *);
+    for (const auto &item: map)
+        add(item);
+}
+
+template <class T>
+void EntrySerializer::add(const std::vector<T> &vector)
+{
+    memoryUsage += sizeof(std::vector<T>);
+    for (const auto &item: vector)
+        add(item);
+}
+
+uint64_t combineHashes(const std::vector<uint64_t> &hashes)
+{
+    return crc64(0, (const unsigned char *)hashes.data(), hashes.size() * sizeof(uint64_t));
+}
+
+}
+
+template <class T>
+std::shared_ptr<const HistorySnapshot::Entry<T>> HistorySnapshot::shareEntry(const QString &key, const T &value,
+    const std::shared_ptr<const Entry<T>> &previous)
+{
+    if (nullptr != previous && previous->value == value)
+        return previous;
+    std::shared_ptr<Entry<T>> entry = std::make_shared<Entry<T>>();
+    entry->value = value;
+    EntrySerializer serializer;
+    serializer.add(key);
+    serializer.add(value);
+    entry->hash = crc64(0, serializer.buffer.data(), serializer.buffer.size());
+    entry->memoryUsage = sizeof(Entry<T>) + serializer.memoryUsage;
+    m_unsharedMemoryUsage += entry->memoryUsage;
+    return entry;
+}
+
+std::shared_ptr<const HistorySnapshot::Category> HistorySnapshot::shareCategory(const std::map<QString, Attributes> &items,
+    const std::shared_ptr<const Category> &previous)
+{
+    std::shared_ptr<Category> category = std::make_shared<Category>();
+    bool allShared = nullptr != previous && previous->entries.size() == items.size();
+    std::vector<uint64_t> hashes;
+    hashes.reserve(items.size());
+    for (const auto &item: items) {
+        AttributesEntry previousEntry;
+        if (nullptr != previous) {
+            auto findPrevious = previous->entries.find(item.first);
+            if (findPrevious != previous->entries.end())
+                previousEntry = findPrevious->second;
+        }
+        auto entry = shareEntry(item.first, item.second, previousEntry);
+        if (entry != previousEntry)
+            allShared = false;
+        hashes.push_back(entry->hash);
+        category->entries.insert(category->entries.end(), {item.first, entry});
+    }
+    if (allShared)
+        return previous;
+    category->hash = combineHashes(hashes);
+    category->memoryUsage = sizeof(Category) + items.size() * (sizeof(QString) + sizeof(AttributesEntry) + 4 * sizeof(void *));
+    m_unsharedMemoryUsage += category->memoryUsage;
+    return category;
+}
+
+HistorySnapshot::HistorySnapshot(const Snapshot &snapshot, const HistorySnapshot *previous)
+{
+    m_canvas = shareEntry(QString("canvas"), snapshot.canvas, nullptr == previous ? nullptr : previous->m_canvas);
+    m_nodes = shareCategory(snapshot.nodes, nullptr == previous ? nullptr : previous->m_nodes);
+    m_edges = shareCategory(snapshot.edges, nullptr == previous ? nullptr : previous->m_edges);
+    m_parts = shareCategory(snapshot.parts, nullptr == previous ? nullptr : previous->m_parts);
+    m_components = shareCategory(snapshot.components, nullptr == previous ? nullptr : previous->m_components);
+    m_rootComponent = shareEntry(QString("rootComponent"), snapshot.rootComponent, nullptr == previous ? nullptr : previous->m_rootComponent);
+    m_poses = shareEntry(QString("poses"), snapshot.poses, nullptr == previous ? nullptr : previous->m_poses);
+    m_motions = shareEntry(QString("motions"), snapshot.motions, nullptr == previous ? nullptr : previous->m_motions);
+    m_materials = shareEntry(QString("materials"), snapshot.materials, nullptr == previous ? nullptr : previous->m_materials);
+    m_hash = combineHashes({
+        m_canvas->hash,
+        m_nodes->hash,
+        m_edges->hash,
+        m_parts->hash,
+        m_components->hash,
+        m_rootComponent->hash,
+        m_poses->hash,
+        m_motions->hash,
+        m_materials->hash
+    });
+}
+
+void HistorySnapshot::toSnapshot(Snapshot *snapshot) const
+{
+    auto expandCategory = [](const Category &category, std::map<QString, Attributes> *items) {
+        for (const auto &it: category.entries)
+            items->insert(items->end(), {it.first, it.second->value});
+    };
+    snapshot->canvas = m_canvas->value;
+    expandCategory(*m_nodes, &snapshot->nodes);
+    expandCategory(*m_edges, &snapshot->edges);
+    expandCategory(*m_parts, &snapshot->parts);
+    expandCategory(*m_components, &snapshot->components);
+    snapshot->rootComponent = m_rootComponent->value;
+    snapshot->poses = m_poses->value;
+    snapshot->motions = m_motions->value;
+    snapshot->materials = m_materials->value;
+}
+
+uint64_t HistorySnapshot::hash() const
+{
+    return m_hash;
+}
+
+bool HistorySnapshot::isSameAs(const HistorySnapshot &other) const
+{
+    if (m_hash != other.m_hash)
+        return false;
+    auto isSameCategory = [](const Category &first, const Category &second) {
+        if (&first == &second)
+            return true;
+        if (first.entries.size() != second.entries.size())
+            return false;
+        auto secondIt = second.entries.begin();
+        for (const auto &it: first.entries) {
+            if (it.first != secondIt->first)
+                return false;
+            if (it.second != secondIt->second && it.second->value != secondIt->second->value)
+                return false;
+            ++secondIt;
+        }
+        return true;
+    };
+    return (m_canvas == other.m_canvas || m_canvas->value == other.m_canvas->value) &&
+        isSameCategory(*m_nodes, *other.m_nodes) &&
+        isSameCategory(*m_edges, *other.m_edges) &&
+        isSameCategory(*m_parts, *other.m_parts) &&
+        isSameCategory(*m_components, *other.m_components) &&
+        (m_rootComponent == other.m_rootComponent || m_rootComponent->value == other.m_rootComponent->value) &&
+        (m_poses == other.m_poses || m_poses->value == other.m_poses->value) &&
+        (m_motions == other.m_motions || m_motions->value == other.m_motions->value) &&
+        (m_materials == other.m_materials || m_materials->value == other.m_materials->value);
+}
+
+size_t HistorySnapshot::unsharedMemoryUsage() const
+{
+    return m_unsharedMemoryUsage;
+}
+
+void HistorySnapshot::collectMemoryUsage(std::set<const void *> *visited, size_t *memoryUsage) const
+{
+    auto collectEntry = [&](const void *pointer, size_t entryMemoryUsage) {
+        if (visited->insert(pointer).second)
+            *memoryUsage += entryMemoryUsage;
+    };
+    auto collectCategory = [&](const Category &category) {
+        if (!visited->insert(&category).second)
+            return;
+        *memoryUsage += category.memoryUsage;
+        for (const auto &it: category.entries)
+            collectEntry(it.second.get(), it.second->memoryUsage);
+    };
+    *memoryUsage += sizeof(HistorySnapshot);
+    collectEntry(m_canvas.get(), m_canvas->memoryUsage);
+    collectCategory(*m_nodes);
+    collectCategory(*m_edges);
+    collectCategory(*m_parts);
+    collectCategory(*m_components);
+    collectEntry(m_rootComponent.get(), m_rootComponent->memoryUsage);
+    collectEntry(m_poses.get(), m_poses->memoryUsage);
+    collectEntry(m_motions.get(), m_motions->memoryUsage);
+    collectEntry(m_materials.get(), m_materials->memoryUsage);
+}
@@ -0,0 +1,67 @@
+#ifndef DUST3D_HISTORY_SNAPSHOT_H
+#define DUST3D_HISTORY_SNAPSHOT_H
+#include <QString>
+#include <map>
+#include <set>
+#include <memory>
+#include "snapshot.h"
+
+// A Snapshot kept in the undo history.
+// Every node, edge, part and component is stored as an immutable entry,
+// entries and whole categories which are unchanged since the previous
+// history item are shared with it instead of being copied again, and the
+// hash of an entry is only calculated once, when the entry is created.
+class HistorySnapshot
+{
+public:
+    typedef std::map<QString, QString> Attributes;
+
+    template <class T>
+    struct Entry
+    {
+        T value;
+        uint64_t hash = 0;
+        size_t memoryUsage = 0;
+    };
+
+    typedef std::shared_ptr<const Entry<Attributes>> AttributesEntry;
+
+    struct Category
+    {
+        std::map<QString, AttributesEntry> entries;
+        uint64_t hash = 0;
+        size_t memoryUsage = 0;
+    };
+
+    typedef decltype(Snapshot::poses) Poses;
+    typedef decltype(Snapshot::motions) Motions;
+    typedef decltype(Snapshot::materials) Materials;
+
+    HistorySnapshot(const Snapshot &snapshot, const HistorySnapshot *previous=nullptr);
+    void toSnapshot(Snapshot *snapshot) const;
+    uint64_t hash() const;
+    bool isSameAs(const HistorySnapshot &other) const;
+    size_t unsharedMemoryUsage() const;
+    void collectMemoryUsage(std::set<const void *> *visited, size_t *memoryUsage) const;
+
+private:
+    AttributesEntry m_canvas;
+    std::shared_ptr<const Category> m_nodes;
+    std::shared_ptr<const Category> m_edges;
+    std::shared_ptr<const Category> m_parts;
+    std::shared_ptr<const Category> m_components;
+    AttributesEntry m_rootComponent;
+    std::shared_ptr<const Entry<Poses>> m_poses;
+    std::shared_ptr<const Entry<Motions>> m_motions;
+    std::shared_ptr<const Entry<Materials>> m_materials;
+    uint64_t m_hash = 0;
+    size_t m_unsharedMemoryUsage = 0;
+
+    template <class T>
+    std::shared_ptr<const Entry<T>> shareEntry(const QString &key, const T &value,
+        const std::shared_ptr<const Entry<T>> &previous);
+    std::shared_ptr<const Category> shareCategory(const std::map<QString, Attributes> &items,
+        const std::shared_ptr<const Category> &previous);
+};
+
+#endif
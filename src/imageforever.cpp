@@ -1,69 +1,103 @@
 #include <map>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QReadLocker>
+#include <QWriteLocker>
 #include <QtCore/qbuffer.h>
 #include "imageforever.h"
 
 struct ImageForeverItem
 {
-    QImage *image;
-    QUuid id;
-    QByteArray *imageByteArray;
+    std::shared_ptr<const QImage> image;
+    QMutex pngByteArrayMutex;
+    std::shared_ptr<const QByteArray> pngByteArray;
 };
-static std::map<QUuid, ImageForeverItem> g_foreverMap;
-static QMutex g_mapMutex;
 
-const QImage *ImageForever::get(const QUuid &id)
+// Items are reference counted, a removed image stays alive until the last reader has released it
+static std::map<QUuid, std::shared_ptr<ImageForeverItem>> g_foreverMap;
+static QReadWriteLock g_mapLock;
+
+static std::shared_ptr<ImageForeverItem> findItem(const QUuid &id)
 {
-    QMutexLocker locker(&g_mapMutex);
+    QReadLocker locker(&g_mapLock);
     auto findResult = g_foreverMap.find(id);
     if (findResult == g_foreverMap.end())
         return nullptr;
-    return findResult->second.image;
+    return findResult->second;
+}
+
+// PNG is only needed when saving, so it is encoded on first request instead of on add
+static std::shared_ptr<const QByteArray> encodePngByteArray(ImageForeverItem *item)
+{
+    QMutexLocker locker(&item->pngByteArrayMutex);
+    if (nullptr == item->pngByteArray) {
+        QByteArray *imageByteArray = new QByteArray();
+        QBuffer pngBuffer(imageByteArray);
+        pngBuffer.open(QIODevice::WriteOnly);
+        item->image->save(&pngBuffer, "PNG");
+        item->pngByteArray.reset(imageByteArray);
+    }
+    return item->pngByteArray;
+}
+
+const QImage *ImageForever::get(const QUuid &id)
+{
+    auto item = findItem(id);
+    if (nullptr == item)
+        return nullptr;
+    return item->image.get();
+}
+
+std::shared_ptr<const QImage> ImageForever::getSharedImage(const QUuid &id)
+{
+    auto item = findItem(id);
+    if (nullptr == item)
+        return nullptr;
+    return item->image;
 }
 
 void ImageForever::copy(const QUuid &id, QImage &image)
 {
-    QMutexLocker locker(&g_mapMutex);
-    auto findResult = g_foreverMap.find(id);
-    if (findResult == g_foreverMap.end())
+    auto item = findItem(id);
+    if (nullptr == item)
         return;
-    image = *findResult->second.image;
+    image = *item->image;
 }
 
-const QByteArray *ImageForever::getPngByteArray(const QUuid &id)
+std::shared_ptr<const QByteArray> ImageForever::getPngByteArray(const QUuid &id)
 {
-    QMutexLocker locker(&g_mapMutex);
-    auto findResult = g_foreverMap.find(id);
-    if (findResult == g_foreverMap.end())
+    auto item = findItem(id);
+    if (nullptr == item)
         return nullptr;
-    return findResult->second.imageByteArray;
+    return encodePngByteArray(item.get());
 }
 
 QUuid ImageForever::add(const QImage *image, QUuid toId)
 {
-    QMutexLocker locker(&g_mapMutex);
     if (nullptr == image)
         return QUuid();
     QUuid newId = toId.isNull() ? QUuid::createUuid() : toId;
+    std::shared_ptr<ImageForeverItem> item = std::make_shared<ImageForeverItem>();
+    item->image = std::make_shared<const QImage>(*image);
+    QWriteLocker locker(&g_mapLock);
     if (g_foreverMap.find(newId) != g_foreverMap.end())
         return newId;
-    QImage *newImage = new QImage(*image);
-    QByteArray *imageByteArray = new QByteArray();
-    QBuffer pngBuffer(imageByteArray);
-    pngBuffer.open(QIODevice::WriteOnly);
-    newImage->save(&pngBuffer, "PNG");
-    g_foreverMap[newId] = {newImage, newId, imageByteArray};
+    g_foreverMap[newId] = item;
     return newId;
 }
 
 void ImageForever::remove(const QUuid &id)
 {
-    QMutexLocker locker(&g_mapMutex);
-    auto findImage = g_foreverMap.find(id);
-    if (findImage == g_foreverMap.end())
-        return;
-    delete findImage->second.image;
-    delete findImage->second.imageByteArray;
-    g_foreverMap.erase(id);
+    std::shared_ptr<ImageForeverItem> item;
+    {
+        QWriteLocker locker(&g_mapLock);
+        auto findImage = g_foreverMap.find(id);
+        if (findImage == g_foreverMap.end())
+            return;
+        item = findImage->second;
+        g_foreverMap.erase(findImage);
+    }
+    // Released outside of the lock, freeing a large image should not stall readers
+    item.reset();
 }
@@ -3,13 +3,16 @@
 #include <QImage>
 #include <QUuid>
 #include <QByteArray>
+#include <memory>
 
 class ImageForever
 {
 public:
+    // The returned pointer is valid until the image is removed, use getSharedImage() outside the GUI thread
     static const QImage *get(const QUuid &id);
+    static std::shared_ptr<const QImage> getSharedImage(const QUuid &id);
     static void copy(const QUuid &id, QImage &image);
-    static const QByteArray *getPngByteArray(const QUuid &id);
+    static std::shared_ptr<const QByteArray> getPngByteArray(const QUuid &id);
     static QUuid add(const QImage *image, QUuid toId=QUuid());
     static void remove(const QUuid &id);
 };
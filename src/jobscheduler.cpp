@@ -0,0 +1,239 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <algorithm>
+#include "jobscheduler.h"
+#include "profiler.h"
+
+void JobRunner::setJob(const std::function<void()> &job, const char *name)
+{
+    m_job = job;
+    m_name = name;
+}
+
+void JobRunner::run()
+{
+    QElapsedTimer runTimer;
+    runTimer.start();
+    {
+        Profiler::Scope profile(m_name, "job");
+        m_job();
+    }
+    m_job = std::function<void()>();
+    emit finished(runTimer.elapsed());
+}
+
+JobScheduler &JobScheduler::instance()
+{
+    static JobScheduler *s_jobScheduler = nullptr;
+    if (nullptr == s_jobScheduler) {
+        s_jobScheduler = new JobScheduler;
+    }
+    return *s_jobScheduler;
+}
+
+const char *JobScheduler::kindName(Kind kind)
+{
+    switch (kind) {
+    case Kind::MousePick:
+        return "mousePick";
+    case Kind::ContourToPart:
+        return "contourToPart";
+    case Kind::Script:
+        return "script";
+    case Kind::Mesh:
+        return "mesh";
+    case Kind::PostProcess:
+        return "postProcess";
+    case Kind::Rig:
+        return "rig";
+    case Kind::Motions:
+        return "motions";
+    case Kind::Texture:
+        return "texture";
+    case Kind::PosePreviews:
+        return "posePreviews";
+    case Kind::MaterialPreviews:
+        return "materialPreviews";
+    default:
+        return "unknown";
+    }
+}
+
+JobScheduler::JobScheduler() :
+    m_pendingJobs((size_t)Kind::Count),
+    m_metrics((size_t)Kind::Count)
+{
+    // The heavy work inside the jobs is spread by TBB, these threads mostly wait on it,
+    // there should be enough of them to keep every kind of job going at the same time
+    int threadCount = std::max(QThread::idealThreadCount(), 4);
+    for (int i = 0; i < threadCount; ++i) {
+        QThread *thread = new QThread;
+        thread->setObjectName("Job worker " + QString::number(i));
+        JobRunner *runner = new JobRunner;
+        runner->moveToThread(thread);
+        connect(runner, &JobRunner::finished, this, [=](qint64 runMilliseconds) {
+            jobFinished(runner, runMilliseconds);
+        });
+        m_threads.push_back(thread);
+        m_runners.push_back(runner);
+        m_idleRunners.push_back(runner);
+        thread->start();
+    }
+    connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, [=]() {
+        printMetrics();
+        stop();
+    });
+}
+
+void JobScheduler::stop()
+{
+    // Jobs not started yet are dropped, the running ones are asked to stop early when they can,
+    // then waited for before the threads are joined
+    for (auto &pendingJobs: m_pendingJobs) {
+        for (auto &it: pendingJobs) {
+            if (it.discard)
+                it.discard();
+        }
+        pendingJobs.clear();
+    }
+    m_pendingCount = 0;
+    for (auto &it: m_runningCancels)
+        it.second();
+    m_runningCancels.clear();
+    for (auto &thread: m_threads)
+        thread->quit();
+    for (auto &thread: m_threads)
+        thread->wait();
+    for (auto &runner: m_runners)
+        delete runner;
+    for (auto &thread: m_threads)
+        delete thread;
+    m_runners.clear();
+    m_idleRunners.clear();
+    m_runningKinds.clear();
+    m_threads.clear();
+}
+
+void JobScheduler::schedule(Kind kind, QObject *worker, const std::function<void()> &process,
+    const std::function<void()> &discard, const std::function<void()> &cancel)
+{
+    auto &metrics = m_metrics[(size_t)kind];
+    auto &pendingJobs = m_pendingJobs[(size_t)kind];
+    ++metrics.submitted;
+    if (discard) {
+        for (auto &it: pendingJobs) {
+            if (it.discard)
+                it.discard();
+            ++metrics.coalesced;
+            Profiler::increase("jobCoalesced");
+        }
+        m_pendingCount -= pendingJobs.size();
+        pendingJobs.clear();
+    }
+    Job job;
+    job.worker = worker;
+    job.process = process;
+    job.discard = discard;
+    job.cancel = cancel;
+    job.queuedTimer.start();
+    pendingJobs.push_back(job);
+    ++m_pendingCount;
+    m_peakPendingCount = std::max(m_peakPendingCount, m_pendingCount);
+    dispatch();
+}
+
+void JobScheduler::dispatch()
+{
+    while (!m_idleRunners.empty() && m_pendingCount > 0) {
+        size_t kindIndex = 0;
+        while (kindIndex < m_pendingJobs.size() && m_pendingJobs[kindIndex].empty())
+            ++kindIndex;
+        Kind kind = (Kind)kindIndex;
+        if (Kind::MousePick != kind && 1 == m_idleRunners.size())
+            return;
+
+        Job job = m_pendingJobs[kindIndex].front();
+        m_pendingJobs[kindIndex].pop_front();
+        --m_pendingCount;
+
+        auto &metrics = m_metrics[kindIndex];
+        qint64 queuedMilliseconds = job.queuedTimer.elapsed();
+        ++metrics.started;
+        metrics.totalQueuedMilliseconds += queuedMilliseconds;
+        metrics.maxQueuedMilliseconds = std::max(metrics.maxQueuedMilliseconds, queuedMilliseconds);
+
+        JobRunner *runner = m_idleRunners.back();
+        m_idleRunners.pop_back();
+        m_runningKinds[runner] = kind;
+        if (job.cancel)
+            m_runningCancels[runner] = job.cancel;
+
+        job.worker->moveToThread(runner->thread());
+        runner->setJob(job.process, kindName(kind));
+        QMetaObject::invokeMethod(runner, "run", Qt::QueuedConnection);
+    }
+}
+
+void JobScheduler::jobFinished(JobRunner *runner, qint64 runMilliseconds)
+{
+    auto findKind = m_runningKinds.find(runner);
+    if (findKind != m_runningKinds.end()) {
+        auto &metrics = m_metrics[(size_t)findKind->second];
+        ++metrics.completed;
+        metrics.totalRunMilliseconds += runMilliseconds;
+        metrics.maxRunMilliseconds = std::max(metrics.maxRunMilliseconds, runMilliseconds);
+        m_runningKinds.erase(findKind);
+    }
+    m_runningCancels.erase(runner);
+    m_idleRunners.push_back(runner);
+    dispatch();
+}
+
+bool JobScheduler::isPending(const QObject *worker) const
+{
+    for (const auto &pendingJobs: m_pendingJobs) {
+        for (const auto &it: pendingJobs) {
+            if (it.worker == worker)
+                return true;
+        }
+    }
+    return false;
+}
+
+size_t JobScheduler::pendingCount() const
+{
+    return m_pendingCount;
+}
+
+size_t JobScheduler::peakPendingCount() const
+{
+    return m_peakPendingCount;
+}
+
+size_t JobScheduler::threadCount() const
+{
+    return m_threads.size();
+}
+
+const JobScheduler::KindMetrics &JobScheduler::metrics(Kind kind) const
+{
+    return m_metrics[(size_t)kind];
+}
+
+void JobScheduler::printMetrics() const
+{
+    qDebug() << "Job scheduler threads:" << threadCount() << "peak pending:" << peakPendingCount();
+    for (size_t i = 0; i < m_metrics.size(); ++i) {
+        const auto &metrics = m_metrics[i];
+        if (0 == metrics.submitted)
+            continue;
+        qDebug() << kindName((Kind)i)
+            << "submitted:" << metrics.submitted
+            << "coalesced:" << metrics.coalesced
+            << "completed:" << metrics.completed
+            << "average queued(ms):" << (0 == metrics.started ? 0 : metrics.totalQueuedMilliseconds / (qint64)metrics.started)
+            << "max queued(ms):" << metrics.maxQueuedMilliseconds
+            << "average run(ms):" << (0 == metrics.completed ? 0 : metrics.totalRunMilliseconds / (qint64)metrics.completed)
+            << "max run(ms):" << metrics.maxRunMilliseconds;
+    }
+}
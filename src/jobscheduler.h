@@ -0,0 +1,104 @@
+#ifndef DUST3D_JOB_SCHEDULER_H
+#define DUST3D_JOB_SCHEDULER_H
+#include <QObject>
+#include <QThread>
+#include <QElapsedTimer>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <map>
+
+class JobRunner : public QObject
+{
+    Q_OBJECT
+public:
+    void setJob(const std::function<void()> &job, const char *name);
+signals:
+    void finished(qint64 runMilliseconds);
+public slots:
+    void run();
+private:
+    std::function<void()> m_job;
+    const char *m_name = nullptr;
+};
+
+// Long-lived worker threads for the background jobs of the document.
+// Waiting jobs are started by kind, the kinds are declared from the most urgent to the least,
+// one thread is kept for mouse picks so picking never waits behind a long generation.
+// Must be used from the GUI thread, the worker objects are moved to a pool thread when their job starts
+// and are expected to move themselves back before emitting their finished signal.
+// The threads mostly wait on TBB, which does the heavy work on its own workers, so no thread priority is set here.
+class JobScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Kind
+    {
+        MousePick = 0,
+        ContourToPart,
+        Script,
+        Mesh,
+        PostProcess,
+        Rig,
+        Motions,
+        Texture,
+        PosePreviews,
+        MaterialPreviews,
+        Count
+    };
+
+    struct KindMetrics
+    {
+        quint64 submitted = 0;
+        quint64 coalesced = 0;
+        quint64 started = 0;
+        quint64 completed = 0;
+        qint64 totalQueuedMilliseconds = 0;
+        qint64 maxQueuedMilliseconds = 0;
+        qint64 totalRunMilliseconds = 0;
+        qint64 maxRunMilliseconds = 0;
+    };
+
+    static JobScheduler &instance();
+    static const char *kindName(Kind kind);
+
+    // When discard is given, a job of the same kind still waiting is dropped through it,
+    // only the latest request of such kind is worth running.
+    // When cancel is given, it's called on the GUI thread at quit if the job is still running
+    void schedule(Kind kind, QObject *worker, const std::function<void()> &process,
+        const std::function<void()> &discard=std::function<void()>(),
+        const std::function<void()> &cancel=std::function<void()>());
+    bool isPending(const QObject *worker) const;
+    size_t pendingCount() const;
+    size_t peakPendingCount() const;
+    size_t threadCount() const;
+    const KindMetrics &metrics(Kind kind) const;
+    void printMetrics() const;
+
+private:
+    struct Job
+    {
+        QObject *worker = nullptr;
+        std::function<void()> process;
+        std::function<void()> discard;
+        std::function<void()> cancel;
+        QElapsedTimer queuedTimer;
+    };
+
+    JobScheduler();
+    void dispatch();
+    void jobFinished(JobRunner *runner, qint64 runMilliseconds);
+    void stop();
+
+    std::vector<QThread *> m_threads;
+    std::vector<JobRunner *> m_runners;
+    std::vector<JobRunner *> m_idleRunners;
+    std::map<JobRunner *, Kind> m_runningKinds;
+    std::map<JobRunner *, std::function<void()>> m_runningCancels;
+    std::vector<std::deque<Job>> m_pendingJobs;
+    std::vector<KindMetrics> m_metrics;
+    size_t m_pendingCount = 0;
+    size_t m_peakPendingCount = 0;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <algorithm>
+#include "linearblendskinning.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DUST3D_SKINNING_SSE 1
+#include <emmintrin.h>
+#endif
+
+class LinearBlendSkinningWorker
+{
+public:
+    LinearBlendSkinningWorker(const float *palette,
+            const float *positionX, const float *positionY, const float *positionZ,
+            const float *normalX, const float *normalY, const float *normalZ,
+            const uint16_t *boneIndices, const float *boneWeights,
+            float *positions, float *normals) :
+        m_palette(palette),
+        m_positionX(positionX),
+        m_positionY(positionY),
+        m_positionZ(positionZ),
+        m_normalX(normalX),
+        m_normalY(normalY),
+        m_normalZ(normalZ),
+        m_boneIndices(boneIndices),
+        m_boneWeights(boneWeights),
+        m_positions(positions),
+        m_normals(normals)
+    {
+    }
+    void operator()(const tbb::blocked_range<size_t> &range) const
+    {
+        for (size_t i = range.begin(); i != range.end(); ++i) {
+            const uint16_t *boneIndices = m_boneIndices + i * 4;
+            const float *boneWeights = m_boneWeights + i * 4;
+#if DUST3D_SKINNING_SSE
+            // Blend the four bone matrices column by column, then transform once
+            __m128 column0 = _mm_setzero_ps();
+            __m128 column1 = _mm_setzero_ps();
+            __m128 column2 = _mm_setzero_ps();
+            __m128 column3 = _mm_setzero_ps();
+            for (size_t k = 0; k < 4; ++k) {
+                const float *matrix = m_palette + boneIndices[k] * 16;
+                __m128 weight = _mm_set1_ps(boneWeights[k]);
+                column0 = _mm_add_ps(column0, _mm_mul_ps(_mm_loadu_ps(matrix), weight));
+                column1 = _mm_add_ps(column1, _mm_mul_ps(_mm_loadu_ps(matrix + 4), weight));
+                column2 = _mm_add_ps(column2, _mm_mul_ps(_mm_loadu_ps(matrix + 8), weight));
+                column3 = _mm_add_ps(column3, _mm_mul_ps(_mm_loadu_ps(matrix + 12), weight));
+            }
+            __m128 position = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(m_positionX[i])),
+                    _mm_mul_ps(column1, _mm_set1_ps(m_positionY[i]))),
+                _mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(m_positionZ[i])), column3));
+            __m128 normal = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(m_normalX[i])),
+                    _mm_mul_ps(column1, _mm_set1_ps(m_normalY[i]))),
+                _mm_mul_ps(column2, _mm_set1_ps(m_normalZ[i])));
+            _mm_storeu_ps(m_positions + i * 4, position);
+            _mm_storeu_ps(m_normals + i * 4, normal);
+#else
+            float blended[16] = {0};
+            for (size_t k = 0; k < 4; ++k) {
+                const float *matrix = m_palette + boneIndices[k] * 16;
+                float weight = boneWeights[k];
+                for (size_t j = 0; j < 16; ++j)
+                    blended[j] += matrix[j] * weight;
+            }
+            for (size_t j = 0; j < 4; ++j) {
+                m_positions[i * 4 + j] = blended[j] * m_positionX[i] + blended[4 + j] * m_positionY[i] +
+                    blended[8 + j] * m_positionZ[i] + blended[12 + j];
+                m_normals[i * 4 + j] = blended[j] * m_normalX[i] + blended[4 + j] * m_normalY[i] +
+                    blended[8 + j] * m_normalZ[i];
+            }
+#endif
+        }
+    }
+private:
+    const float *m_palette = nullptr;
+    const float *m_positionX = nullptr;
+    const float *m_positionY = nullptr;
+    const float *m_positionZ = nullptr;
+    const float *m_normalX = nullptr;
+    const float *m_normalY = nullptr;
+    const float *m_normalZ = nullptr;
+    const uint16_t *m_boneIndices = nullptr;
+    const float *m_boneWeights = nullptr;
+    float *m_positions = nullptr;
+    float *m_normals = nullptr;
+};
+
+void LinearBlendSkinning::reserve(size_t vertexCount)
+{
+    m_positionX.reserve(vertexCount);
+    m_positionY.reserve(vertexCount);
+    m_positionZ.reserve(vertexCount);
+    m_normalX.reserve(vertexCount);
+    m_normalY.reserve(vertexCount);
+    m_normalZ.reserve(vertexCount);
+    m_boneIndices.reserve(vertexCount * 4);
+    m_boneWeights.reserve(vertexCount * 4);
+}
+
+size_t LinearBlendSkinning::addVertex(const QVector3D &position, const QVector3D &normal, const RiggerVertexWeights &weights)
+{
+    m_positionX.push_back(position.x());
+    m_positionY.push_back(position.y());
+    m_positionZ.push_back(position.z());
+    m_normalX.push_back(normal.x());
+    m_normalY.push_back(normal.y());
+    m_normalZ.push_back(normal.z());
+    for (size_t k = 0; k < 4; ++k) {
+        int boneIndex = weights.boneIndices[k];
+        float boneWeight = weights.boneWeights[k];
+        if (boneIndex < 0 || boneIndex > 0xffff || boneWeight <= 0) {
+            boneIndex = 0;
+            boneWeight = 0;
+        }
+        m_boneIndices.push_back((uint16_t)boneIndex);
+        m_boneWeights.push_back(boneWeight);
+        m_boneCount = std::max(m_boneCount, (size_t)boneIndex + 1);
+    }
+    return m_positionX.size() - 1;
+}
+
+size_t LinearBlendSkinning::vertexCount() const
+{
+    return m_positionX.size();
+}
+
+void LinearBlendSkinning::skin(const std::vector<QMatrix4x4> &matrices,
+    std::vector<float> *positions, std::vector<float> *normals) const
+{
+    // Only the affine part of each bone matrix is used, bones without matrix contribute nothing
+    std::vector<float> palette(std::max(m_boneCount, matrices.size()) * 16, 0.0f);
+    for (size_t i = 0; i < matrices.size(); ++i) {
+        const float *source = matrices[i].constData();
+        float *target = palette.data() + i * 16;
+        for (size_t column = 0; column < 4; ++column) {
+            for (size_t row = 0; row < 3; ++row)
+                target[column * 4 + row] = source[column * 4 + row];
+        }
+    }
+    positions->resize(vertexCount() * 4);
+    normals->resize(vertexCount() * 4);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, vertexCount(), 1024),
+        LinearBlendSkinningWorker(palette.data(),
+            m_positionX.data(), m_positionY.data(), m_positionZ.data(),
+            m_normalX.data(), m_normalY.data(), m_normalZ.data(),
+            m_boneIndices.data(), m_boneWeights.data(),
+            positions->data(), normals->data()));
+}
+
+void LinearBlendSkinning::bind(std::vector<float> *positions, std::vector<float> *normals) const
+{
+    positions->resize(vertexCount() * 4);
+    normals->resize(vertexCount() * 4);
+    for (size_t i = 0; i < vertexCount(); ++i) {
+        (*positions)[i * 4] = m_positionX[i];
+        (*positions)[i * 4 + 1] = m_positionY[i];
+        (*positions)[i * 4 + 2] = m_positionZ[i];
+        (*positions)[i * 4 + 3] = 0;
+        (*normals)[i * 4] = m_normalX[i];
+        (*normals)[i * 4 + 1] = m_normalY[i];
+        (*normals)[i * 4 + 2] = m_normalZ[i];
+        (*normals)[i * 4 + 3] = 0;
+    }
+}
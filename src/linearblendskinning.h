@@ -0,0 +1,34 @@
+#ifndef DUST3D_LINEAR_BLEND_SKINNING_H
+#define DUST3D_LINEAR_BLEND_SKINNING_H
+#include <QVector3D>
+#include <QMatrix4x4>
+#include <vector>
+#include <cstdint>
+#include "rigger.h"
+
+// Linear blend skinning over flat per vertex arrays: bind positions and normals
+// are kept as separated x/y/z arrays, each vertex has four packed bone indices and weights.
+// Results are written as four floats per vertex (x, y, z, 0).
+class LinearBlendSkinning
+{
+public:
+    void reserve(size_t vertexCount);
+    size_t addVertex(const QVector3D &position, const QVector3D &normal, const RiggerVertexWeights &weights);
+    size_t vertexCount() const;
+    void skin(const std::vector<QMatrix4x4> &matrices,
+        std::vector<float> *positions, std::vector<float> *normals) const;
+    void bind(std::vector<float> *positions, std::vector<float> *normals) const;
+
+private:
+    std::vector<float> m_positionX;
+    std::vector<float> m_positionY;
+    std::vector<float> m_positionZ;
+    std::vector<float> m_normalX;
+    std::vector<float> m_normalY;
+    std::vector<float> m_normalZ;
+    std::vector<uint16_t> m_boneIndices;
+    std::vector<float> m_boneWeights;
+    size_t m_boneCount = 0;
+};
+
+#endif
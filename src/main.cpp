@@ -7,12 +7,249 @@
 #include <QSurfaceFormat>
 #include <QSettings>
 #include <QTranslator>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QFile>
+#include <QTextStream>
 #include "documentwindow.h"
 #include "theme.h"
 #include "version.h"
+#include "headlessexporter.h"
+#include "meshdiskcache.h"
+#include "microbenchmark.h"
+#include "profiler.h"
+#include "pipelinebenchmark.h"
+
+// Export without any window, e.g.
+//   dust3d -headless -jobs 8 -o out/{name}.glb -o out/{name}.fbx a.ds3 b.ds3
+// {name} is replaced by the base name of each input file,
+// -trace trace.json writes the per-stage timings of all the exports as Chrome trace
+static int runHeadlessExport(int argc, char ** argv)
+{
+    QCoreApplication app(argc, argv);
+    
+    QCoreApplication::setApplicationName(APP_NAME);
+    QCoreApplication::setOrganizationName(APP_COMPANY);
+    QCoreApplication::setOrganizationDomain(APP_HOMEPAGE_URL);
+    
+    QStringList inputFileList;
+    QStringList outputTemplateList;
+    QString traceFilename;
+    int jobs = 0;
+    bool enableQuantization = false;
+    MeshDiskCache::setEnabled(true);
+    for (int i = 1; i < argc; ++i) {
+        if ('-' == argv[i][0]) {
+            if (0 == strcmp(argv[i], "-headless"))
+                continue;
+            if (0 == strcmp(argv[i], "-output") ||
+                    0 == strcmp(argv[i], "-o")) {
+                ++i;
+                if (i < argc)
+                    outputTemplateList.append(argv[i]);
+                continue;
+            }
+            if (0 == strcmp(argv[i], "-jobs") ||
+                    0 == strcmp(argv[i], "-j")) {
+                ++i;
+                if (i < argc)
+                    jobs = QString(argv[i]).toInt();
+                continue;
+            }
+            if (0 == strcmp(argv[i], "-nocache")) {
+                MeshDiskCache::setEnabled(false);
+                continue;
+            }
+            if (0 == strcmp(argv[i], "-quantize")) {
+                enableQuantization = true;
+                continue;
+            }
+            if (0 == strcmp(argv[i], "-trace")) {
+                ++i;
+                if (i < argc)
+                    traceFilename = argv[i];
+                continue;
+            }
+            qDebug() << "Unknown option:" << argv[i];
+            continue;
+        }
+        QString arg = argv[i];
+        if (arg.endsWith(".ds3")) {
+            inputFileList.append(arg);
+            continue;
+        }
+    }
+    
+    if (inputFileList.empty() || outputTemplateList.empty()) {
+        qDebug() << "Nothing to export, usage: -headless [-jobs N] [-nocache] [-quantize] [-trace <trace.json>] -o <output{name}.glb|.fbx|.obj>... <input.ds3>...";
+        return 1;
+    }
+    if (inputFileList.size() > 1) {
+        for (const auto &outputTemplate: outputTemplateList) {
+            if (!outputTemplate.contains("{name}")) {
+                qDebug() << "Output" << outputTemplate << "must contain {name} when exporting multiple files";
+                return 1;
+            }
+        }
+    }
+    
+    if (!traceFilename.isEmpty())
+        Profiler::setEnabled(true);
+    
+    std::vector<HeadlessExporter *> exporters;
+    for (const auto &inputFilename: inputFileList) {
+        QString baseName = QFileInfo(inputFilename).completeBaseName();
+        QStringList outputFilenames;
+        for (const auto &outputTemplate: outputTemplateList)
+            outputFilenames.append(QString(outputTemplate).replace("{name}", baseName));
+        HeadlessExporter *exporter = new HeadlessExporter(inputFilename, outputFilenames);
+        exporter->setEnableQuantization(enableQuantization);
+        exporters.push_back(exporter);
+    }
+    
+    bool succeed = HeadlessExporter::exportInParallel(exporters, jobs);
+    
+    QTextStream stream(stdout);
+    for (auto &exporter: exporters) {
+        stream << exporter->inputFilename() << "\t" << (exporter->isSucceed() ? "succeed" : "failed");
+        for (const auto &it: exporter->stageTimings())
+            stream << "\t" << it.first << "=" << it.second << "ms";
+        stream << endl;
+        delete exporter;
+    }
+    
+    if (!traceFilename.isEmpty()) {
+        for (const auto &it: Profiler::counters())
+            stream << it.first << "=" << it.second << endl;
+        if (!Profiler::saveChromeTrace(traceFilename))
+            succeed = false;
+    }
+    
+    return succeed ? 0 : 1;
+}
+
+// Compare optimized kernels with their reference implementations, e.g.
+//   dust3d -benchmark projectfacestonodes
+// all the benchmarks run when none is named
+static int runMicroBenchmarks(int argc, char ** argv)
+{
+    QCoreApplication app(argc, argv);
+    
+    QStringList names;
+    for (int i = 1; i < argc; ++i) {
+        if ('-' == argv[i][0])
+            continue;
+        names.append(argv[i]);
+    }
+    if (names.empty())
+        names = MicroBenchmark::names();
+    
+    bool succeed = true;
+    QTextStream stream(stdout);
+    for (const auto &name: names) {
+        MicroBenchmark::Result result;
+        if (!MicroBenchmark::run(name, &result)) {
+            qDebug() << "Unknown benchmark:" << name << "available:" << MicroBenchmark::names().join(",");
+            succeed = false;
+            continue;
+        }
+        if (!result.identical)
+            succeed = false;
+        stream << result.name <<
+            "\treference=" << result.referenceMilliseconds << "ms" <<
+            "\toptimized=" << result.optimizedMilliseconds << "ms" <<
+            "\tidentical=" << (result.identical ? "yes" : "no");
+        if (!result.details.isEmpty())
+            stream << "\t" << result.details;
+        stream << endl;
+    }
+    
+    return succeed ? 0 : 1;
+}
+
+// Time every generation stage over a corpus, e.g.
+//   dust3d -pipelinebenchmark -runs 10 -o report.json a.ds3 b.ds3
+// the bundled sample models are used when no file is given, the mesh disk cache stays off unless -diskcache
+static int runPipelineBenchmark(int argc, char ** argv)
+{
+    QCoreApplication app(argc, argv);
+    
+    QStringList inputFileList;
+    QString reportFilename;
+    int runs = 5;
+    MeshDiskCache::setEnabled(false);
+    for (int i = 1; i < argc; ++i) {
+        if ('-' == argv[i][0]) {
+            if (0 == strcmp(argv[i], "-pipelinebenchmark"))
+                continue;
+            if (0 == strcmp(argv[i], "-runs")) {
+                ++i;
+                if (i < argc)
+                    runs = QString(argv[i]).toInt();
+                continue;
+            }
+            if (0 == strcmp(argv[i], "-output") ||
+                    0 == strcmp(argv[i], "-o")) {
+                ++i;
+                if (i < argc)
+                    reportFilename = argv[i];
+                continue;
+            }
+            if (0 == strcmp(argv[i], "-diskcache")) {
+                MeshDiskCache::setEnabled(true);
+                continue;
+            }
+            qDebug() << "Unknown option:" << argv[i];
+            continue;
+        }
+        QString arg = argv[i];
+        if (arg.endsWith(".ds3"))
+            inputFileList.append(arg);
+    }
+    if (inputFileList.empty())
+        inputFileList = PipelineBenchmark::sampleModels();
+    
+    PipelineBenchmark benchmark(inputFileList, runs);
+    benchmark.run();
+    
+    bool succeed = true;
+    QTextStream stream(stdout);
+    for (const auto &result: benchmark.results()) {
+        if (!result.succeed)
+            succeed = false;
+        for (const auto &stage: result.stages) {
+            stream << result.filename << "\t" << stage.name <<
+                "\tmedian=" << stage.medianMilliseconds << "ms" <<
+                "\tp95=" << stage.p95Milliseconds << "ms" <<
+                "\tpeakRss=" << (stage.peakResidentBytes / 1024) << "KB" << endl;
+        }
+        if (!result.succeed)
+            stream << result.filename << "\tfailed" << endl;
+    }
+    if (!reportFilename.isEmpty()) {
+        QFile file(reportFilename);
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(benchmark.toJson());
+        } else {
+            qDebug() << "Open report file failed:" << reportFilename;
+            succeed = false;
+        }
+    }
+    
+    return succeed ? 0 : 1;
+}
 
 int main(int argc, char ** argv)
 {
+    for (int i = 1; i < argc; ++i) {
+        if (0 == strcmp(argv[i], "-headless"))
+            return runHeadlessExport(argc, argv);
+        if (0 == strcmp(argv[i], "-benchmark"))
+            return runMicroBenchmarks(argc, argv);
+        if (0 == strcmp(argv[i], "-pipelinebenchmark"))
+            return runPipelineBenchmark(argc, argv);
+    }
+    
     QApplication app(argc, argv);
     
     QTranslator translator;
@@ -63,6 +300,7 @@ int main(int argc, char ** argv)
     
     QStringList openFileList;
     QStringList waitingExportList;
+    QString traceFilename;
     for (int i = 1; i < argc; ++i) {
         if ('-' == argv[i][0]) {
             if (0 == strcmp(argv[i], "-output") ||
@@ -72,6 +310,12 @@ int main(int argc, char ** argv)
                     waitingExportList.append(argv[i]);
                 continue;
             }
+            if (0 == strcmp(argv[i], "-trace")) {
+                ++i;
+                if (i < argc)
+                    traceFilename = argv[i];
+                continue;
+            }
             qDebug() << "Unknown option:" << argv[i];
             continue;
         }
@@ -82,6 +326,14 @@ int main(int argc, char ** argv)
         }
     }
     
+    // Everything generated during the session goes into the trace, it is written when the application quits
+    if (!traceFilename.isEmpty()) {
+        Profiler::setEnabled(true);
+        QObject::connect(&app, &QCoreApplication::aboutToQuit, [=]() {
+            Profiler::saveChromeTrace(traceFilename);
+        });
+    }
+    
     int finishedExportFileNum = 0;
     int totalExportFileNum = 0;
     int succeedExportNum = 0;
@@ -23,7 +23,7 @@ void initializeMaterialTexturesFromSnapshot(const Snapshot &snapshot,
                     if (index >= 0 && index < (int)TextureType::Count - 1) {
                         if ("imageId" == valueOfKeyInMapOrEmpty(mapItem, "linkDataType")) {
                             auto imageIdString = valueOfKeyInMapOrEmpty(mapItem, "linkData");
-                            materialTextures.textureImages[index] = ImageForever::get(QUuid(imageIdString));
+                            materialTextures.textureImages[index] = ImageForever::getSharedImage(QUuid(imageIdString));
                         }
                     }
                 }
@@ -2,12 +2,13 @@
 #define DUST3D_MATERIAL_H
 #include <QImage>
 #include <QUuid>
+#include <memory>
 #include "texturetype.h"
 #include "snapshot.h"
 
 struct MaterialTextures
 {
-    const QImage *textureImages[(int)TextureType::Count - 1] = {nullptr};
+    std::shared_ptr<const QImage> textureImages[(int)TextureType::Count - 1];
 };
 
 void initializeMaterialTexturesFromSnapshot(const Snapshot &snapshot,
@@ -1,5 +1,10 @@
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 #include <QGuiApplication>
 #include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <deque>
 #include "materialpreviewsgenerator.h"
 #include "meshgenerator.h"
 #include "snapshotxml.h"
@@ -7,6 +12,17 @@
 #include "texturegenerator.h"
 #include "imageforever.h"
 #include "meshresultpostprocessor.h"
+#include "preferences.h"
+
+static QMutex g_demoModelMutex;
+static std::shared_ptr<const Outcome> g_demoOutcome;
+static std::vector<QUuid> g_demoPartIds;
+
+// Previews keep their texture images, which are implicitly shared with the copies handed out
+static const size_t g_previewCacheLimit = 64;
+static QMutex g_previewCacheMutex;
+static std::map<QString, MeshLoader *> g_previewCache;
+static std::deque<QString> g_previewCacheOrder;
 
 MaterialPreviewsGenerator::MaterialPreviewsGenerator()
 {
@@ -36,11 +52,22 @@ MeshLoader *MaterialPreviewsGenerator::takePreview(QUuid materialId)
     return resultMesh;
 }
 
-void MaterialPreviewsGenerator::generate()
+void MaterialPreviewsGenerator::loadDemoModel(std::shared_ptr<const Outcome> *outcome, std::vector<QUuid> *partIds)
 {
-    Snapshot *snapshot = new Snapshot;
+    // The demo model never changes, it's generated and unwrapped once for the whole process.
+    // The generation waits on TBB work, so it runs without the lock and only the result is published under it,
+    // two runs starting together may both generate it, the first to finish is kept
+    {
+        QMutexLocker locker(&g_demoModelMutex);
+        if (nullptr != g_demoOutcome) {
+            *outcome = g_demoOutcome;
+            *partIds = g_demoPartIds;
+            return;
+        }
+    }
     
-    std::vector<QUuid> partIds;
+    std::vector<QUuid> demoPartIds;
+    Snapshot *snapshot = new Snapshot;
     Ds3FileReader ds3Reader(":/resources/material-demo-model.ds3");
     for (int i = 0; i < ds3Reader.items().size(); ++i) {
         Ds3ReaderItem item = ds3Reader.items().at(i);
@@ -50,7 +77,7 @@ void MaterialPreviewsGenerator::generate()
             QXmlStreamReader stream(data);
             loadSkeletonFromXmlStream(snapshot, stream);
             for (const auto &item: snapshot->parts) {
-                partIds.push_back(QUuid(item.first));
+                demoPartIds.push_back(QUuid(item.first));
             }
         }
     }
@@ -61,55 +88,122 @@ void MaterialPreviewsGenerator::generate()
     
     meshGenerator->generate();
     for (const auto &mirror: cacheContext->partMirrorIdMap) {
-        partIds.push_back(QUuid(mirror.first));
+        demoPartIds.push_back(QUuid(mirror.first));
     }
     
-    Outcome *outcome = meshGenerator->takeOutcome();
-    if (nullptr != outcome) {
-        MeshResultPostProcessor *poseProcessor = new MeshResultPostProcessor(*outcome);
+    std::shared_ptr<const Outcome> demoOutcome;
+    Outcome *generatedOutcome = meshGenerator->takeOutcome();
+    if (nullptr != generatedOutcome) {
+        MeshResultPostProcessor *poseProcessor = new MeshResultPostProcessor(*generatedOutcome);
         poseProcessor->poseProcess();
-        delete outcome;
-        outcome = poseProcessor->takePostProcessedOutcome();
+        delete generatedOutcome;
+        demoOutcome.reset(poseProcessor->takePostProcessedOutcome());
         delete poseProcessor;
     }
     
-    if (nullptr != outcome) {
-        for (const auto &material: m_materials) {
-            TextureGenerator *textureGenerator = new TextureGenerator(*outcome);
-            for (const auto &layer: material.second) {
-                for (const auto &mapItem: layer.maps) {
-                    const QImage *image = ImageForever::get(mapItem.imageId);
-                    if (nullptr == image)
-                        continue;
-                    for (const auto &partId: partIds) {
-                        if (TextureType::BaseColor == mapItem.forWhat)
-                            textureGenerator->addPartColorMap(partId, image, layer.tileScale);
-                        else if (TextureType::Normal == mapItem.forWhat)
-                            textureGenerator->addPartNormalMap(partId, image, layer.tileScale);
-                        else if (TextureType::Metalness == mapItem.forWhat)
-                            textureGenerator->addPartMetalnessMap(partId, image, layer.tileScale);
-                        else if (TextureType::Roughness == mapItem.forWhat)
-                            textureGenerator->addPartRoughnessMap(partId, image, layer.tileScale);
-                        else if (TextureType::AmbientOcclusion == mapItem.forWhat)
-                            textureGenerator->addPartAmbientOcclusionMap(partId, image, layer.tileScale);
-                    }
-                }
+    delete meshGenerator;
+    delete cacheContext;
+    
+    QMutexLocker locker(&g_demoModelMutex);
+    if (nullptr == g_demoOutcome && nullptr != demoOutcome) {
+        g_demoOutcome = demoOutcome;
+        g_demoPartIds = demoPartIds;
+    }
+    *outcome = g_demoOutcome;
+    *partIds = g_demoPartIds;
+}
+
+QString MaterialPreviewsGenerator::layersKey(const std::vector<MaterialLayer> &layers)
+{
+    QStringList layerStrings;
+    for (const auto &layer: layers) {
+        QStringList mapStrings;
+        for (const auto &mapItem: layer.maps)
+            mapStrings += QString::number((int)mapItem.forWhat) + "=" + mapItem.imageId.toString();
+        layerStrings += QString::number(layer.tileScale) + ":" + mapStrings.join(",");
+    }
+    return QString::number(Preferences::instance().textureSize()) + "|" + layerStrings.join(";");
+}
+
+void MaterialPreviewsGenerator::generate()
+{
+    std::shared_ptr<const Outcome> outcome;
+    std::vector<QUuid> partIds;
+    loadDemoModel(&outcome, &partIds);
+    if (nullptr == outcome)
+        return;
+    
+    // Materials which look the same as an earlier preview, like the ones recreated by undo, reuse it
+    std::vector<QString> keys(m_materials.size());
+    std::vector<TextureGenerator *> textureGenerators(m_materials.size(), nullptr);
+    std::vector<MeshLoader *> results(m_materials.size(), nullptr);
+    for (size_t i = 0; i < m_materials.size(); ++i) {
+        const auto &material = m_materials[i];
+        keys[i] = layersKey(material.second);
+        {
+            QMutexLocker locker(&g_previewCacheMutex);
+            auto findCached = g_previewCache.find(keys[i]);
+            if (findCached != g_previewCache.end()) {
+                results[i] = new MeshLoader(*findCached->second);
+                continue;
             }
-            textureGenerator->generate();
-            MeshLoader *texturedResultMesh = textureGenerator->takeResultMesh();
-            if (nullptr != texturedResultMesh) {
-                m_previews[material.first] = new MeshLoader(*texturedResultMesh);
-                m_generatedMaterialIds.insert(material.first);
-                delete texturedResultMesh;
+        }
+        TextureGenerator *textureGenerator = new TextureGenerator(*outcome);
+        for (const auto &layer: material.second) {
+            for (const auto &mapItem: layer.maps) {
+                auto image = ImageForever::getSharedImage(mapItem.imageId);
+                if (nullptr == image)
+                    continue;
+                for (const auto &partId: partIds) {
+                    if (TextureType::BaseColor == mapItem.forWhat)
+                        textureGenerator->addPartColorMap(partId, image.get(), layer.tileScale);
+                    else if (TextureType::Normal == mapItem.forWhat)
+                        textureGenerator->addPartNormalMap(partId, image.get(), layer.tileScale);
+                    else if (TextureType::Metalness == mapItem.forWhat)
+                        textureGenerator->addPartMetalnessMap(partId, image.get(), layer.tileScale);
+                    else if (TextureType::Roughness == mapItem.forWhat)
+                        textureGenerator->addPartRoughnessMap(partId, image.get(), layer.tileScale);
+                    else if (TextureType::AmbientOcclusion == mapItem.forWhat)
+                        textureGenerator->addPartAmbientOcclusionMap(partId, image.get(), layer.tileScale);
+                }
             }
-            delete textureGenerator;
         }
+        textureGenerators[i] = textureGenerator;
     }
     
-    delete outcome;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, textureGenerators.size(), 1),
+            [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i != range.end(); ++i) {
+            TextureGenerator *textureGenerator = textureGenerators[i];
+            if (nullptr == textureGenerator)
+                continue;
+            textureGenerator->generate();
+            results[i] = textureGenerator->takeResultMesh();
+            delete textureGenerator;
+        }
+    });
     
-    delete meshGenerator;
-    delete cacheContext;
+    for (size_t i = 0; i < m_materials.size(); ++i) {
+        MeshLoader *texturedResultMesh = results[i];
+        if (nullptr == texturedResultMesh)
+            continue;
+        const auto &materialId = m_materials[i].first;
+        if (nullptr != textureGenerators[i]) {
+            QMutexLocker locker(&g_previewCacheMutex);
+            if (g_previewCache.insert({keys[i], new MeshLoader(*texturedResultMesh)}).second) {
+                g_previewCacheOrder.push_back(keys[i]);
+                while (g_previewCacheOrder.size() > g_previewCacheLimit) {
+                    auto findCached = g_previewCache.find(g_previewCacheOrder.front());
+                    delete findCached->second;
+                    g_previewCache.erase(findCached);
+                    g_previewCacheOrder.pop_front();
+                }
+            }
+        }
+        delete m_previews[materialId];
+        m_previews[materialId] = texturedResultMesh;
+        m_generatedMaterialIds.insert(materialId);
+    }
 }
 
 void MaterialPreviewsGenerator::process()
@@ -4,6 +4,7 @@
 #include <map>
 #include <QUuid>
 #include <vector>
+#include <memory>
 #include "meshloader.h"
 #include "document.h"
 
@@ -25,6 +26,8 @@ private:
     std::vector<std::pair<QUuid, std::vector<MaterialLayer>>> m_materials;
     std::map<QUuid, MeshLoader *> m_previews;
     std::set<QUuid> m_generatedMaterialIds;
+    static void loadDemoModel(std::shared_ptr<const Outcome> *outcome, std::vector<QUuid> *partIds);
+    static QString layersKey(const std::vector<MaterialLayer> &layers);
 };
 
 #endif
@@ -1,38 +1,106 @@
 #include <CGAL/Polygon_mesh_processing/corefinement.h>
 #include <CGAL/Polygon_mesh_processing/repair.h>
 #include <CGAL/Polygon_mesh_processing/triangulate_faces.h>
+#include <CGAL/Polygon_mesh_processing/intersection.h>
+#include <CGAL/Polygon_mesh_processing/bbox.h>
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
 #include <map>
 #include "meshcombiner.h"
 #include "positionkey.h"
 #include "booleanmesh.h"
+extern "C" {
+#include <crc64.h>
+}
 
 typedef CGAL::Exact_predicates_inexact_constructions_kernel CgalKernel;
 typedef CGAL::Surface_mesh<CgalKernel::Point_3> CgalMesh;
 
+enum class MeshCheckResult
+{
+    Valid,
+    Invalid,
+    SelfIntersected
+};
+
+// Unchanged part meshes come back on every regeneration, remember how their checks went
+static std::map<quint64, MeshCheckResult> g_meshCheckResults;
+static QMutex g_meshCheckResultsMutex;
+static const size_t g_maxMeshCheckResults = 65536;
+
+static quint64 meshCheckKey(const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &faces)
+{
+    std::vector<float> positions;
+    positions.reserve(vertices.size() * 3);
+    for (const auto &vertex: vertices) {
+        positions.push_back(vertex.x());
+        positions.push_back(vertex.y());
+        positions.push_back(vertex.z());
+    }
+    std::vector<quint32> indices;
+    for (const auto &face: faces) {
+        indices.push_back((quint32)face.size());
+        for (const auto &index: face)
+            indices.push_back((quint32)index);
+    }
+    quint32 counts[2] = {(quint32)positions.size(), (quint32)indices.size()};
+    quint64 crc = crc64(0, (const unsigned char *)counts, sizeof(counts));
+    crc = crc64(crc, (const unsigned char *)positions.data(), positions.size() * sizeof(float));
+    crc = crc64(crc, (const unsigned char *)indices.data(), indices.size() * sizeof(quint32));
+    return crc;
+}
+
+static MeshCheckResult checkCgalMesh(CgalMesh *cgalMesh)
+{
+    if (!CGAL::is_valid_polygon_mesh(*cgalMesh)) {
+        qDebug() << "Mesh is not valid polygon";
+        return MeshCheckResult::Invalid;
+    }
+    if (!CGAL::Polygon_mesh_processing::triangulate_faces(*cgalMesh)) {
+        qDebug() << "Mesh triangulate failed";
+        return MeshCheckResult::Invalid;
+    }
+    if (CGAL::Polygon_mesh_processing::does_self_intersect(*cgalMesh)) {
+        qDebug() << "Mesh does_self_intersect";
+        return MeshCheckResult::SelfIntersected;
+    }
+    return MeshCheckResult::Valid;
+}
+
 MeshCombiner::Mesh::Mesh(const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &faces, bool disableSelfIntersects)
 {
     CgalMesh *cgalMesh = nullptr;
     if (!faces.empty()) {
         cgalMesh = buildCgalMesh<CgalKernel>(vertices, faces);
         if (!disableSelfIntersects) {
-            if (!CGAL::is_valid_polygon_mesh(*cgalMesh)) {
-                qDebug() << "Mesh is not valid polygon";
+            quint64 checkKey = meshCheckKey(vertices, faces);
+            bool foundCheckResult = false;
+            MeshCheckResult checkResult = MeshCheckResult::Valid;
+            {
+                QMutexLocker locker(&g_meshCheckResultsMutex);
+                auto findCheckResult = g_meshCheckResults.find(checkKey);
+                if (findCheckResult != g_meshCheckResults.end()) {
+                    foundCheckResult = true;
+                    checkResult = findCheckResult->second;
+                }
+            }
+            if (foundCheckResult) {
+                if (MeshCheckResult::Valid == checkResult &&
+                        !CGAL::Polygon_mesh_processing::triangulate_faces(*cgalMesh)) {
+                    checkResult = MeshCheckResult::Invalid;
+                }
+            } else {
+                checkResult = checkCgalMesh(cgalMesh);
+                QMutexLocker locker(&g_meshCheckResultsMutex);
+                if (g_meshCheckResults.size() >= g_maxMeshCheckResults)
+                    g_meshCheckResults.clear();
+                g_meshCheckResults.insert({checkKey, checkResult});
+            }
+            if (MeshCheckResult::Valid != checkResult) {
+                m_isSelfIntersected = MeshCheckResult::SelfIntersected == checkResult;
                 delete cgalMesh;
                 cgalMesh = nullptr;
-            } else {
-                if (CGAL::Polygon_mesh_processing::triangulate_faces(*cgalMesh)) {
-                    if (CGAL::Polygon_mesh_processing::does_self_intersect(*cgalMesh)) {
-                        m_isSelfIntersected = true;
-                        qDebug() << "Mesh does_self_intersect";
-                        delete cgalMesh;
-                        cgalMesh = nullptr;
-                    }
-                } else {
-                    qDebug() << "Mesh triangulate failed";
-                    delete cgalMesh;
-                    cgalMesh = nullptr;
-                }
             }
         }
     }
@@ -73,6 +141,34 @@ bool MeshCombiner::Mesh::isSelfIntersected() const
     return m_isSelfIntersected;
 }
 
+size_t MeshCombiner::Mesh::faceCount() const
+{
+    CgalMesh *exactMesh = (CgalMesh *)m_privateData;
+    if (nullptr == exactMesh)
+        return 0;
+    return exactMesh->number_of_faces();
+}
+
+static bool areSeparated(const CgalMesh &firstCgalMesh, const CgalMesh &secondCgalMesh)
+{
+    if (!CGAL::is_closed(firstCgalMesh) || !CGAL::is_closed(secondCgalMesh))
+        return false;
+    if (!CGAL::is_triangle_mesh(firstCgalMesh) || !CGAL::is_triangle_mesh(secondCgalMesh))
+        return false;
+    if (!CGAL::do_overlap(CGAL::Polygon_mesh_processing::bbox(firstCgalMesh),
+            CGAL::Polygon_mesh_processing::bbox(secondCgalMesh))) {
+        return true;
+    }
+    // Face boxes intersection for touching surfaces, then a point inside test for one mesh enclosing the other
+    try {
+        return !CGAL::Polygon_mesh_processing::do_intersect(firstCgalMesh, secondCgalMesh,
+            CGAL::Polygon_mesh_processing::parameters::do_overlap_test_of_bounded_sides(true),
+            CGAL::Polygon_mesh_processing::parameters::all_default());
+    } catch (...) {
+        return false;
+    }
+}
+
 MeshCombiner::Mesh *MeshCombiner::combine(const Mesh &firstMesh, const Mesh &secondMesh, Method method,
     std::vector<std::pair<Source, size_t>> *combinedVerticesComeFrom)
 {
@@ -100,7 +196,11 @@ MeshCombiner::Mesh *MeshCombiner::combine(const Mesh &firstMesh, const Mesh &sec
         addToSourceMap(secondCgalMesh, Source::Second);
     }
     
-    if (Method::Union == method) {
+    if (Method::Union == method && areSeparated(*firstCgalMesh, *secondCgalMesh)) {
+        // Nothing to cut, the union of two apart closed meshes is just both of them
+        resultCgalMesh = new CgalMesh(*firstCgalMesh);
+        *resultCgalMesh += *secondCgalMesh;
+    } else if (Method::Union == method) {
         resultCgalMesh = new CgalMesh;
         try {
             if (!CGAL::Polygon_mesh_processing::corefine_and_compute_union(*firstCgalMesh, *secondCgalMesh, *resultCgalMesh)) {
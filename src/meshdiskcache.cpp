@@ -0,0 +1,265 @@
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDirIterator>
+#include <QDateTime>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <map>
+#include <algorithm>
+#include "meshdiskcache.h"
+extern "C" {
+#include <crc64.h>
+}
+
+// Bump when the file layout or the combination algorithm changes
+static const char g_fileMagic[4] = {'D', 'M', 'C', '3'};
+
+static std::atomic<bool> g_enabled {false};
+static std::atomic<qint64> g_maxSize {256 * 1024 * 1024};
+
+// Entries from the least recently used to the most, seeded from the modification time of the files
+static QMutex g_indexMutex;
+static bool g_indexLoaded = false;
+static std::list<QString> g_usedOrder;
+static std::map<QString, std::pair<qint64, std::list<QString>::iterator>> g_indexEntries;
+static qint64 g_totalSize = 0;
+
+struct MeshDiskCacheHeader
+{
+    char magic[4];
+    quint32 flags;
+    quint32 vertexCount;
+    quint32 faceCount;
+    quint32 indexCount;
+};
+
+static quint64 addMeshToHash(quint64 crc, const MeshCombiner::Mesh &mesh)
+{
+    std::vector<QVector3D> vertices;
+    std::vector<std::vector<size_t>> faces;
+    mesh.fetch(vertices, faces);
+    std::vector<float> positions;
+    positions.reserve(vertices.size() * 3);
+    for (const auto &vertex: vertices) {
+        positions.push_back(vertex.x());
+        positions.push_back(vertex.y());
+        positions.push_back(vertex.z());
+    }
+    std::vector<quint32> indices;
+    for (const auto &face: faces) {
+        indices.push_back((quint32)face.size());
+        for (const auto &index: face)
+            indices.push_back((quint32)index);
+    }
+    quint32 counts[2] = {(quint32)positions.size(), (quint32)indices.size()};
+    crc = crc64(crc, (const unsigned char *)counts, sizeof(counts));
+    crc = crc64(crc, (const unsigned char *)positions.data(), positions.size() * sizeof(float));
+    crc = crc64(crc, (const unsigned char *)indices.data(), indices.size() * sizeof(quint32));
+    return crc;
+}
+
+quint64 MeshDiskCache::combinationKey(const MeshCombiner::Mesh &first, const MeshCombiner::Mesh &second,
+    MeshCombiner::Method method, bool recombine)
+{
+    quint32 settings[2] = {(quint32)method, (quint32)recombine};
+    quint64 crc = crc64(0, (const unsigned char *)g_fileMagic, sizeof(g_fileMagic));
+    crc = crc64(crc, (const unsigned char *)settings, sizeof(settings));
+    crc = addMeshToHash(crc, first);
+    crc = addMeshToHash(crc, second);
+    return crc;
+}
+
+void MeshDiskCache::setEnabled(bool enabled)
+{
+    g_enabled = enabled;
+}
+
+bool MeshDiskCache::isEnabled()
+{
+    return g_enabled;
+}
+
+void MeshDiskCache::setMaxSize(qint64 bytes)
+{
+    g_maxSize = bytes;
+    QMutexLocker locker(&g_indexMutex);
+    if (g_indexLoaded)
+        evict();
+}
+
+QString MeshDiskCache::directory()
+{
+    static const QString s_directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/meshes";
+    return s_directory;
+}
+
+QString MeshDiskCache::filePath(quint64 key)
+{
+    QString name = QString("%1").arg(key, 16, 16, QChar('0'));
+    return directory() + "/" + name.left(2) + "/" + name + ".mesh";
+}
+
+void MeshDiskCache::loadIndex()
+{
+    if (g_indexLoaded)
+        return;
+    g_indexLoaded = true;
+    std::vector<std::pair<QDateTime, std::pair<QString, qint64>>> files;
+    QDirIterator it(directory(), QStringList() << "*.mesh", QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        files.push_back({info.lastModified(), {info.filePath(), info.size()}});
+    }
+    std::sort(files.begin(), files.end(), [](const std::pair<QDateTime, std::pair<QString, qint64>> &first,
+            const std::pair<QDateTime, std::pair<QString, qint64>> &second) {
+        return first.first < second.first;
+    });
+    for (const auto &file: files) {
+        auto position = g_usedOrder.insert(g_usedOrder.end(), file.second.first);
+        g_indexEntries[file.second.first] = {file.second.second, position};
+        g_totalSize += file.second.second;
+    }
+}
+
+void MeshDiskCache::markUsed(const QString &path, qint64 size)
+{
+    QMutexLocker locker(&g_indexMutex);
+    loadIndex();
+    auto findEntry = g_indexEntries.find(path);
+    if (findEntry != g_indexEntries.end()) {
+        g_totalSize -= findEntry->second.first;
+        g_usedOrder.erase(findEntry->second.second);
+        g_indexEntries.erase(findEntry);
+    }
+    auto position = g_usedOrder.insert(g_usedOrder.end(), path);
+    g_indexEntries[path] = {size, position};
+    g_totalSize += size;
+    evict();
+}
+
+void MeshDiskCache::evict()
+{
+    while (g_totalSize > g_maxSize && !g_usedOrder.empty()) {
+        const QString path = g_usedOrder.front();
+        auto findEntry = g_indexEntries.find(path);
+        g_totalSize -= findEntry->second.first;
+        g_indexEntries.erase(findEntry);
+        g_usedOrder.pop_front();
+        QFile::remove(path);
+    }
+}
+
+bool MeshDiskCache::load(quint64 key, std::vector<QVector3D> *vertices, std::vector<std::vector<size_t>> *faces)
+{
+    if (!isEnabled())
+        return false;
+
+    QFile file(filePath(key));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    qint64 size = file.size();
+    if (size < (qint64)sizeof(MeshDiskCacheHeader))
+        return false;
+    const uchar *data = file.map(0, size);
+    if (nullptr == data)
+        return false;
+
+    MeshDiskCacheHeader header;
+    memcpy(&header, data, sizeof(header));
+    qint64 expectedSize = sizeof(header) +
+        (qint64)header.vertexCount * 3 * sizeof(float) +
+        (qint64)header.faceCount * sizeof(quint32) +
+        (qint64)header.indexCount * sizeof(quint32);
+    if (0 != memcmp(header.magic, g_fileMagic, sizeof(g_fileMagic)) || expectedSize != size) {
+        qDebug() << "Mesh cache entry corrupted:" << file.fileName();
+        file.unmap((uchar *)data);
+        return false;
+    }
+
+    const uchar *current = data + sizeof(header);
+    vertices->resize(header.vertexCount);
+    for (auto &vertex: *vertices) {
+        float position[3];
+        memcpy(position, current, sizeof(position));
+        current += sizeof(position);
+        vertex = QVector3D(position[0], position[1], position[2]);
+    }
+    std::vector<quint32> faceSizes(header.faceCount);
+    memcpy(faceSizes.data(), current, faceSizes.size() * sizeof(quint32));
+    current += faceSizes.size() * sizeof(quint32);
+    std::vector<quint32> indices(header.indexCount);
+    memcpy(indices.data(), current, indices.size() * sizeof(quint32));
+    file.unmap((uchar *)data);
+
+    faces->resize(header.faceCount);
+    size_t indexOffset = 0;
+    for (size_t i = 0; i < faceSizes.size(); ++i) {
+        if (indexOffset + faceSizes[i] > indices.size())
+            return false;
+        auto &face = (*faces)[i];
+        face.resize(faceSizes[i]);
+        for (size_t j = 0; j < faceSizes[i]; ++j) {
+            if (indices[indexOffset + j] >= vertices->size())
+                return false;
+            face[j] = indices[indexOffset + j];
+        }
+        indexOffset += faceSizes[i];
+    }
+    markUsed(file.fileName(), size);
+    return true;
+}
+
+void MeshDiskCache::save(quint64 key, const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &faces)
+{
+    if (!isEnabled())
+        return;
+
+    MeshDiskCacheHeader header;
+    memcpy(header.magic, g_fileMagic, sizeof(g_fileMagic));
+    header.flags = 0;
+    header.vertexCount = vertices.size();
+    header.faceCount = faces.size();
+    header.indexCount = 0;
+    for (const auto &face: faces)
+        header.indexCount += face.size();
+
+    QByteArray data;
+    data.reserve(sizeof(header) + vertices.size() * 3 * sizeof(float) +
+        (header.faceCount + header.indexCount) * sizeof(quint32));
+    data.append((const char *)&header, sizeof(header));
+    for (const auto &vertex: vertices) {
+        float position[3] = {vertex.x(), vertex.y(), vertex.z()};
+        data.append((const char *)position, sizeof(position));
+    }
+    for (const auto &face: faces) {
+        quint32 faceSize = face.size();
+        data.append((const char *)&faceSize, sizeof(faceSize));
+    }
+    for (const auto &face: faces) {
+        for (const auto &index: face) {
+            quint32 value = index;
+            data.append((const char *)&value, sizeof(value));
+        }
+    }
+
+    QString path = filePath(key);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    // Written to a temporary file and renamed, concurrent writers and readers never see a partial entry
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+    file.write(data);
+    if (!file.commit()) {
+        qDebug() << "Write mesh cache entry failed:" << path;
+        return;
+    }
+    markUsed(path, data.size());
+}
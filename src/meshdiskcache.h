@@ -0,0 +1,31 @@
+#ifndef DUST3D_MESH_DISK_CACHE_H
+#define DUST3D_MESH_DISK_CACHE_H
+#include <QVector3D>
+#include <QString>
+#include <vector>
+#include "meshcombiner.h"
+
+// Persistent, content-addressed store of mesh combination results.
+// Entries are keyed by the hash of the input geometry and the combine method,
+// so the same inputs skip the CGAL boolean work across sessions and processes.
+// Failed combinations are not stored, the least recently used entries are removed
+// once the cache grows over its size limit. Off unless enabled, the GUI keeps it off.
+class MeshDiskCache
+{
+public:
+    static quint64 combinationKey(const MeshCombiner::Mesh &first, const MeshCombiner::Mesh &second,
+        MeshCombiner::Method method, bool recombine);
+    static bool load(quint64 key, std::vector<QVector3D> *vertices, std::vector<std::vector<size_t>> *faces);
+    static void save(quint64 key, const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &faces);
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+    static void setMaxSize(qint64 bytes);
+private:
+    static QString directory();
+    static QString filePath(quint64 key);
+    static void markUsed(const QString &path, qint64 size);
+    static void loadIndex();
+    static void evict();
+};
+
+#endif
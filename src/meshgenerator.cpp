@@ -1,8 +1,12 @@
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <memory>
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QVector2D>
 #include <QGuiApplication>
 #include <QMatrix4x4>
+#include <QRegExp>
 #include "strokemeshbuilder.h"
 #include "strokemodifier.h"
 #include "meshrecombiner.h"
@@ -22,6 +26,42 @@
 #include "projectfacestonodes.h"
 #include "document.h"
 #include "simulateclothmeshes.h"
+#include "meshdiskcache.h"
+#include "triangletopology.h"
+#include "profiler.h"
+
+GeneratedCacheContext::~GeneratedCacheContext()
+{
+    // Component and part meshes are owned by their own entries
+    for (auto &it: cachedCombination)
+        delete it.second;
+}
+
+void GeneratedCacheContext::addCombination(const QString &combinationKey, MeshCombiner::Mesh *mesh, const std::set<QString> &componentIds)
+{
+    if (!cachedCombination.insert({combinationKey, mesh}).second) {
+        delete mesh;
+        return;
+    }
+    for (const auto &componentId: componentIds)
+        componentCombinations[componentId].insert(combinationKey);
+}
+
+void GeneratedCacheContext::removeComponentCombinations(const QString &componentId)
+{
+    auto findCombinations = componentCombinations.find(componentId);
+    if (findCombinations == componentCombinations.end())
+        return;
+    // Keys left behind under the other components of a removed combination are skipped when they come up
+    for (const auto &combinationKey: findCombinations->second) {
+        auto findCached = cachedCombination.find(combinationKey);
+        if (findCached == cachedCombination.end())
+            continue;
+        delete findCached->second;
+        cachedCombination.erase(findCached);
+    }
+    componentCombinations.erase(findCombinations);
+}
 
 MeshGenerator::MeshGenerator(Snapshot *snapshot) :
     m_snapshot(snapshot)
@@ -35,6 +75,7 @@ MeshGenerator::~MeshGenerator()
     delete m_resultMesh;
     delete m_snapshot;
     delete m_outcome;
+    delete m_mousePickIndex;
     delete m_cutFaceTransforms;
     delete m_nodesCutFaces;
 }
@@ -49,6 +90,16 @@ quint64 MeshGenerator::id()
     return m_id;
 }
 
+void MeshGenerator::cancel()
+{
+    m_isCancelled = true;
+}
+
+bool MeshGenerator::isCancelled() const
+{
+    return m_isCancelled;
+}
+
 bool MeshGenerator::isSucceed()
 {
     return m_isSucceed;
@@ -80,6 +131,18 @@ Outcome *MeshGenerator::takeOutcome()
     return outcome;
 }
 
+const Snapshot *MeshGenerator::snapshot() const
+{
+    return m_snapshot;
+}
+
+MousePickIndex *MeshGenerator::takeMousePickIndex()
+{
+    MousePickIndex *mousePickIndex = m_mousePickIndex;
+    m_mousePickIndex = nullptr;
+    return mousePickIndex;
+}
+
 std::map<QUuid, StrokeMeshBuilder::CutFaceTransform> *MeshGenerator::takeCutFaceTransforms()
 {
     auto cutFaceTransforms = m_cutFaceTransforms;
@@ -96,17 +159,42 @@ std::map<QUuid, std::map<QString, QVector2D>> *MeshGenerator::takeNodesCutFaces(
 
 void MeshGenerator::collectParts()
 {
-    for (const auto &node: m_snapshot->nodes) {
-        QString partId = valueOfKeyInMapOrEmpty(node.second, "partId");
-        if (partId.isEmpty())
+    m_snapshot->resolveTables();
+    const auto &nodeTable = m_snapshot->nodeTable;
+    const auto &edgeTable = m_snapshot->edgeTable;
+    std::map<QUuid, std::vector<size_t>> partNodeIndices;
+    for (size_t i = 0; i < nodeTable.size(); ++i) {
+        if (nodeTable.partIds[i].isNull())
             continue;
-        m_partNodeIds[partId].insert(node.first);
+        partNodeIndices[nodeTable.partIds[i]].push_back(i);
     }
-    for (const auto &edge: m_snapshot->edges) {
-        QString partId = valueOfKeyInMapOrEmpty(edge.second, "partId");
-        if (partId.isEmpty())
+    std::map<QUuid, std::vector<size_t>> partEdgeIndices;
+    for (size_t i = 0; i < edgeTable.size(); ++i) {
+        if (edgeTable.partIds[i].isNull())
             continue;
-        m_partEdgeIds[partId].insert(edge.first);
+        partEdgeIndices[edgeTable.partIds[i]].push_back(i);
+    }
+    for (auto &it: partNodeIndices)
+        m_partNodeIndices[it.first.toString()].swap(it.second);
+    for (auto &it: partEdgeIndices)
+        m_partEdgeIndices[it.first.toString()].swap(it.second);
+    // Make sure every part has its entries, so the lookups from the parallel builds never insert
+    for (const auto &part: m_snapshot->parts) {
+        m_partNodeIndices[part.first];
+        m_partEdgeIndices[part.first];
+    }
+}
+
+void MeshGenerator::prepareCacheEntries()
+{
+    // Components and parts are generated concurrently, create all the cache slots upfront,
+    // the workers only look them up and never change the layout of these maps
+    m_cacheContext->components[QUuid().toString()];
+    for (const auto &component: m_snapshot->components)
+        m_cacheContext->components[component.first];
+    for (const auto &part: m_snapshot->parts) {
+        m_cacheContext->parts[part.first];
+        m_partPreviewMeshes[QUuid(part.first)];
     }
 }
 
@@ -133,13 +221,8 @@ bool MeshGenerator::checkIsPartDependencyDirty(const QString &partIdString)
         if (checkIsPartDirty(cutFaceString))
             return true;
     }
-    for (const auto &nodeIdString: m_partNodeIds[partIdString]) {
-        auto findNode = m_snapshot->nodes.find(nodeIdString);
-        if (findNode == m_snapshot->nodes.end()) {
-            qDebug() << "Find node failed:" << nodeIdString;
-            continue;
-        }
-        QString cutFaceString = valueOfKeyInMapOrEmpty(findNode->second, "cutFace");
+    for (const auto &nodeIndex: m_partNodeIndices[partIdString]) {
+        const QString &cutFaceString = m_snapshot->nodeTable.cutFaces[nodeIndex];
         QUuid cutFaceLinkedPartId = QUuid(cutFaceString);
         if (!cutFaceLinkedPartId.isNull()) {
             if (checkIsPartDirty(cutFaceString))
@@ -211,29 +294,19 @@ void MeshGenerator::cutFaceStringToCutTemplate(const QString &cutFaceString, std
             qDebug() << "Find cut face linked part failed:" << cutFaceString;
         } else {
             // Build node info map
-            for (const auto &nodeIdString: m_partNodeIds[cutFaceString]) {
-                auto findNode = m_snapshot->nodes.find(nodeIdString);
-                if (findNode == m_snapshot->nodes.end()) {
-                    qDebug() << "Find node failed:" << nodeIdString;
-                    continue;
-                }
-                auto &node = findNode->second;
-                float radius = valueOfKeyInMapOrEmpty(node, "radius").toFloat();
-                float x = (valueOfKeyInMapOrEmpty(node, "x").toFloat() - m_mainProfileMiddleX);
-                float y = (m_mainProfileMiddleY - valueOfKeyInMapOrEmpty(node, "y").toFloat());
-                cutFaceNodeMap.insert({nodeIdString, std::make_tuple(radius, x, y)});
+            const auto &nodeTable = m_snapshot->nodeTable;
+            for (const auto &nodeIndex: m_partNodeIndices[cutFaceString]) {
+                float radius = nodeTable.radiuses[nodeIndex];
+                float x = (nodeTable.xs[nodeIndex] - m_mainProfileMiddleX);
+                float y = (m_mainProfileMiddleY - nodeTable.ys[nodeIndex]);
+                cutFaceNodeMap.insert({nodeTable.ids[nodeIndex].toString(), std::make_tuple(radius, x, y)});
             }
             // Build edge link
+            const auto &edgeTable = m_snapshot->edgeTable;
             std::map<QString, std::vector<QString>> cutFaceNodeLinkMap;
-            for (const auto &edgeIdString: m_partEdgeIds[cutFaceString]) {
-                auto findEdge = m_snapshot->edges.find(edgeIdString);
-                if (findEdge == m_snapshot->edges.end()) {
-                    qDebug() << "Find edge failed:" << edgeIdString;
-                    continue;
-                }
-                auto &edge = findEdge->second;
-                QString fromNodeIdString = valueOfKeyInMapOrEmpty(edge, "from");
-                QString toNodeIdString = valueOfKeyInMapOrEmpty(edge, "to");
+            for (const auto &edgeIndex: m_partEdgeIndices[cutFaceString]) {
+                QString fromNodeIdString = edgeTable.fromNodeIds[edgeIndex].toString();
+                QString toNodeIdString = edgeTable.toNodeIds[edgeIndex].toString();
                 cutFaceNodeLinkMap[fromNodeIdString].push_back(toNodeIdString);
                 cutFaceNodeLinkMap[toNodeIdString].push_back(fromNodeIdString);
             }
@@ -327,6 +400,11 @@ void MeshGenerator::cutFaceStringToCutTemplate(const QString &cutFaceString, std
 
 MeshCombiner::Mesh *MeshGenerator::combinePartMesh(const QString &partIdString, bool *hasError, bool addIntermediateNodes)
 {
+    if (isCancelled())
+        return nullptr;
+    
+    Profiler::Scope profile("partBuild");
+    
     auto findPart = m_snapshot->parts.find(partIdString);
     if (findPart == m_snapshot->parts.end()) {
         qDebug() << "Find part failed:" << partIdString;
@@ -429,55 +507,24 @@ MeshCombiner::Mesh *MeshGenerator::combinePartMesh(const QString &partIdString,
         QString cutFace;
     };
     std::map<QString, NodeInfo> nodeInfos;
-    for (const auto &nodeIdString: m_partNodeIds[partIdString]) {
-        auto findNode = m_snapshot->nodes.find(nodeIdString);
-        if (findNode == m_snapshot->nodes.end()) {
-            qDebug() << "Find node failed:" << nodeIdString;
-            continue;
-        }
-        auto &node = findNode->second;
-        
-        float radius = valueOfKeyInMapOrEmpty(node, "radius").toFloat();
-        float x = (valueOfKeyInMapOrEmpty(node, "x").toFloat() - m_mainProfileMiddleX);
-        float y = (m_mainProfileMiddleY - valueOfKeyInMapOrEmpty(node, "y").toFloat());
-        float z = (m_sideProfileMiddleX - valueOfKeyInMapOrEmpty(node, "z").toFloat());
-
-        BoneMark boneMark = BoneMarkFromString(valueOfKeyInMapOrEmpty(node, "boneMark").toUtf8().constData());
-        
-        bool hasCutFaceSettings = false;
-        float cutRotation = 0.0;
-        QString cutFace;
-        
-        const auto &cutFaceIt = node.find("cutFace");
-        if (cutFaceIt != node.end()) {
-            cutFace = cutFaceIt->second;
-            hasCutFaceSettings = true;
-            const auto &cutRotationIt = node.find("cutRotation");
-            if (cutRotationIt != node.end()) {
-                cutRotation = cutRotationIt->second.toFloat();
-            }
-        }
-        
-        auto &nodeInfo = nodeInfos[nodeIdString];
-        nodeInfo.position = QVector3D(x, y, z);
-        nodeInfo.radius = radius;
-        nodeInfo.boneMark = boneMark;
-        nodeInfo.hasCutFaceSettings = hasCutFaceSettings;
-        nodeInfo.cutRotation = cutRotation;
-        nodeInfo.cutFace = cutFace;
+    const auto &nodeTable = m_snapshot->nodeTable;
+    for (const auto &nodeIndex: m_partNodeIndices[partIdString]) {
+        auto &nodeInfo = nodeInfos[nodeTable.ids[nodeIndex].toString()];
+        nodeInfo.position = QVector3D(nodeTable.xs[nodeIndex] - m_mainProfileMiddleX,
+            m_mainProfileMiddleY - nodeTable.ys[nodeIndex],
+            m_sideProfileMiddleX - nodeTable.zs[nodeIndex]);
+        nodeInfo.radius = nodeTable.radiuses[nodeIndex];
+        nodeInfo.boneMark = nodeTable.boneMarks[nodeIndex];
+        nodeInfo.hasCutFaceSettings = nodeTable.hasCutFaces[nodeIndex];
+        nodeInfo.cutRotation = nodeTable.cutRotations[nodeIndex];
+        nodeInfo.cutFace = nodeTable.cutFaces[nodeIndex];
     }
     
     std::set<std::pair<QString, QString>> edges;
-    for (const auto &edgeIdString: m_partEdgeIds[partIdString]) {
-        auto findEdge = m_snapshot->edges.find(edgeIdString);
-        if (findEdge == m_snapshot->edges.end()) {
-            qDebug() << "Find edge failed:" << edgeIdString;
-            continue;
-        }
-        auto &edge = findEdge->second;
-        
-        QString fromNodeIdString = valueOfKeyInMapOrEmpty(edge, "from");
-        QString toNodeIdString = valueOfKeyInMapOrEmpty(edge, "to");
+    const auto &edgeTable = m_snapshot->edgeTable;
+    for (const auto &edgeIndex: m_partEdgeIndices[partIdString]) {
+        QString fromNodeIdString = edgeTable.fromNodeIds[edgeIndex].toString();
+        QString toNodeIdString = edgeTable.toNodeIds[edgeIndex].toString();
         
         const auto &findFromNodeInfo = nodeInfos.find(fromNodeIdString);
         if (findFromNodeInfo == nodeInfos.end()) {
@@ -505,6 +552,7 @@ MeshCombiner::Mesh *MeshGenerator::combinePartMesh(const QString &partIdString,
     if (xMirrored) {
         mirroredPartId = QUuid().createUuid();
         mirroredPartIdString = mirroredPartId.toString();
+        QMutexLocker locker(&m_cacheMutex);
         m_cacheContext->partMirrorIdMap[mirroredPartIdString] = partIdString;
     }
     
@@ -630,7 +678,11 @@ MeshCombiner::Mesh *MeshGenerator::combinePartMesh(const QString &partIdString,
     }
     for (const auto &edge: nodeMeshModifier->edges())
         nodeMeshBuilder->addEdge(edge.firstNodeIndex, edge.secondNodeIndex);
-    buildSucceed = nodeMeshBuilder->build();
+    {
+        Profiler::Scope profile("strokeMeshBuilder");
+        buildSucceed = nodeMeshBuilder->build();
+        profile.setArg("trianglesOut", nodeMeshBuilder->generatedFaces().size());
+    }
     
     partCache.vertices = nodeMeshBuilder->generatedVertices();
     partCache.faces = nodeMeshBuilder->generatedFaces();
@@ -706,9 +758,20 @@ MeshCombiner::Mesh *MeshGenerator::combinePartMesh(const QString &partIdString,
         qDebug() << "Mesh build failed";
     }
     
+    if (isCancelled()) {
+        // An interrupted mirror union is not a real failure, don't report it in the part preview
+        delete nodeMeshBuilder;
+        delete nodeMeshModifier;
+        delete mesh;
+        return nullptr;
+    }
+    
     delete m_partPreviewMeshes[partId];
     m_partPreviewMeshes[partId] = nullptr;
-    m_generatedPreviewPartIds.insert(partId);
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        m_generatedPreviewPartIds.insert(partId);
+    }
     
     std::vector<QVector3D> partPreviewVertices;
     QColor partPreviewColor = partColor;
@@ -917,10 +980,13 @@ MeshCombiner::Mesh *MeshGenerator::combineComponentMesh(const QString &component
     
     if (m_cacheEnabled) {
         if (m_dirtyComponentIds.find(componentIdString) == m_dirtyComponentIds.end()) {
-            if (nullptr != componentCache.mesh)
+            if (nullptr != componentCache.mesh) {
+                Profiler::increase("componentCacheHit");
                 return new MeshCombiner::Mesh(*componentCache.mesh);
+            }
         }
     }
+    Profiler::increase("componentCacheMiss");
     
     componentCache.sharedQuadEdges.clear();
     componentCache.noneSeamVertices.clear();
@@ -936,7 +1002,7 @@ MeshCombiner::Mesh *MeshGenerator::combineComponentMesh(const QString &component
         QString partIdString = valueOfKeyInMapOrEmpty(*component, "linkData");
         bool hasError = false;
         mesh = combinePartMesh(partIdString, &hasError);
-        if (hasError) {
+        if (hasError && !isCancelled()) {
             delete mesh;
             hasError = false;
             qDebug() << "Try combine part again without adding intermediate nodes";
@@ -946,17 +1012,20 @@ MeshCombiner::Mesh *MeshGenerator::combineComponentMesh(const QString &component
             }
         }
         
-        const auto &partCache = m_cacheContext->parts[partIdString];
-        for (const auto &vertex: partCache.vertices)
-            componentCache.noneSeamVertices.insert(vertex);
-        collectSharedQuadEdges(partCache.vertices, partCache.faces, &componentCache.sharedQuadEdges);
-        for (const auto &it: partCache.outcomeNodes)
-            componentCache.outcomeNodes.push_back(it);
-        for (const auto &it: partCache.outcomeEdges)
-            componentCache.outcomeEdges.push_back(it);
-        for (const auto &it: partCache.outcomeNodeVertices)
-            componentCache.outcomeNodeVertices.push_back(it);
-        componentCache.outcomePaintMaps.push_back(partCache.outcomePaintMap);
+        auto findPartCache = m_cacheContext->parts.find(partIdString);
+        if (findPartCache != m_cacheContext->parts.end()) {
+            const auto &partCache = findPartCache->second;
+            for (const auto &vertex: partCache.vertices)
+                componentCache.noneSeamVertices.insert(vertex);
+            collectSharedQuadEdges(partCache.vertices, partCache.faces, &componentCache.sharedQuadEdges);
+            for (const auto &it: partCache.outcomeNodes)
+                componentCache.outcomeNodes.push_back(it);
+            for (const auto &it: partCache.outcomeEdges)
+                componentCache.outcomeEdges.push_back(it);
+            for (const auto &it: partCache.outcomeNodeVertices)
+                componentCache.outcomeNodeVertices.push_back(it);
+            componentCache.outcomePaintMaps.push_back(partCache.outcomePaintMap);
+        }
     } else {
         std::vector<std::pair<CombineMode, std::vector<std::pair<QString, QString>>>> combineGroups;
         // Firstly, group by combine mode
@@ -984,6 +1053,25 @@ MeshCombiner::Mesh *MeshGenerator::combineComponentMesh(const QString &component
             }
             combineGroups[currentGroupIndex].second.push_back({childIdString, colorName});
         }
+        // Generate the child subtrees concurrently, they only depend on their own cache entries,
+        // the results are combined below in the same order as the serial walk
+        std::vector<QString> childIdStrings;
+        for (const auto &group: combineGroups) {
+            for (const auto &it: group.second)
+                childIdStrings.push_back(it.first);
+        }
+        std::vector<std::pair<MeshCombiner::Mesh *, CombineMode>> childResults(childIdStrings.size(),
+            std::make_pair(nullptr, CombineMode::Normal));
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, childIdStrings.size()),
+                [&](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i != range.end(); ++i) {
+                auto &result = childResults[i];
+                result.first = combineComponentMesh(childIdStrings[i], &result.second);
+            }
+        });
+        std::map<QString, std::pair<MeshCombiner::Mesh *, CombineMode>> childMeshes;
+        for (size_t i = 0; i < childIdStrings.size(); ++i)
+            childMeshes.insert({childIdStrings[i], childResults[i]});
         // Secondly, sub group by color
         std::vector<std::tuple<MeshCombiner::Mesh *, CombineMode, QString>> groupMeshes;
         for (const auto &group: combineGroups) {
@@ -1027,7 +1115,7 @@ MeshCombiner::Mesh *MeshGenerator::combineComponentMesh(const QString &component
                 QStringList componentChildGroupIdStringList;
                 for (const auto &componentChildGroupIdString: it)
                     componentChildGroupIdStringList += componentChildGroupIdString;
-                MeshCombiner::Mesh *childMesh = combineComponentChildGroupMesh(it, componentCache);
+                MeshCombiner::Mesh *childMesh = combineComponentChildGroupMesh(it, componentCache, childMeshes);
                 if (nullptr == childMesh)
                     continue;
                 if (childMesh->isNull()) {
@@ -1043,9 +1131,17 @@ MeshCombiner::Mesh *MeshGenerator::combineComponentMesh(const QString &component
                 continue;
             groupMeshes.push_back(std::make_tuple(subGroupMesh, group.first, subGroupMeshIdStringList.join("&")));
         }
+        for (auto &it: childMeshes)
+            delete it.second.first;
         mesh = combineMultipleMeshes(groupMeshes, true);
     }
     
+    if (isCancelled()) {
+        // Leave the cache slot empty, the next generation builds this component again
+        delete mesh;
+        return nullptr;
+    }
+    
     if (nullptr != mesh)
         componentCache.mesh = new MeshCombiner::Mesh(*mesh);
     
@@ -1089,6 +1185,12 @@ MeshCombiner::Mesh *MeshGenerator::combineComponentMesh(const QString &component
                 &newQuads,
                 &newTriangles,
                 &componentCache.outcomeNodeVertices);
+            if (isCancelled()) {
+                delete mesh;
+                delete componentCache.mesh;
+                componentCache.mesh = nullptr;
+                return nullptr;
+            }
             componentCache.sharedQuadEdges.clear();
             for (const auto &face: newQuads) {
                 if (face.size() != 4)
@@ -1124,10 +1226,89 @@ MeshCombiner::Mesh *MeshGenerator::combineComponentMesh(const QString &component
     return mesh;
 }
 
+void MeshGenerator::combineCachedOperands(CombinationOperand *first, CombinationOperand *second,
+    MeshCombiner::Method method, bool recombine, const QString &combinationKey)
+{
+    // The result goes into the first operand, the second one is consumed,
+    // on failure the first operand is kept as it is like the serial fold did
+    std::set<QString> componentIds = first->componentIds;
+    componentIds.insert(second->componentIds.begin(), second->componentIds.end());
+    MeshCombiner::Mesh *newMesh = nullptr;
+    bool foundCached = false;
+    MeshCombiner::Mesh *cachedMesh = nullptr;
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        auto findCached = m_cacheContext->cachedCombination.find(combinationKey);
+        if (findCached != m_cacheContext->cachedCombination.end()) {
+            foundCached = true;
+            cachedMesh = findCached->second;
+        }
+    }
+    Profiler::increase(foundCached ? "combinationCacheHit" : "combinationCacheMiss");
+    if (foundCached) {
+        if (nullptr != cachedMesh) {
+            //qDebug() << "Use cached combination:" << combinationKey;
+            newMesh = new MeshCombiner::Mesh(*cachedMesh);
+        }
+    } else if (!isCancelled()) {
+        newMesh = combineTwoMeshes(*first->mesh,
+            *second->mesh,
+            method,
+            recombine);
+        // A combination skipped by cancellation must not be remembered as a failed one
+        if (nullptr != newMesh || !isCancelled()) {
+            MeshCombiner::Mesh *cachingMesh = nullptr != newMesh ? new MeshCombiner::Mesh(*newMesh) : nullptr;
+            QMutexLocker locker(&m_cacheMutex);
+            m_cacheContext->addCombination(combinationKey, cachingMesh, componentIds);
+            //qDebug() << "Add cached combination:" << combinationKey;
+        }
+    }
+    delete second->mesh;
+    second->mesh = nullptr;
+    if (newMesh && !newMesh->isNull()) {
+        delete first->mesh;
+        first->mesh = newMesh;
+    } else {
+        if (!isCancelled()) {
+            m_isSucceed = false;
+            qDebug() << "Mesh combine failed";
+        }
+        delete newMesh;
+    }
+    first->idString = combinationKey;
+    first->componentIds = componentIds;
+}
+
+MeshGenerator::CombinationOperand MeshGenerator::reduceUnionOperands(std::vector<CombinationOperand> &operands, bool recombine)
+{
+    // Pairs are always formed by position, never by completion order, so the result is the same on every run
+    while (operands.size() > 1) {
+        size_t pairCount = operands.size() / 2;
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, pairCount, 1),
+                [&](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i != range.end(); ++i) {
+                auto &first = operands[i * 2];
+                auto &second = operands[i * 2 + 1];
+                QString combinationKey = "(" + first.idString + "+" + second.idString + ")";
+                if (recombine)
+                    combinationKey += "!";
+                combineCachedOperands(&first, &second, MeshCombiner::Method::Union, recombine, combinationKey);
+            }
+        });
+        std::vector<CombinationOperand> nextOperands;
+        nextOperands.reserve(pairCount + 1);
+        for (size_t i = 0; i < operands.size(); i += 2)
+            nextOperands.push_back(std::move(operands[i]));
+        operands.swap(nextOperands);
+    }
+    return std::move(operands[0]);
+}
+
 MeshCombiner::Mesh *MeshGenerator::combineMultipleMeshes(const std::vector<std::tuple<MeshCombiner::Mesh *, CombineMode, QString>> &multipleMeshes, bool recombine)
 {
-    MeshCombiner::Mesh *mesh = nullptr;
-    QString meshIdStrings;
+    // Unions are associative, so every run of consecutive unions is reduced as a balanced tree,
+    // each inversion still applies to everything combined before it
+    std::vector<std::pair<MeshCombiner::Method, std::vector<CombinationOperand>>> runs;
     for (const auto &it: multipleMeshes) {
         const auto &childCombineMode = std::get<1>(it);
         MeshCombiner::Mesh *subMesh = std::get<0>(it);
@@ -1142,46 +1323,36 @@ MeshCombiner::Mesh *MeshGenerator::combineMultipleMeshes(const std::vector<std::
             delete subMesh;
             continue;
         }
-        if (nullptr == mesh) {
-            mesh = subMesh;
-            meshIdStrings = subMeshIdString;
-        } else {
-            auto combinerMethod = childCombineMode == CombineMode::Inversion ?
-                    MeshCombiner::Method::Diff : MeshCombiner::Method::Union;
-            auto combinerMethodString = combinerMethod == MeshCombiner::Method::Union ?
-                "+" : "-";
-            meshIdStrings += combinerMethodString + subMeshIdString;
-            if (recombine)
-                meshIdStrings += "!";
-            MeshCombiner::Mesh *newMesh = nullptr;
-            auto findCached = m_cacheContext->cachedCombination.find(meshIdStrings);
-            if (findCached != m_cacheContext->cachedCombination.end()) {
-                if (nullptr != findCached->second) {
-                    //qDebug() << "Use cached combination:" << meshIdStrings;
-                    newMesh = new MeshCombiner::Mesh(*findCached->second);
-                }
-            } else {
-                newMesh = combineTwoMeshes(*mesh,
-                    *subMesh,
-                    combinerMethod,
-                    recombine);
-                delete subMesh;
-                if (nullptr != newMesh)
-                    m_cacheContext->cachedCombination.insert({meshIdStrings, new MeshCombiner::Mesh(*newMesh)});
-                else
-                    m_cacheContext->cachedCombination.insert({meshIdStrings, nullptr});
-                //qDebug() << "Add cached combination:" << meshIdStrings;
-            }
-            if (newMesh && !newMesh->isNull()) {
-                delete mesh;
-                mesh = newMesh;
-            } else {
-                m_isSucceed = false;
-                qDebug() << "Mesh combine failed";
-                delete newMesh;
-            }
+        CombinationOperand operand;
+        operand.mesh = subMesh;
+        operand.idString = subMeshIdString;
+        // Child group and sub group ids are component ids joined by "|" and "&"
+        for (const auto &componentId: subMeshIdString.split(QRegExp("[|&]"), QString::SkipEmptyParts))
+            operand.componentIds.insert(componentId);
+        auto combinerMethod = (!runs.empty() && childCombineMode == CombineMode::Inversion) ?
+            MeshCombiner::Method::Diff : MeshCombiner::Method::Union;
+        if (runs.empty() || MeshCombiner::Method::Diff == combinerMethod ||
+                MeshCombiner::Method::Diff == runs.back().first) {
+            runs.push_back({combinerMethod, std::vector<CombinationOperand>()});
         }
+        runs.back().second.push_back(std::move(operand));
     }
+    if (runs.empty())
+        return nullptr;
+    
+    CombinationOperand result = reduceUnionOperands(runs[0].second, recombine);
+    for (size_t i = 1; i < runs.size(); ++i) {
+        auto combinerMethod = runs[i].first;
+        CombinationOperand operand = reduceUnionOperands(runs[i].second, recombine);
+        auto combinerMethodString = combinerMethod == MeshCombiner::Method::Union ?
+            "+" : "-";
+        QString combinationKey = result.idString + combinerMethodString + operand.idString;
+        if (recombine)
+            combinationKey += "!";
+        combineCachedOperands(&result, &operand, combinerMethod, recombine, combinationKey);
+    }
+    
+    MeshCombiner::Mesh *mesh = result.mesh;
     if (nullptr != mesh && mesh->isNull()) {
         delete mesh;
         mesh = nullptr;
@@ -1189,19 +1360,27 @@ MeshCombiner::Mesh *MeshGenerator::combineMultipleMeshes(const std::vector<std::
     return mesh;
 }
 
-MeshCombiner::Mesh *MeshGenerator::combineComponentChildGroupMesh(const std::vector<QString> &componentIdStrings, GeneratedComponent &componentCache)
+MeshCombiner::Mesh *MeshGenerator::combineComponentChildGroupMesh(const std::vector<QString> &componentIdStrings, GeneratedComponent &componentCache,
+    std::map<QString, std::pair<MeshCombiner::Mesh *, CombineMode>> &childMeshes)
 {
     std::vector<std::tuple<MeshCombiner::Mesh *, CombineMode, QString>> multipleMeshes;
     for (const auto &childIdString: componentIdStrings) {
-        CombineMode childCombineMode = CombineMode::Normal;
-        MeshCombiner::Mesh *subMesh = combineComponentMesh(childIdString, &childCombineMode);
+        auto &childResult = childMeshes[childIdString];
+        CombineMode childCombineMode = childResult.second;
+        MeshCombiner::Mesh *subMesh = childResult.first;
+        childResult.first = nullptr;
         
         if (CombineMode::Uncombined == childCombineMode) {
             delete subMesh;
             continue;
         }
         
-        const auto &childComponentCache = m_cacheContext->components[childIdString];
+        auto findChildComponentCache = m_cacheContext->components.find(childIdString);
+        if (findChildComponentCache == m_cacheContext->components.end()) {
+            delete subMesh;
+            continue;
+        }
+        const auto &childComponentCache = findChildComponentCache->second;
         for (const auto &vertex: childComponentCache.noneSeamVertices)
             componentCache.noneSeamVertices.insert(vertex);
         for (const auto &it: childComponentCache.sharedQuadEdges)
@@ -1231,6 +1410,29 @@ MeshCombiner::Mesh *MeshGenerator::combineTwoMeshes(const MeshCombiner::Mesh &fi
 {
     if (first.isNull() || second.isNull())
         return nullptr;
+    if (isCancelled())
+        return nullptr;
+    Profiler::Scope profile("combine");
+    profile.setArg("trianglesIn", first.faceCount() + second.faceCount());
+    // The key fetches and hashes both operands, only worth it when the disk cache is on
+    bool useDiskCache = MeshDiskCache::isEnabled();
+    quint64 diskCacheKey = 0;
+    if (useDiskCache) {
+        diskCacheKey = MeshDiskCache::combinationKey(first, second, method, recombine);
+        std::vector<QVector3D> cachedVertices;
+        std::vector<std::vector<size_t>> cachedFaces;
+        if (MeshDiskCache::load(diskCacheKey, &cachedVertices, &cachedFaces)) {
+            Profiler::increase("diskCacheHit");
+            MeshCombiner::Mesh *cachedMesh = new MeshCombiner::Mesh(cachedVertices, cachedFaces, true);
+            if (!cachedMesh->isNull()) {
+                profile.setArg("trianglesOut", cachedMesh->faceCount());
+                return cachedMesh;
+            }
+            delete cachedMesh;
+        } else {
+            Profiler::increase("diskCacheMiss");
+        }
+    }
     std::vector<std::pair<MeshCombiner::Source, size_t>> combinedVerticesSources;
     MeshCombiner::Mesh *newMesh = MeshCombiner::combine(first,
         second,
@@ -1261,6 +1463,13 @@ MeshCombiner::Mesh *MeshGenerator::combineTwoMeshes(const MeshCombiner::Mesh &fi
         delete newMesh;
         return nullptr;
     }
+    if (useDiskCache) {
+        std::vector<QVector3D> resultVertices;
+        std::vector<std::vector<size_t>> resultFaces;
+        newMesh->fetch(resultVertices, resultFaces);
+        MeshDiskCache::save(diskCacheKey, resultVertices, resultFaces);
+    }
+    profile.setArg("trianglesOut", newMesh->faceCount());
     return newMesh;
 }
 
@@ -1320,6 +1529,8 @@ void MeshGenerator::generate()
     
     m_isSucceed = true;
     
+    Profiler::Scope profile("generate");
+    
     QElapsedTimer countTimeConsumed;
     countTimeConsumed.start();
     
@@ -1351,15 +1562,7 @@ void MeshGenerator::generate()
         }
         for (auto it = m_cacheContext->components.begin(); it != m_cacheContext->components.end(); ) {
             if (m_snapshot->components.find(it->first) == m_snapshot->components.end()) {
-                for (auto combinationIt = m_cacheContext->cachedCombination.begin(); combinationIt != m_cacheContext->cachedCombination.end(); ) {
-                    if (-1 != combinationIt->first.indexOf(it->first)) {
-                        //qDebug() << "Removed cached combination:" << combinationIt->first;
-                        delete combinationIt->second;
-                        combinationIt = m_cacheContext->cachedCombination.erase(combinationIt);
-                        continue;
-                    }
-                    combinationIt++;
-                }
+                m_cacheContext->removeComponentCombinations(it->first);
                 it = m_cacheContext->components.erase(it);
                 continue;
             }
@@ -1367,19 +1570,28 @@ void MeshGenerator::generate()
         }
     }
     
+    auto releaseCacheContext = [&]() {
+        if (needDeleteCacheContext) {
+            delete m_cacheContext;
+            m_cacheContext = nullptr;
+        }
+    };
+    
     collectParts();
+    prepareCacheEntries();
     checkDirtyFlags();
     
+    // Dirty flags already propagate from the changed components up to the root,
+    // so this drops exactly the combinations on those paths and keeps the ones of untouched siblings
+    for (const auto &dirtyComponentId: m_dirtyComponentIds)
+        m_cacheContext->removeComponentCombinations(dirtyComponentId);
+    
+    // The document clears its dirty flags once the snapshot is taken, if this generation gets cancelled
+    // before reaching a dirty component, its old mesh must not look valid to the next one
     for (const auto &dirtyComponentId: m_dirtyComponentIds) {
-        for (auto combinationIt = m_cacheContext->cachedCombination.begin(); combinationIt != m_cacheContext->cachedCombination.end(); ) {
-            if (-1 != combinationIt->first.indexOf(dirtyComponentId)) {
-                //qDebug() << "Removed dirty cached combination:" << combinationIt->first;
-                delete combinationIt->second;
-                combinationIt = m_cacheContext->cachedCombination.erase(combinationIt);
-                continue;
-            }
-            combinationIt++;
-        }
+        auto &componentCache = m_cacheContext->components[dirtyComponentId];
+        delete componentCache.mesh;
+        componentCache.mesh = nullptr;
     }
     
     m_dirtyComponentIds.insert(QUuid().toString());
@@ -1393,33 +1605,60 @@ void MeshGenerator::generate()
     CombineMode combineMode;
     auto combinedMesh = combineComponentMesh(QUuid().toString(), &combineMode);
     
+    auto abortCancelled = [&]() {
+        qDebug() << "The mesh generation cancelled after" << countTimeConsumed.elapsed() << "milliseconds";
+        m_isSucceed = false;
+        delete m_outcome;
+        m_outcome = nullptr;
+        delete combinedMesh;
+        releaseCacheContext();
+    };
+    if (isCancelled()) {
+        abortCancelled();
+        return;
+    }
+    
     const auto &componentCache = m_cacheContext->components[QUuid().toString()];
     
     std::vector<QVector3D> combinedVertices;
     std::vector<std::vector<size_t>> combinedFaces;
+    std::unique_ptr<TriangleTopology> combinedTopology;
     if (nullptr != combinedMesh) {
         combinedMesh->fetch(combinedVertices, combinedFaces);
         
         if (!remeshed) {
+            Profiler::Scope profile("weldSeam");
+            profile.setArg("trianglesIn", combinedFaces.size());
             size_t totalAffectedNum = 0;
             size_t affectedNum = 0;
             do {
                 std::vector<QVector3D> weldedVertices;
                 std::vector<std::vector<size_t>> weldedFaces;
-                affectedNum = weldSeam(combinedVertices, combinedFaces,
+                combinedTopology.reset(new TriangleTopology(combinedFaces, combinedVertices.size()));
+                affectedNum = weldSeam(combinedVertices, combinedFaces, *combinedTopology,
                     0.025, componentCache.noneSeamVertices,
                     weldedVertices, weldedFaces);
+                // The last pass usually leaves the mesh untouched, then its topology is still valid for quads recovery
+                if (weldedVertices.size() != combinedVertices.size() || weldedFaces != combinedFaces)
+                    combinedTopology.reset();
                 combinedVertices = weldedVertices;
                 combinedFaces = weldedFaces;
                 totalAffectedNum += affectedNum;
-            } while (affectedNum > 0);
+            } while (affectedNum > 0 && !isCancelled());
             qDebug() << "Total weld affected triangles:" << totalAffectedNum;
+            profile.setArg("trianglesOut", combinedFaces.size());
         }
+        if (isCancelled()) {
+            abortCancelled();
+            return;
+        }
+        if (nullptr == combinedTopology)
+            combinedTopology.reset(new TriangleTopology(combinedFaces, combinedVertices.size()));
         
         m_outcome->nodes = componentCache.outcomeNodes;
         m_outcome->edges = componentCache.outcomeEdges;
         m_outcome->paintMaps = componentCache.outcomePaintMaps;
-        recoverQuads(combinedVertices, combinedFaces, componentCache.sharedQuadEdges, m_outcome->triangleAndQuads);
+        recoverQuads(combinedVertices, combinedFaces, *combinedTopology, componentCache.sharedQuadEdges, m_outcome->triangleAndQuads);
             m_outcome->nodeVertices = componentCache.outcomeNodeVertices;
             m_outcome->vertices = combinedVertices;
             m_outcome->triangles = combinedFaces;
@@ -1447,6 +1686,10 @@ void MeshGenerator::generate()
     }
     
     collectClothComponent(QUuid().toString());
+    if (isCancelled()) {
+        abortCancelled();
+        return;
+    }
     
     // Collect errored parts
     for (const auto &it: m_cacheContext->parts) {
@@ -1473,7 +1716,17 @@ void MeshGenerator::generate()
         }
     }
     
-    auto postprocessOutcome = [this](Outcome *outcome) {
+    // Cloth and errored parts are only appended, when there is none the outcome is still the welded mesh
+    const TriangleTopology *outcomeTopology = nullptr;
+    if (nullptr != combinedTopology &&
+            m_outcome->vertices.size() == combinedVertices.size() &&
+            m_outcome->triangles.size() == combinedFaces.size()) {
+        outcomeTopology = combinedTopology.get();
+    }
+    
+    auto postprocessOutcome = [&](Outcome *outcome) {
+        Profiler::Scope profile("postprocess");
+        profile.setArg("trianglesIn", outcome->triangles.size());
         std::vector<QVector3D> combinedFacesNormals;
         for (const auto &face: outcome->triangles) {
             combinedFacesNormals.push_back(QVector3D::normal(
@@ -1506,7 +1759,8 @@ void MeshGenerator::generate()
         generateSmoothTriangleVertexNormals(outcome->vertices,
             outcome->triangles,
             outcome->triangleNormals,
-            &triangleVertexNormals);
+            &triangleVertexNormals,
+            outcomeTopology);
         outcome->setTriangleVertexNormals(triangleVertexNormals);
     };
     
@@ -1514,12 +1768,11 @@ void MeshGenerator::generate()
     
     m_resultMesh = new MeshLoader(*m_outcome);
     
+    m_mousePickIndex = new MousePickIndex(*m_outcome);
+    
     delete combinedMesh;
 
-    if (needDeleteCacheContext) {
-        delete m_cacheContext;
-        m_cacheContext = nullptr;
-    }
+    releaseCacheContext();
     
     qDebug() << "The mesh generation took" << countTimeConsumed.elapsed() << "milliseconds";
 }
@@ -1543,10 +1796,15 @@ void MeshGenerator::remesh(const std::vector<OutcomeNode> &inputNodes,
         const auto &sourceNode = inputNodes[std::get<2>(it)];
         sourceIds.push_back(std::make_pair(sourceNode.partId, sourceNode.nodeId));
     }
+    Profiler::Scope profile("remesh");
+    profile.setArg("trianglesIn", inputFaces.size());
     Remesher remesher;
     remesher.setMesh(inputVertices, inputFaces);
     remesher.setNodes(nodes, sourceIds);
+    remesher.setCancelFlag(&m_isCancelled);
     remesher.remesh(targetVertexMultiplyFactor);
+    if (isCancelled())
+        return;
     *outputVertices = remesher.getRemeshedVertices();
     const auto &remeshedFaces = remesher.getRemeshedFaces();
     *outputQuads = remeshedFaces;
@@ -1571,6 +1829,7 @@ void MeshGenerator::remesh(const std::vector<OutcomeNode> &inputNodes,
             continue;
         outputNodeVertices->push_back(std::make_pair((*outputVertices)[i], vertexSource));
     }
+    profile.setArg("trianglesOut", outputTriangles->size());
 }
 
 void MeshGenerator::collectUncombinedComponent(const QString &componentIdString)
@@ -1665,9 +1924,14 @@ void MeshGenerator::collectClothComponent(const QString &componentIdString)
         m_outcome->nodes.insert(m_outcome->nodes.end(), componentCache.outcomeNodes.begin(), componentCache.outcomeNodes.end());
         m_outcome->edges.insert(m_outcome->edges.end(), componentCache.outcomeEdges.begin(), componentCache.outcomeEdges.end());
     }
-    simulateClothMeshes(&clothMeshes,
-        &m_clothCollisionVertices,
-        &m_clothCollisionTriangles);
+    {
+        Profiler::Scope profile("cloth");
+        profile.setArg("meshes", clothMeshes.size());
+        simulateClothMeshes(&clothMeshes,
+            &m_clothCollisionVertices,
+            &m_clothCollisionTriangles,
+            &m_isCancelled);
+    }
     for (auto &clothMesh: clothMeshes) {
         auto vertexStartIndex = m_outcome->vertices.size();
         auto updateVertexIndices = [=](std::vector<std::vector<size_t>> &faces) {
@@ -1700,14 +1964,24 @@ void MeshGenerator::collectClothComponent(const QString &componentIdString)
 
 void MeshGenerator::generateSmoothTriangleVertexNormals(const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &triangles,
     const std::vector<QVector3D> &triangleNormals,
-    std::vector<std::vector<QVector3D>> *triangleVertexNormals)
+    std::vector<std::vector<QVector3D>> *triangleVertexNormals,
+    const TriangleTopology *topology)
 {
     std::vector<QVector3D> smoothNormals;
-    angleSmooth(vertices,
-        triangles,
-        triangleNormals,
-        m_smoothShadingThresholdAngleDegrees,
-        smoothNormals);
+    if (nullptr != topology) {
+        angleSmooth(vertices,
+            triangles,
+            *topology,
+            triangleNormals,
+            m_smoothShadingThresholdAngleDegrees,
+            smoothNormals);
+    } else {
+        angleSmooth(vertices,
+            triangles,
+            triangleNormals,
+            m_smoothShadingThresholdAngleDegrees,
+            smoothNormals);
+    }
     triangleVertexNormals->resize(triangles.size(), {
         QVector3D(), QVector3D(), QVector3D()
     });
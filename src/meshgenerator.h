@@ -3,7 +3,9 @@
 #include <QObject>
 #include <set>
 #include <QColor>
+#include <QMutex>
 #include <tuple>
+#include <atomic>
 #include "meshcombiner.h"
 #include "positionkey.h"
 #include "strokemeshbuilder.h"
@@ -13,6 +15,9 @@
 #include "meshloader.h"
 #include "componentlayer.h"
 #include "clothforce.h"
+#include "mousepickindex.h"
+
+class TriangleTopology;
 
 class GeneratedPart
 {
@@ -53,10 +58,15 @@ public:
 class GeneratedCacheContext
 {
 public:
+    ~GeneratedCacheContext();
     std::map<QString, GeneratedComponent> components;
     std::map<QString, GeneratedPart> parts;
     std::map<QString, QString> partMirrorIdMap;
     std::map<QString, MeshCombiner::Mesh *> cachedCombination;
+    // Cached combinations which used each component, so a changed component drops only its own combinations
+    std::map<QString, std::set<QString>> componentCombinations;
+    void addCombination(const QString &combinationKey, MeshCombiner::Mesh *mesh, const std::set<QString> &componentIds);
+    void removeComponentCombinations(const QString &componentId);
 };
 
 class MeshGenerator : public QObject
@@ -70,6 +80,8 @@ public:
     MeshLoader *takePartPreviewMesh(const QUuid &partId);
     const std::set<QUuid> &generatedPreviewPartIds();
     Outcome *takeOutcome();
+    const Snapshot *snapshot() const;
+    MousePickIndex *takeMousePickIndex();
     std::map<QUuid, StrokeMeshBuilder::CutFaceTransform> *takeCutFaceTransforms();
     std::map<QUuid, std::map<QString, QVector2D>> *takeNodesCutFaces();
     void generate();
@@ -78,6 +90,8 @@ public:
     void setDefaultPartColor(const QColor &color);
     void setId(quint64 id);
     quint64 id();
+    void cancel();
+    bool isCancelled() const;
 signals:
     void finished();
 public slots:
@@ -93,12 +107,14 @@ private:
     float m_sideProfileMiddleX = 0;
     float m_mainProfileMiddleY = 0;
     Outcome *m_outcome = nullptr;
-    std::map<QString, std::set<QString>> m_partNodeIds;
-    std::map<QString, std::set<QString>> m_partEdgeIds;
+    MousePickIndex *m_mousePickIndex = nullptr;
+    std::map<QString, std::vector<size_t>> m_partNodeIndices;
+    std::map<QString, std::vector<size_t>> m_partEdgeIndices;
     std::set<QUuid> m_generatedPreviewPartIds;
     MeshLoader *m_resultMesh = nullptr;
     std::map<QUuid, MeshLoader *> m_partPreviewMeshes;
-    bool m_isSucceed = false;
+    std::atomic<bool> m_isSucceed {false};
+    std::atomic<bool> m_isCancelled {false};
     bool m_cacheEnabled = false;
     float m_smoothShadingThresholdAngleDegrees = 60;
     std::map<QUuid, StrokeMeshBuilder::CutFaceTransform> *m_cutFaceTransforms = nullptr;
@@ -106,8 +122,10 @@ private:
     quint64 m_id = 0;
     std::vector<QVector3D> m_clothCollisionVertices;
     std::vector<std::vector<size_t>> m_clothCollisionTriangles;
+    QMutex m_cacheMutex;
     
     void collectParts();
+    void prepareCacheEntries();
     bool checkIsComponentDirty(const QString &componentIdString);
     bool checkIsPartDirty(const QString &partIdString);
     bool checkIsPartDependencyDirty(const QString &partIdString);
@@ -123,13 +141,24 @@ private:
         bool recombine=true);
     void generateSmoothTriangleVertexNormals(const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &triangles,
         const std::vector<QVector3D> &triangleNormals,
-        std::vector<std::vector<QVector3D>> *triangleVertexNormals);
+        std::vector<std::vector<QVector3D>> *triangleVertexNormals,
+        const TriangleTopology *topology=nullptr);
     const std::map<QString, QString> *findComponent(const QString &componentIdString);
     CombineMode componentCombineMode(const std::map<QString, QString> *component);
     bool componentRemeshed(const std::map<QString, QString> *component, float *polyCountValue=nullptr);
     MeshCombiner::Mesh *combineComponentChildGroupMesh(const std::vector<QString> &componentIdStrings,
-        GeneratedComponent &componentCache);
+        GeneratedComponent &componentCache,
+        std::map<QString, std::pair<MeshCombiner::Mesh *, CombineMode>> &childMeshes);
     MeshCombiner::Mesh *combineMultipleMeshes(const std::vector<std::tuple<MeshCombiner::Mesh *, CombineMode, QString>> &multipleMeshes, bool recombine=true);
+    struct CombinationOperand
+    {
+        MeshCombiner::Mesh *mesh = nullptr;
+        QString idString;
+        std::set<QString> componentIds;
+    };
+    void combineCachedOperands(CombinationOperand *first, CombinationOperand *second,
+        MeshCombiner::Method method, bool recombine, const QString &combinationKey);
+    CombinationOperand reduceUnionOperands(std::vector<CombinationOperand> &operands, bool recombine);
     QString componentColorName(const std::map<QString, QString> *component);
     ComponentLayer componentLayer(const std::map<QString, QString> *component);
     float componentClothStiffness(const std::map<QString, QString> *component);
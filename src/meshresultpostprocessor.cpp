@@ -2,6 +2,7 @@
 #include "meshresultpostprocessor.h"
 #include "uvunwrap.h"
 #include "triangletangentresolve.h"
+#include "profiler.h"
 
 MeshResultPostProcessor::MeshResultPostProcessor(const Outcome &outcome)
 {
@@ -9,6 +10,11 @@ MeshResultPostProcessor::MeshResultPostProcessor(const Outcome &outcome)
     *m_outcome = outcome;
 }
 
+MeshResultPostProcessor::MeshResultPostProcessor(const std::shared_ptr<const Outcome> &outcome) :
+    m_sourceOutcome(outcome)
+{
+}
+
 MeshResultPostProcessor::~MeshResultPostProcessor()
 {
     delete m_outcome;
@@ -23,11 +29,17 @@ Outcome *MeshResultPostProcessor::takePostProcessedOutcome()
 
 void MeshResultPostProcessor::poseProcess()
 {
+    // A shared outcome is copied here, on the worker thread, the source stays untouched for the other stages
+    if (nullptr == m_outcome && nullptr != m_sourceOutcome) {
+        m_outcome = new Outcome(*m_sourceOutcome);
+        m_sourceOutcome.reset();
+    }
 #ifndef NDEBUG
     return;
 #endif
     if (!m_outcome->nodes.empty()) {
         {
+            Profiler::Scope profile("uvUnwrap", "post");
             std::vector<std::vector<QVector2D>> triangleVertexUvs;
             std::set<int> seamVertices;
             std::map<QUuid, std::vector<QRectF>> partUvRects;
@@ -37,6 +49,7 @@ void MeshResultPostProcessor::poseProcess()
         }
         
         {
+            Profiler::Scope profile("tangents", "post");
             std::vector<QVector3D> triangleTangents;
             triangleTangentResolve(*m_outcome, triangleTangents);
             m_outcome->setTriangleTangents(triangleTangents);
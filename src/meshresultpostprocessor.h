@@ -1,6 +1,7 @@
 #ifndef DUST3D_MESH_RESULT_POST_PROCESSOR_H
 #define DUST3D_MESH_RESULT_POST_PROCESSOR_H
 #include <QObject>
+#include <memory>
 #include "outcome.h"
 
 class MeshResultPostProcessor : public QObject
@@ -8,6 +9,7 @@ class MeshResultPostProcessor : public QObject
     Q_OBJECT
 public:
     MeshResultPostProcessor(const Outcome &outcome);
+    MeshResultPostProcessor(const std::shared_ptr<const Outcome> &outcome);
     ~MeshResultPostProcessor();
     Outcome *takePostProcessedOutcome();
     void poseProcess();
@@ -17,6 +19,7 @@ public slots:
     void process();
 private:
     Outcome *m_outcome = nullptr;
+    std::shared_ptr<const Outcome> m_sourceOutcome;
 };
 
 #endif
@@ -0,0 +1,673 @@
+#include <QElapsedTimer>
+#include <QVector3D>
+#include <random>
+#include <map>
+#include <functional>
+#include <cmath>
+#include <algorithm>
+#include <unordered_set>
+#include <unordered_map>
+#include <QXmlStreamReader>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QBuffer>
+#include <QXmlStreamWriter>
+#include <QUuid>
+#include <QImage>
+#include <QMatrix4x4>
+#include <cstring>
+#include "microbenchmark.h"
+#include "projectfacestonodes.h"
+#include "triangletopology.h"
+#include "util.h"
+#include "ds3file.h"
+#include "snapshot.h"
+#include "snapshotxml.h"
+#include "meshgenerator.h"
+#include "skinnedmeshcreator.h"
+#include "rigger.h"
+
+typedef std::function<void (MicroBenchmark::Result *)> MicroBenchmarkFunction;
+
+static void benchmarkProjectFacesToNodes(MicroBenchmark::Result *result)
+{
+    // Interpolated nodes along a coil, with a high poly remeshed surface around them
+    std::mt19937 randomEngine(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<std::pair<QVector3D, float>> sourceNodes;
+    const size_t nodeCount = 1500;
+    for (size_t i = 0; i < nodeCount; ++i) {
+        float t = (float)i / nodeCount * 40.0f;
+        float radius = 0.02f + 0.01f * std::sin(t * 3.0f);
+        sourceNodes.push_back({QVector3D(std::cos(t) * 0.5f, t * 0.02f - 0.4f, std::sin(t) * 0.5f), radius});
+    }
+    std::vector<QVector3D> vertices;
+    std::vector<std::vector<size_t>> faces;
+    const size_t facesPerNode = 30;
+    for (const auto &node: sourceNodes) {
+        for (size_t i = 0; i < facesPerNode; ++i) {
+            QVector3D direction = QVector3D(unit(randomEngine), unit(randomEngine), unit(randomEngine)).normalized();
+            QVector3D center = node.first + direction * node.second;
+            QVector3D tangent = QVector3D::crossProduct(direction, QVector3D(0, 1, 0)).normalized() * node.second * 0.2f;
+            QVector3D bitangent = QVector3D::crossProduct(direction, tangent).normalized() * node.second * 0.2f;
+            size_t first = vertices.size();
+            vertices.push_back(center - tangent);
+            vertices.push_back(center + bitangent);
+            vertices.push_back(center + tangent);
+            faces.push_back({first, first + 1, first + 2});
+        }
+    }
+
+    std::vector<size_t> referenceSources;
+    std::vector<size_t> optimizedSources;
+    QElapsedTimer timer;
+    timer.start();
+    projectFacesToNodesBruteForce(vertices, faces, sourceNodes, &referenceSources);
+    result->referenceMilliseconds = timer.restart();
+    projectFacesToNodes(vertices, faces, sourceNodes, &optimizedSources);
+    result->optimizedMilliseconds = timer.elapsed();
+    result->identical = referenceSources == optimizedSources;
+}
+
+// The std::map based implementations which TriangleTopology replaced, kept here as the reference
+static void referenceAngleSmooth(const std::vector<QVector3D> &vertices,
+    const std::vector<std::vector<size_t>> &triangles,
+    const std::vector<QVector3D> &triangleNormals,
+    float thresholdAngleDegrees,
+    std::vector<QVector3D> &triangleVertexNormals)
+{
+    std::vector<std::vector<std::pair<size_t, size_t>>> triangleVertexNormalsMapByIndices(vertices.size());
+    std::vector<QVector3D> angleAreaWeightedNormals;
+    for (size_t triangleIndex = 0; triangleIndex < triangles.size(); ++triangleIndex) {
+        const auto &sourceTriangle = triangles[triangleIndex];
+        if (sourceTriangle.size() != 3) {
+            qDebug() << "Encounter non triangle";
+            continue;
+        }
+        const auto &v1 = vertices[sourceTriangle[0]];
+        const auto &v2 = vertices[sourceTriangle[1]];
+        const auto &v3 = vertices[sourceTriangle[2]];
+        float area = areaOfTriangle(v1, v2, v3);
+        float angles[] = {degreesBetweenVectors(v2-v1, v3-v1),
+            degreesBetweenVectors(v1-v2, v3-v2),
+            degreesBetweenVectors(v1-v3, v2-v3)};
+        for (int i = 0; i < 3; ++i) {
+            if (sourceTriangle[i] >= vertices.size()) {
+                qDebug() << "Invalid vertex index" << sourceTriangle[i] << "vertices size" << vertices.size();
+                continue;
+            }
+            triangleVertexNormalsMapByIndices[sourceTriangle[i]].push_back({triangleIndex, angleAreaWeightedNormals.size()});
+            angleAreaWeightedNormals.push_back(triangleNormals[triangleIndex] * area * angles[i]);
+        }
+    }
+    triangleVertexNormals = angleAreaWeightedNormals;
+    std::map<std::pair<size_t, size_t>, float> degreesBetweenFacesMap;
+    for (size_t vertexIndex = 0; vertexIndex < vertices.size(); ++vertexIndex) {
+        const auto &triangleVertices = triangleVertexNormalsMapByIndices[vertexIndex];
+        for (const auto &triangleVertex: triangleVertices) {
+            for (const auto &otherTriangleVertex: triangleVertices) {
+                if (triangleVertex.first == otherTriangleVertex.first)
+                    continue;
+                float degrees = 0;
+                auto findDegreesResult = degreesBetweenFacesMap.find({triangleVertex.first, otherTriangleVertex.first});
+                if (findDegreesResult == degreesBetweenFacesMap.end()) {
+                    degrees = degreesBetweenVectors(triangleNormals[triangleVertex.first], triangleNormals[otherTriangleVertex.first]);
+                    degreesBetweenFacesMap.insert({{triangleVertex.first, otherTriangleVertex.first}, degrees});
+                    degreesBetweenFacesMap.insert({{otherTriangleVertex.first, triangleVertex.first}, degrees});
+                } else {
+                    degrees = findDegreesResult->second;
+                }
+                if (degrees > thresholdAngleDegrees) {
+                    continue;
+                }
+                triangleVertexNormals[triangleVertex.second] += angleAreaWeightedNormals[otherTriangleVertex.second];
+            }
+        }
+    }
+    for (auto &item: triangleVertexNormals)
+        item.normalize();
+}
+
+static void referenceRecoverQuads(const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &triangles, const std::set<std::pair<PositionKey, PositionKey>> &sharedQuadEdges, std::vector<std::vector<size_t>> &triangleAndQuads)
+{
+    std::vector<PositionKey> verticesPositionKeys;
+    for (const auto &position: vertices) {
+        verticesPositionKeys.push_back(PositionKey(position));
+    }
+    std::map<std::pair<size_t, size_t>, std::pair<size_t, size_t>> triangleEdgeMap;
+    for (size_t i = 0; i < triangles.size(); i++) {
+        const auto &faceIndices = triangles[i];
+        if (faceIndices.size() == 3) {
+            triangleEdgeMap[std::make_pair(faceIndices[0], faceIndices[1])] = std::make_pair(i, faceIndices[2]);
+            triangleEdgeMap[std::make_pair(faceIndices[1], faceIndices[2])] = std::make_pair(i, faceIndices[0]);
+            triangleEdgeMap[std::make_pair(faceIndices[2], faceIndices[0])] = std::make_pair(i, faceIndices[1]);
+        }
+    }
+    std::unordered_set<size_t> unionedFaces;
+    std::vector<std::vector<size_t>> newUnionedFaceIndices;
+    for (const auto &edge: triangleEdgeMap) {
+        if (unionedFaces.find(edge.second.first) != unionedFaces.end())
+            continue;
+        auto pair = std::make_pair(verticesPositionKeys[edge.first.first], verticesPositionKeys[edge.first.second]);
+        if (sharedQuadEdges.find(pair) != sharedQuadEdges.end()) {
+            auto oppositeEdge = triangleEdgeMap.find(std::make_pair(edge.first.second, edge.first.first));
+            if (oppositeEdge == triangleEdgeMap.end()) {
+                qDebug() << "Find opposite edge failed";
+            } else {
+                if (unionedFaces.find(oppositeEdge->second.first) == unionedFaces.end()) {
+                    unionedFaces.insert(edge.second.first);
+                    unionedFaces.insert(oppositeEdge->second.first);
+                    std::vector<size_t> indices;
+                    indices.push_back(edge.second.second);
+                    indices.push_back(edge.first.first);
+                    indices.push_back(oppositeEdge->second.second);
+                    indices.push_back(edge.first.second);
+                    triangleAndQuads.push_back(indices);
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < triangles.size(); i++) {
+        if (unionedFaces.find(i) == unionedFaces.end()) {
+            triangleAndQuads.push_back(triangles[i]);
+        }
+    }
+}
+
+static size_t referenceWeldSeam(const std::vector<QVector3D> &sourceVertices, const std::vector<std::vector<size_t>> &sourceTriangles,
+    float allowedSmallestDistance, const std::set<PositionKey> &excludePositions,
+    std::vector<QVector3D> &destVertices, std::vector<std::vector<size_t>> &destTriangles)
+{
+    std::unordered_set<int> excludeVertices;
+    for (size_t i = 0; i < sourceVertices.size(); ++i) {
+        if (excludePositions.find(sourceVertices[i]) != excludePositions.end())
+            excludeVertices.insert(i);
+    }
+    float squareOfAllowedSmallestDistance = allowedSmallestDistance * allowedSmallestDistance;
+    std::map<int, int> weldVertexToMap;
+    std::unordered_set<int> weldTargetVertices;
+    std::unordered_set<int> processedFaces;
+    std::map<std::pair<int, int>, std::pair<int, int>> triangleEdgeMap;
+    std::unordered_map<int, int> vertexAdjFaceCountMap;
+    for (int i = 0; i < (int)sourceTriangles.size(); i++) {
+        const auto &faceIndices = sourceTriangles[i];
+        if (faceIndices.size() == 3) {
+            vertexAdjFaceCountMap[faceIndices[0]]++;
+            vertexAdjFaceCountMap[faceIndices[1]]++;
+            vertexAdjFaceCountMap[faceIndices[2]]++;
+            triangleEdgeMap[std::make_pair(faceIndices[0], faceIndices[1])] = std::make_pair(i, faceIndices[2]);
+            triangleEdgeMap[std::make_pair(faceIndices[1], faceIndices[2])] = std::make_pair(i, faceIndices[0]);
+            triangleEdgeMap[std::make_pair(faceIndices[2], faceIndices[0])] = std::make_pair(i, faceIndices[1]);
+        }
+    }
+    for (int i = 0; i < (int)sourceTriangles.size(); i++) {
+        if (processedFaces.find(i) != processedFaces.end())
+            continue;
+        const auto &faceIndices = sourceTriangles[i];
+        if (faceIndices.size() == 3) {
+            bool indicesSeamCheck[3] = {
+                excludeVertices.find(faceIndices[0]) == excludeVertices.end(),
+                excludeVertices.find(faceIndices[1]) == excludeVertices.end(),
+                excludeVertices.find(faceIndices[2]) == excludeVertices.end()
+            };
+            for (int j = 0; j < 3; j++) {
+                int next = (j + 1) % 3;
+                int nextNext = (j + 2) % 3;
+                if (indicesSeamCheck[j] && indicesSeamCheck[next]) {
+                    std::pair<int, int> edge = std::make_pair(faceIndices[j], faceIndices[next]);
+                    int thirdVertexIndex = faceIndices[nextNext];
+                    if ((sourceVertices[edge.first] - sourceVertices[edge.second]).lengthSquared() < squareOfAllowedSmallestDistance) {
+                        auto oppositeEdge = std::make_pair(edge.second, edge.first);
+                        auto findOppositeFace = triangleEdgeMap.find(oppositeEdge);
+                        if (findOppositeFace == triangleEdgeMap.end()) {
+                            qDebug() << "Find opposite edge failed";
+                            continue;
+                        }
+                        int oppositeFaceIndex = findOppositeFace->second.first;
+                        if (((sourceVertices[edge.first] - sourceVertices[thirdVertexIndex]).lengthSquared() <
+                                    (sourceVertices[edge.second] - sourceVertices[thirdVertexIndex]).lengthSquared()) &&
+                                vertexAdjFaceCountMap[edge.second] <= 4 &&
+                                weldVertexToMap.find(edge.second) == weldVertexToMap.end()) {
+                            weldVertexToMap[edge.second] = edge.first;
+                            weldTargetVertices.insert(edge.first);
+                            processedFaces.insert(i);
+                            processedFaces.insert(oppositeFaceIndex);
+                            break;
+                        } else if (vertexAdjFaceCountMap[edge.first] <= 4 &&
+                                weldVertexToMap.find(edge.first) == weldVertexToMap.end()) {
+                            weldVertexToMap[edge.first] = edge.second;
+                            weldTargetVertices.insert(edge.second);
+                            processedFaces.insert(i);
+                            processedFaces.insert(oppositeFaceIndex);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    int weldedCount = 0;
+    int faceCountAfterWeld = 0;
+    std::map<int, int> oldToNewVerticesMap;
+    for (int i = 0; i < (int)sourceTriangles.size(); i++) {
+        const auto &faceIndices = sourceTriangles[i];
+        std::vector<int> mappedFaceIndices;
+        bool errored = false;
+        for (const auto &index: faceIndices) {
+            int finalIndex = index;
+            int mapTimes = 0;
+            while (mapTimes < 500) {
+                auto findMapResult = weldVertexToMap.find(finalIndex);
+                if (findMapResult == weldVertexToMap.end())
+                    break;
+                finalIndex = findMapResult->second;
+                mapTimes++;
+            }
+            if (mapTimes >= 500) {
+                qDebug() << "Map too much times";
+                errored = true;
+                break;
+            }
+            mappedFaceIndices.push_back(finalIndex);
+        }
+        if (errored || mappedFaceIndices.size() < 3)
+            continue;
+        bool welded = false;
+        for (decltype(mappedFaceIndices.size()) j = 0; j < mappedFaceIndices.size(); j++) {
+            int next = (j + 1) % 3;
+            if (mappedFaceIndices[j] == mappedFaceIndices[next]) {
+                welded = true;
+                break;
+            }
+        }
+        if (welded) {
+            weldedCount++;
+            continue;
+        }
+        faceCountAfterWeld++;
+        std::vector<size_t> newFace;
+        for (const auto &index: mappedFaceIndices) {
+            auto findMap = oldToNewVerticesMap.find(index);
+            if (findMap == oldToNewVerticesMap.end()) {
+                size_t newIndex = destVertices.size();
+                newFace.push_back(newIndex);
+                destVertices.push_back(sourceVertices[index]);
+                oldToNewVerticesMap.insert({index, newIndex});
+            } else {
+                newFace.push_back(findMap->second);
+            }
+        }
+        destTriangles.push_back(newFace);
+    }
+    return weldedCount;
+}
+
+static Outcome *loadSampleModelOutcome(const QString &filename)
+{
+    Ds3FileReader ds3Reader(filename);
+    Snapshot snapshot;
+    bool hasModel = false;
+    for (int i = 0; i < ds3Reader.items().size(); ++i) {
+        const Ds3ReaderItem &item = ds3Reader.items().at(i);
+        if (item.type == "model") {
+            QByteArray data;
+            ds3Reader.loadItem(item.name, &data);
+            QXmlStreamReader stream(data);
+            loadSkeletonFromXmlStream(&snapshot, stream);
+            hasModel = true;
+        }
+    }
+    if (!hasModel)
+        return nullptr;
+    MeshGenerator *meshGenerator = new MeshGenerator(new Snapshot(snapshot));
+    meshGenerator->generate();
+    Outcome *outcome = meshGenerator->takeOutcome();
+    delete meshGenerator;
+    return outcome;
+}
+
+static bool loadSampleModelMesh(const QString &filename, std::vector<QVector3D> *vertices,
+    std::vector<std::vector<size_t>> *triangles, std::vector<std::vector<size_t>> *triangleAndQuads)
+{
+    Outcome *outcome = loadSampleModelOutcome(filename);
+    if (nullptr == outcome)
+        return false;
+    *vertices = outcome->vertices;
+    *triangles = outcome->triangles;
+    *triangleAndQuads = outcome->triangleAndQuads;
+    delete outcome;
+    return true;
+}
+
+static void benchmarkTopology(MicroBenchmark::Result *result)
+{
+    static const char *s_sampleModels[] = {
+        ":/resources/model-addax.ds3",
+        ":/resources/model-bicycle.ds3",
+        ":/resources/model-cat.ds3",
+        ":/resources/model-dog.ds3",
+        ":/resources/model-giraffe.ds3",
+        ":/resources/model-meerkat.ds3",
+        ":/resources/model-mosquito.ds3",
+        ":/resources/model-procedural-tree.ds3",
+        ":/resources/model-seagull.ds3",
+    };
+    const int repeatTimes = 10;
+    result->identical = true;
+    for (const auto &filename: s_sampleModels) {
+        std::vector<QVector3D> vertices;
+        std::vector<std::vector<size_t>> triangles;
+        std::vector<std::vector<size_t>> triangleAndQuads;
+        if (!loadSampleModelMesh(filename, &vertices, &triangles, &triangleAndQuads)) {
+            qDebug() << "Load sample model failed:" << filename;
+            result->identical = false;
+            continue;
+        }
+        std::vector<QVector3D> triangleNormals;
+        for (const auto &triangle: triangles)
+            triangleNormals.push_back(QVector3D::normal(vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]]));
+        // Quads of the generated mesh come from these diagonals, so recovering them again is a realistic workload
+        std::set<std::pair<PositionKey, PositionKey>> sharedQuadEdges;
+        for (const auto &face: triangleAndQuads) {
+            if (4 != face.size())
+                continue;
+            sharedQuadEdges.insert({PositionKey(vertices[face[1]]), PositionKey(vertices[face[3]])});
+            sharedQuadEdges.insert({PositionKey(vertices[face[3]]), PositionKey(vertices[face[1]])});
+        }
+        std::set<PositionKey> excludePositions;
+
+        std::vector<QVector3D> referenceWeldedVertices;
+        std::vector<std::vector<size_t>> referenceWeldedTriangles;
+        std::vector<std::vector<size_t>> referenceQuads;
+        std::vector<QVector3D> referenceNormals;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < repeatTimes; ++i) {
+            referenceWeldedVertices.clear();
+            referenceWeldedTriangles.clear();
+            referenceQuads.clear();
+            referenceWeldSeam(vertices, triangles, 0.025, excludePositions,
+                referenceWeldedVertices, referenceWeldedTriangles);
+            referenceRecoverQuads(vertices, triangles, sharedQuadEdges, referenceQuads);
+            referenceAngleSmooth(vertices, triangles, triangleNormals, 60, referenceNormals);
+        }
+        result->referenceMilliseconds += timer.restart();
+
+        std::vector<QVector3D> weldedVertices;
+        std::vector<std::vector<size_t>> weldedTriangles;
+        std::vector<std::vector<size_t>> quads;
+        std::vector<QVector3D> normals;
+        for (int i = 0; i < repeatTimes; ++i) {
+            weldedVertices.clear();
+            weldedTriangles.clear();
+            quads.clear();
+            TriangleTopology topology(triangles, vertices.size());
+            weldSeam(vertices, triangles, topology, 0.025, excludePositions,
+                weldedVertices, weldedTriangles);
+            recoverQuads(vertices, triangles, topology, sharedQuadEdges, quads);
+            angleSmooth(vertices, triangles, topology, triangleNormals, 60, normals);
+        }
+        result->optimizedMilliseconds += timer.elapsed();
+
+        if (referenceWeldedVertices != weldedVertices ||
+                referenceWeldedTriangles != weldedTriangles ||
+                referenceQuads != quads ||
+                referenceNormals != normals) {
+            qDebug() << "Topology results differ on" << filename;
+            result->identical = false;
+        }
+    }
+}
+
+// Ds3FileWriter::save() before items were streamed, every item is already in memory
+static bool referenceSaveDs3(const QString &filename, const std::vector<std::pair<QString, QByteArray>> &items)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QByteArray headerXml;
+    {
+        QXmlStreamWriter stream(&headerXml);
+        stream.setAutoFormatting(true);
+        stream.writeStartDocument();
+        stream.writeStartElement("ds3");
+        long long offset = 0;
+        for (const auto &item: items) {
+            stream.writeStartElement("asset");
+                stream.writeAttribute("name", item.first);
+                stream.writeAttribute("offset", QString("%1").arg(offset));
+                stream.writeAttribute("size", QString("%1").arg(item.second.size()));
+                offset += item.second.size();
+            stream.writeEndElement();
+        }
+        stream.writeEndElement();
+        stream.writeEndDocument();
+    }
+    char firstLine[1024];
+    int firstLineSizeExcludeSizeSelf = sprintf(firstLine, "%s %s %s ",
+        Ds3FileReader::m_applicationName.toUtf8().constData(),
+        Ds3FileReader::m_fileFormatVersion.toUtf8().constData(),
+        Ds3FileReader::m_headFormat.toUtf8().constData());
+    unsigned int headerSize = firstLineSizeExcludeSizeSelf + 12 + headerXml.size();
+    char headerSizeString[100] = {0};
+    sprintf(headerSizeString, "%010u\r\n", headerSize);
+    file.write(firstLine, firstLineSizeExcludeSizeSelf);
+    file.write(headerSizeString, strlen(headerSizeString));
+    file.write(headerXml);
+    for (const auto &item: items)
+        file.write(item.second);
+    return true;
+}
+
+// Reading item by item through QFile and decoding one image after another, as opening a document used to do
+static void referenceLoadDs3Images(const QString &filename, std::map<QUuid, QImage> *images)
+{
+    Ds3FileReader ds3Reader(filename);
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    long long binaryOffset = QString::fromUtf8(file.readLine()).split(" ")[3].toLongLong();
+    for (const auto &item: ds3Reader.items()) {
+        if (!item.name.startsWith("images/"))
+            continue;
+        if (!file.seek(binaryOffset + item.offset))
+            continue;
+        QByteArray data = file.read(item.size);
+        QUuid imageId = QUuid(item.name.split("/")[1].split(".")[0]);
+        (*images)[imageId] = QImage::fromData(data, "PNG");
+    }
+}
+
+static void benchmarkDs3File(MicroBenchmark::Result *result)
+{
+    // Noise does not compress, a few distinct 2048x2048 images repeated under different ids make up a ~500 MB document
+    const int distinctImageCount = 8;
+    const int itemCount = 32;
+    std::mt19937 randomEngine(1);
+    std::vector<QByteArray> pngByteArrays(distinctImageCount);
+    for (int i = 0; i < distinctImageCount; ++i) {
+        QImage image(2048, 2048, QImage::Format_ARGB32);
+        for (int row = 0; row < image.height(); ++row) {
+            QRgb *line = (QRgb *)image.scanLine(row);
+            for (int col = 0; col < image.width(); ++col)
+                line[col] = randomEngine();
+        }
+        QBuffer buffer(&pngByteArrays[i]);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "PNG");
+    }
+    std::vector<std::pair<QString, QByteArray>> items;
+    for (int i = 0; i < itemCount; ++i) {
+        QUuid imageId = QUuid(i + 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        items.push_back({"images/" + imageId.toString() + ".png", pngByteArrays[i % distinctImageCount]});
+    }
+    
+    QString referenceFilename = QDir::temp().filePath("dust3d-benchmark-reference.ds3");
+    QString optimizedFilename = QDir::temp().filePath("dust3d-benchmark-optimized.ds3");
+    std::map<QUuid, QImage> referenceImages;
+    std::map<QUuid, QImage> optimizedImages;
+    
+    QElapsedTimer timer;
+    timer.start();
+    bool referenceSaved = referenceSaveDs3(referenceFilename, items);
+    referenceLoadDs3Images(referenceFilename, &referenceImages);
+    result->referenceMilliseconds = timer.restart();
+    
+    Ds3FileWriter ds3Writer;
+    for (const auto &item: items) {
+        const QByteArray *byteArray = &item.second;
+        ds3Writer.add(item.first, "asset", [=]() {
+            return *byteArray;
+        });
+    }
+    bool optimizedSaved = ds3Writer.save(optimizedFilename);
+    {
+        Ds3FileReader ds3Reader(optimizedFilename);
+        ds3Reader.loadImages(&optimizedImages);
+    }
+    result->optimizedMilliseconds = timer.elapsed();
+    
+    result->identical = referenceSaved && optimizedSaved &&
+        referenceImages.size() == items.size() &&
+        referenceImages == optimizedImages;
+    if (result->identical) {
+        Ds3FileReader referenceReader(referenceFilename);
+        Ds3FileReader optimizedReader(optimizedFilename);
+        for (const auto &item: items) {
+            if (referenceReader.itemView(item.first) != optimizedReader.itemView(item.first)) {
+                result->identical = false;
+                break;
+            }
+        }
+    }
+    
+    QFile::remove(referenceFilename);
+    QFile::remove(optimizedFilename);
+}
+
+// Skins every triangle corner with the generic matrix operators, as SkinnedMeshCreator did.
+// Normals are mapped as directions here, the kernel no longer translates them.
+static void referenceSkin(const Outcome &outcome, std::map<int, RiggerVertexWeights> &weights,
+    const std::vector<QMatrix4x4> &matricies, std::vector<QVector3D> *positions, std::vector<QVector3D> *normals)
+{
+    const std::vector<std::vector<QVector3D>> *triangleVertexNormals = outcome.triangleVertexNormals();
+    positions->resize(outcome.triangles.size() * 3);
+    normals->resize(outcome.triangles.size() * 3);
+    for (size_t i = 0; i < outcome.triangles.size(); ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            const auto &weight = weights[outcome.triangles[i][j]];
+            const auto &bindPosition = outcome.vertices[outcome.triangles[i][j]];
+            QVector3D bindNormal = nullptr != triangleVertexNormals ? (*triangleVertexNormals)[i][j] : QVector3D();
+            QVector3D &position = (*positions)[i * 3 + j];
+            QVector3D &normal = (*normals)[i * 3 + j];
+            position = QVector3D();
+            normal = QVector3D();
+            for (int x = 0; x < 4; x++) {
+                float factor = weight.boneWeights[x];
+                if (factor > 0) {
+                    position += matricies[weight.boneIndices[x]] * bindPosition * factor;
+                    normal += matricies[weight.boneIndices[x]].mapVector(bindNormal) * factor;
+                }
+            }
+        }
+    }
+}
+
+static void benchmarkSkinning(MicroBenchmark::Result *result)
+{
+    Outcome *outcome = loadSampleModelOutcome(":/resources/model-dog.ds3");
+    if (nullptr == outcome) {
+        qDebug() << "Load sample model failed";
+        return;
+    }
+    const int boneCount = 32;
+    const int frameCount = 60;
+    std::mt19937 randomEngine(0);
+    std::uniform_int_distribution<int> boneDistribution(0, boneCount - 1);
+    std::uniform_real_distribution<float> realDistribution(0.0f, 1.0f);
+    std::map<int, RiggerVertexWeights> weights;
+    for (size_t i = 0; i < outcome->vertices.size(); ++i) {
+        RiggerVertexWeights &vertexWeights = weights[i];
+        for (int k = 0; k < 4; ++k)
+            vertexWeights.addBone(boneDistribution(randomEngine), realDistribution(randomEngine) + 0.01f);
+        vertexWeights.finalizeWeights();
+    }
+    std::vector<std::vector<QMatrix4x4>> frames(frameCount);
+    for (auto &matricies: frames) {
+        matricies.resize(boneCount);
+        for (auto &matrix: matricies) {
+            matrix.translate(realDistribution(randomEngine), realDistribution(randomEngine), realDistribution(randomEngine));
+            matrix.rotate(realDistribution(randomEngine) * 360, realDistribution(randomEngine), realDistribution(randomEngine), 1.0);
+        }
+    }
+
+    std::vector<std::vector<QVector3D>> referencePositions(frameCount);
+    std::vector<std::vector<QVector3D>> referenceNormals(frameCount);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frameCount; ++i)
+        referenceSkin(*outcome, weights, frames[i], &referencePositions[i], &referenceNormals[i]);
+    result->referenceMilliseconds = timer.restart();
+
+    std::vector<MeshLoader *> meshes(frameCount);
+    SkinnedMeshCreator skinnedMeshCreator(*outcome, weights);
+    for (int i = 0; i < frameCount; ++i)
+        meshes[i] = skinnedMeshCreator.createMeshFromTransform(frames[i]);
+    result->optimizedMilliseconds = timer.elapsed();
+    result->details = QString("frames/s reference=%1 optimized=%2")
+        .arg(frameCount * 1000.0 / std::max(result->referenceMilliseconds, (qint64)1), 0, 'f', 1)
+        .arg(frameCount * 1000.0 / std::max(result->optimizedMilliseconds, (qint64)1), 0, 'f', 1);
+
+    // The blended matrix is applied instead of summing up transformed points, so only rounding differs
+    result->identical = true;
+    for (int i = 0; i < frameCount && result->identical; ++i) {
+        const ShaderVertex *vertices = meshes[i]->triangleVertices();
+        if ((size_t)meshes[i]->triangleVertexCount() != referencePositions[i].size()) {
+            result->identical = false;
+            break;
+        }
+        for (size_t j = 0; j < referencePositions[i].size(); ++j) {
+            QVector3D position(vertices[j].posX, vertices[j].posY, vertices[j].posZ);
+            QVector3D normal(vertices[j].normX, vertices[j].normY, vertices[j].normZ);
+            if ((position - referencePositions[i][j]).length() > 1e-4 ||
+                    (normal - referenceNormals[i][j]).length() > 1e-4) {
+                qDebug() << "Skinning results differ on frame" << i << "vertex" << j;
+                result->identical = false;
+                break;
+            }
+        }
+    }
+    for (auto &mesh: meshes)
+        delete mesh;
+    delete outcome;
+}
+
+static const std::map<QString, MicroBenchmarkFunction> &microBenchmarks()
+{
+    static const std::map<QString, MicroBenchmarkFunction> s_benchmarks = {
+        {"ds3file", benchmarkDs3File},
+        {"projectfacestonodes", benchmarkProjectFacesToNodes},
+        {"skinning", benchmarkSkinning},
+        {"topology", benchmarkTopology},
+    };
+    return s_benchmarks;
+}
+
+QStringList MicroBenchmark::names()
+{
+    QStringList names;
+    for (const auto &it: microBenchmarks())
+        names.append(it.first);
+    return names;
+}
+
+bool MicroBenchmark::run(const QString &name, Result *result)
+{
+    auto findBenchmark = microBenchmarks().find(name);
+    if (findBenchmark == microBenchmarks().end())
+        return false;
+    result->name = name;
+    findBenchmark->second(result);
+    return true;
+}
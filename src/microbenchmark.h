@@ -0,0 +1,24 @@
+#ifndef DUST3D_MICRO_BENCHMARK_H
+#define DUST3D_MICRO_BENCHMARK_H
+#include <QString>
+#include <QStringList>
+#include <vector>
+
+// Compares an optimized kernel against its reference implementation on synthetic input or the bundled sample models
+class MicroBenchmark
+{
+public:
+    struct Result
+    {
+        QString name;
+        qint64 referenceMilliseconds = 0;
+        qint64 optimizedMilliseconds = 0;
+        bool identical = false;
+        QString details;
+    };
+
+    static QStringList names();
+    static bool run(const QString &name, Result *result);
+};
+
+#endif
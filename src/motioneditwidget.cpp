@@ -290,8 +290,7 @@ void MotionEditWidget::generatePreviews()
 
 void MotionEditWidget::previewsReady()
 {
-    auto resultPreviewMeshs = m_previewsGenerator->takeResultPreviewMeshs(QUuid());
-    m_clipPlayer->updateFrameMeshes(resultPreviewMeshs);
+    m_clipPlayer->updateFrameTrack(m_previewsGenerator->takeResultFrameTrack(QUuid()));
 
     delete m_previewsGenerator;
     m_previewsGenerator = nullptr;
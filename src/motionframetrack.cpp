@@ -0,0 +1,49 @@
+#include "motionframetrack.h"
+
+MotionFrameTrack::MotionFrameTrack(std::shared_ptr<const SkinnedMeshCreator> skinnedMeshCreator) :
+    m_skinnedMeshCreator(skinnedMeshCreator)
+{
+}
+
+void MotionFrameTrack::addFrame(float duration, const JointNodeTree &jointNodeTree)
+{
+    Frame frame;
+    frame.duration = duration;
+    const auto &nodes = jointNodeTree.nodes();
+    frame.matrices.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+        frame.matrices[i] = nodes[i].transformMatrix;
+    m_frames.push_back(frame);
+}
+
+void MotionFrameTrack::setFrameEdges(size_t frame, const ShaderVertex *edgeVertices, int edgeVertexCount)
+{
+    if (frame >= m_frames.size())
+        return;
+    m_frames[frame].edgeVertices.assign(edgeVertices, edgeVertices + edgeVertexCount);
+}
+
+size_t MotionFrameTrack::frameCount() const
+{
+    return m_frames.size();
+}
+
+float MotionFrameTrack::frameDuration(size_t frame) const
+{
+    return m_frames[frame].duration;
+}
+
+MeshLoader *MotionFrameTrack::createFrameMesh(size_t frame) const
+{
+    if (frame >= m_frames.size())
+        return nullptr;
+    const auto &source = m_frames[frame];
+    MeshLoader *mesh = m_skinnedMeshCreator->createMeshFromTransform(source.matrices);
+    if (!source.edgeVertices.empty()) {
+        ShaderVertex *edgeVertices = new ShaderVertex[source.edgeVertices.size()];
+        for (size_t i = 0; i < source.edgeVertices.size(); ++i)
+            edgeVertices[i] = source.edgeVertices[i];
+        mesh->updateEdges(edgeVertices, (int)source.edgeVertices.size());
+    }
+    return mesh;
+}
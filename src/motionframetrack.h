@@ -0,0 +1,32 @@
+#ifndef DUST3D_MOTION_FRAME_TRACK_H
+#define DUST3D_MOTION_FRAME_TRACK_H
+#include <QMatrix4x4>
+#include <vector>
+#include <memory>
+#include "meshloader.h"
+#include "jointnodetree.h"
+#include "skinnedmeshcreator.h"
+
+// Per frame joint matrices of a generated motion, the skinned mesh of a frame
+// is only created when the frame is going to be shown.
+class MotionFrameTrack
+{
+public:
+    MotionFrameTrack(std::shared_ptr<const SkinnedMeshCreator> skinnedMeshCreator);
+    void addFrame(float duration, const JointNodeTree &jointNodeTree);
+    void setFrameEdges(size_t frame, const ShaderVertex *edgeVertices, int edgeVertexCount);
+    size_t frameCount() const;
+    float frameDuration(size_t frame) const;
+    MeshLoader *createFrameMesh(size_t frame) const;
+private:
+    struct Frame
+    {
+        float duration = 0;
+        std::vector<QMatrix4x4> matrices;
+        std::vector<ShaderVertex> edgeVertices;
+    };
+    std::shared_ptr<const SkinnedMeshCreator> m_skinnedMeshCreator;
+    std::vector<Frame> m_frames;
+};
+
+#endif
@@ -2,11 +2,13 @@
 #include <QElapsedTimer>
 #include <cmath>
 #include "motionsgenerator.h"
-#include "posemeshcreator.h"
+#include "skinnedmeshcreator.h"
+#include "motionframetrack.h"
 #include "poserconstruct.h"
 #include "posedocument.h"
 #include "ragdoll.h"
 #include "boundingboxmesh.h"
+#include "profiler.h"
 
 MotionsGenerator::MotionsGenerator(RigType rigType,
         const std::vector<RiggerBone> *rigBones,
@@ -21,11 +23,8 @@ MotionsGenerator::MotionsGenerator(RigType rigType,
 
 MotionsGenerator::~MotionsGenerator()
 {
-    for (auto &item: m_resultPreviewMeshs) {
-        for (auto &subItem: item.second) {
-            delete subItem.second;
-        }
-    }
+    for (auto &item: m_resultFrameTracks)
+        delete item.second;
 #if ENABLE_PROCEDURAL_DEBUG
     for (const auto &item: m_proceduralDebugPreviews) {
         for (const auto &subItem: item.second) {
@@ -80,14 +79,15 @@ std::vector<std::pair<std::map<QString, QString>, std::map<QString, std::map<QSt
     return &frames;
 }
 
-void MotionsGenerator::generatePreviewsForOutcomes(const std::vector<std::pair<float, JointNodeTree>> &outcomes, std::vector<std::pair<float, MeshLoader *>> &previews)
+MotionFrameTrack *MotionsGenerator::createFrameTrack(const std::vector<std::pair<float, JointNodeTree>> &outcomes)
 {
-    for (const auto &item: outcomes) {
-        PoseMeshCreator *poseMeshCreator = new PoseMeshCreator(item.second.nodes(), m_outcome, m_rigWeights);
-        poseMeshCreator->createMesh();
-        previews.push_back({item.first, poseMeshCreator->takeResultMesh()});
-        delete poseMeshCreator;
-    }
+    // Bind pose vertices and weights are prepared once and shared by all the frames
+    if (nullptr == m_skinnedMeshCreator)
+        m_skinnedMeshCreator = std::make_shared<SkinnedMeshCreator>(m_outcome, m_rigWeights);
+    MotionFrameTrack *frameTrack = new MotionFrameTrack(m_skinnedMeshCreator);
+    for (const auto &item: outcomes)
+        frameTrack->addFrame(item.first, item.second);
+    return frameTrack;
 }
 
 float MotionsGenerator::calculatePoseDuration(const QUuid &poseId)
@@ -386,14 +386,14 @@ const JointNodeTree *MotionsGenerator::findClipEndJointNodeTree(const MotionClip
     return nullptr;
 }
 
-std::vector<std::pair<float, MeshLoader *>> MotionsGenerator::takeResultPreviewMeshs(const QUuid &motionId)
+MotionFrameTrack *MotionsGenerator::takeResultFrameTrack(const QUuid &motionId)
 {
-    auto findResult = m_resultPreviewMeshs.find(motionId);
-    if (findResult == m_resultPreviewMeshs.end())
-        return {};
-    auto result = findResult->second;
-    m_resultPreviewMeshs.erase(findResult);
-    return result;
+    auto findResult = m_resultFrameTracks.find(motionId);
+    if (findResult == m_resultFrameTracks.end())
+        return nullptr;
+    MotionFrameTrack *frameTrack = findResult->second;
+    m_resultFrameTracks.erase(findResult);
+    return frameTrack;
 }
 
 std::vector<std::pair<float, JointNodeTree>> MotionsGenerator::takeResultJointNodeTrees(const QUuid &motionId)
@@ -418,25 +418,20 @@ void MotionsGenerator::generate()
 #else
         generateMotion(motionId, visited, m_resultJointNodeTrees[motionId]);
 #endif
-        generatePreviewsForOutcomes(m_resultJointNodeTrees[motionId], m_resultPreviewMeshs[motionId]);
+        MotionFrameTrack *frameTrack = createFrameTrack(m_resultJointNodeTrees[motionId]);
 #if ENABLE_PROCEDURAL_DEBUG
         if (!previews.empty()) {
             const auto &tree = m_resultJointNodeTrees[motionId];
-            auto &target = m_resultPreviewMeshs[motionId];
             for (size_t i = 0; i < tree.size() && i < previews.size(); ++i) {
                 int edgeVertexCount = previews[i]->edgeVertexCount();
                 if (0 == edgeVertexCount)
                     continue;
-                ShaderVertex *source = previews[i]->edgeVertices();
-                ShaderVertex *edgeVertices = new ShaderVertex[edgeVertexCount];
-                for (int j = 0; j < edgeVertexCount; ++j) {
-                    edgeVertices[j] = source[j];
-                }
-                target[i].second->updateEdges(edgeVertices, edgeVertexCount);
-                //target[i].second->updateTriangleVertices(nullptr, 0);
+                frameTrack->setFrameEdges(i, previews[i]->edgeVertices(), edgeVertexCount);
             }
         }
 #endif
+        delete m_resultFrameTracks[motionId];
+        m_resultFrameTracks[motionId] = frameTrack;
         m_generatedMotionIds.insert(motionId);
     }
 }
@@ -446,7 +441,10 @@ void MotionsGenerator::process()
     QElapsedTimer countTimeConsumed;
     countTimeConsumed.start();
     
-    generate();
+    {
+        Profiler::Scope profile("motions", "animation");
+        generate();
+    }
     
     qDebug() << "The motions generation took" << countTimeConsumed.elapsed() << "milliseconds";
     
@@ -4,6 +4,7 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <memory>
 #include "meshloader.h"
 #include "rigger.h"
 #include "jointnodetree.h"
@@ -12,6 +13,9 @@
 
 #define ENABLE_PROCEDURAL_DEBUG     1
 
+class SkinnedMeshCreator;
+class MotionFrameTrack;
+
 class MotionsGenerator : public QObject
 {
     Q_OBJECT
@@ -24,7 +28,7 @@ public:
     void addPoseToLibrary(const QUuid &poseId, const std::vector<std::pair<std::map<QString, QString>, std::map<QString, std::map<QString, QString>>>> &frames, float yTranslationScale);
     void addMotionToLibrary(const QUuid &motionId, const std::vector<MotionClip> &clips);
     void addRequirement(const QUuid &motionId);
-    std::vector<std::pair<float, MeshLoader *>> takeResultPreviewMeshs(const QUuid &motionId);
+    MotionFrameTrack *takeResultFrameTrack(const QUuid &motionId);
     std::vector<std::pair<float, JointNodeTree>> takeResultJointNodeTrees(const QUuid &motionId);
     const std::set<QUuid> &requiredMotionIds();
     const std::set<QUuid> &generatedMotionIds();
@@ -44,7 +48,7 @@ private:
     const JointNodeTree *findClipEndJointNodeTree(const MotionClip &clip);
     std::vector<MotionClip> *findMotionClips(const QUuid &motionId);
     std::vector<std::pair<std::map<QString, QString>, std::map<QString, std::map<QString, QString>>>> *findPoseFrames(const QUuid &poseId);
-    void generatePreviewsForOutcomes(const std::vector<std::pair<float, JointNodeTree>> &outcomes, std::vector<std::pair<float, MeshLoader *>> &previews);
+    MotionFrameTrack *createFrameTrack(const std::vector<std::pair<float, JointNodeTree>> &outcomes);
     float calculateMotionDuration(const QUuid &motionId, std::set<QUuid> &visited);
     float calculatePoseDuration(const QUuid &poseId);
     float calculateProceduralAnimationDuration(ProceduralAnimation proceduralAnimation,
@@ -65,10 +69,11 @@ private:
     std::map<QUuid, std::vector<MotionClip>> m_motions;
     std::set<QUuid> m_requiredMotionIds;
     std::set<QUuid> m_generatedMotionIds;
-    std::map<QUuid, std::vector<std::pair<float, MeshLoader *>>> m_resultPreviewMeshs;
+    std::map<QUuid, MotionFrameTrack *> m_resultFrameTracks;
     std::map<QUuid, std::vector<std::pair<float, JointNodeTree>>> m_resultJointNodeTrees;
     std::map<std::pair<QUuid, int>, JointNodeTree> m_poseJointNodeTreeMap;
     Poser *m_poser = nullptr;
+    std::shared_ptr<const SkinnedMeshCreator> m_skinnedMeshCreator;
     int m_fps = 30;
 };
 
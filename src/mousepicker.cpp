@@ -1,4 +1,5 @@
 #include <QDebug>
+#include <QGuiApplication>
 #include <QQuaternion>
 #include <QRadialGradient>
 #include <QBrush>
@@ -7,8 +8,8 @@
 #include "util.h"
 #include "imageforever.h"
 
-MousePicker::MousePicker(const Outcome &outcome, const QVector3D &mouseRayNear, const QVector3D &mouseRayFar) :
-    m_outcome(outcome),
+MousePicker::MousePicker(const std::shared_ptr<const MousePickIndex> &pickIndex, const QVector3D &mouseRayNear, const QVector3D &mouseRayFar) :
+    m_pickIndex(pickIndex),
     m_mouseRayNear(mouseRayNear),
     m_mouseRayFar(mouseRayFar)
 {
@@ -38,40 +39,9 @@ MousePicker::~MousePicker()
 {
 }
 
-bool MousePicker::calculateMouseModelPosition(QVector3D &mouseModelPosition)
-{
-    bool foundPosition = false;
-    auto ray = (m_mouseRayNear - m_mouseRayFar).normalized();
-    float minDistance2 = std::numeric_limits<float>::max();
-    for (size_t i = 0; i < m_outcome.triangles.size(); ++i) {
-        const auto &triangleIndices = m_outcome.triangles[i];
-        std::vector<QVector3D> triangle = {
-            m_outcome.vertices[triangleIndices[0]],
-            m_outcome.vertices[triangleIndices[1]],
-            m_outcome.vertices[triangleIndices[2]],
-        };
-        const auto &triangleNormal = m_outcome.triangleNormals[i];
-        if (QVector3D::dotProduct(triangleNormal, ray) <= 0)
-            continue;
-        QVector3D intersection;
-        if (intersectSegmentAndTriangle(m_mouseRayNear, m_mouseRayFar,
-                triangle,
-                triangleNormal,
-                &intersection)) {
-            float distance2 = (intersection - m_mouseRayNear).lengthSquared();
-            if (distance2 < minDistance2) {
-                mouseModelPosition = intersection;
-                minDistance2 = distance2;
-                foundPosition = true;
-            }
-        }
-    }
-    return foundPosition;
-}
-
 void MousePicker::pick()
 {
-    if (!calculateMouseModelPosition(m_targetPosition))
+    if (!m_pickIndex->intersectSegment(m_mouseRayNear, m_mouseRayFar, &m_targetPosition))
         return;
     
     if (PaintMode::None == m_paintMode)
@@ -79,35 +49,38 @@ void MousePicker::pick()
     
     float distance2 = m_radius * m_radius;
     
-    for (const auto &map: m_outcome.paintMaps) {
-        for (const auto &node: map.paintNodes) {
-            if (!m_mousePickMaskNodeIds.empty() && m_mousePickMaskNodeIds.find(node.originNodeId) == m_mousePickMaskNodeIds.end())
-                continue;
-            size_t intersectedNum = 0;
-            QVector3D sumOfDirection;
-            QVector3D referenceDirection = (m_targetPosition - node.origin).normalized();
-            float sumOfRadius = 0;
-            for (const auto &vertexPosition: node.vertices) {
-                // >0.866 = <30 degrees
-                auto direction = (vertexPosition - node.origin).normalized();
-                if (QVector3D::dotProduct(referenceDirection, direction) > 0.866 &&
-                        (vertexPosition - m_targetPosition).lengthSquared() <= distance2) {
-                    float distance = vertexPosition.distanceToPoint(m_targetPosition);
-                    float radius = (m_radius - distance) / node.radius;
-                    sumOfRadius += radius;
-                    sumOfDirection += direction * radius;
-                    ++intersectedNum;
-                }
-            }
-            if (intersectedNum > 0) {
-                float paintRadius = sumOfRadius / intersectedNum;
-                QVector3D paintDirection = sumOfDirection.normalized();
-                float degrees = angleInRangle360BetweenTwoVectors(node.baseNormal, paintDirection, node.direction);
-                float offset = (float)node.order / map.paintNodes.size();
-                m_changedPartIds.insert(map.partId);
-                paintToImage(map.partId, offset, degrees / 360.0, paintRadius, PaintMode::Push == m_paintMode);
+    const auto &paintMaps = m_pickIndex->paintMaps();
+    std::vector<std::pair<size_t, size_t>> paintNodeIndices;
+    m_pickIndex->findPaintNodes(m_targetPosition, m_radius, &paintNodeIndices);
+    for (const auto &paintNodeIndex: paintNodeIndices) {
+        const auto &map = paintMaps[paintNodeIndex.first];
+        const auto &node = map.paintNodes[paintNodeIndex.second];
+        if (!m_mousePickMaskNodeIds.empty() && m_mousePickMaskNodeIds.find(node.originNodeId) == m_mousePickMaskNodeIds.end())
+            continue;
+        size_t intersectedNum = 0;
+        QVector3D sumOfDirection;
+        QVector3D referenceDirection = (m_targetPosition - node.origin).normalized();
+        float sumOfRadius = 0;
+        for (const auto &vertexPosition: node.vertices) {
+            // >0.866 = <30 degrees
+            auto direction = (vertexPosition - node.origin).normalized();
+            if (QVector3D::dotProduct(referenceDirection, direction) > 0.866 &&
+                    (vertexPosition - m_targetPosition).lengthSquared() <= distance2) {
+                float distance = vertexPosition.distanceToPoint(m_targetPosition);
+                float radius = (m_radius - distance) / node.radius;
+                sumOfRadius += radius;
+                sumOfDirection += direction * radius;
+                ++intersectedNum;
             }
         }
+        if (intersectedNum > 0) {
+            float paintRadius = sumOfRadius / intersectedNum;
+            QVector3D paintDirection = sumOfDirection.normalized();
+            float degrees = angleInRangle360BetweenTwoVectors(node.baseNormal, paintDirection, node.direction);
+            float offset = (float)node.order / map.paintNodes.size();
+            m_changedPartIds.insert(map.partId);
+            paintToImage(map.partId, offset, degrees / 360.0, paintRadius, PaintMode::Push == m_paintMode);
+        }
     }
 }
 
@@ -115,6 +88,7 @@ void MousePicker::process()
 {
     pick();
 
+    this->moveToThread(QGuiApplication::instance()->thread());
     emit finished();
 }
 
@@ -123,9 +97,11 @@ void MousePicker::paintToImage(const QUuid &partId, float x, float y, float radi
     QUuid oldImageId;
     QImage image(72, 36, QImage::Format_Grayscale8);
     image.fill(QColor(127, 127, 127));
+    // Painting runs off the GUI thread, hold the old image so a concurrent removal can't free it
+    std::shared_ptr<const QImage> oldImage;
     const auto &findImageId = m_paintImages.find(partId);
     if (findImageId != m_paintImages.end()) {
-        const QImage *oldImage = ImageForever::get(findImageId->second);
+        oldImage = ImageForever::getSharedImage(findImageId->second);
         if (nullptr != oldImage) {
             if (oldImage->size() == image.size() &&
                     oldImage->format() == image.format()) {
@@ -161,51 +137,6 @@ const QVector3D &MousePicker::targetPosition()
     return m_targetPosition;
 }
 
-bool MousePicker::intersectSegmentAndPlane(const QVector3D &segmentPoint0, const QVector3D &segmentPoint1,
-    const QVector3D &pointOnPlane, const QVector3D &planeNormal,
-    QVector3D *intersection)
-{
-    auto u = segmentPoint1 - segmentPoint0;
-    auto w = segmentPoint0 - pointOnPlane;
-    auto d = QVector3D::dotProduct(planeNormal, u);
-    auto n = QVector3D::dotProduct(-planeNormal, w);
-    if (qAbs(d) < 0.00000001)
-        return false;
-    auto s = n / d;
-    if (s < 0 || s > 1 || qIsNaN(s) || qIsInf(s))
-        return false;
-    if (nullptr != intersection)
-        *intersection = segmentPoint0 + s * u;
-    return true;
-}
-
-bool MousePicker::intersectSegmentAndTriangle(const QVector3D &segmentPoint0, const QVector3D &segmentPoint1,
-    const std::vector<QVector3D> &triangle,
-    const QVector3D &triangleNormal,
-    QVector3D *intersection)
-{
-    QVector3D possibleIntersection;
-    if (!intersectSegmentAndPlane(segmentPoint0, segmentPoint1,
-            triangle[0], triangleNormal, &possibleIntersection)) {
-        return false;
-    }
-    auto ray = (segmentPoint0 - segmentPoint1).normalized();
-    std::vector<QVector3D> normals;
-    for (size_t i = 0; i < 3; ++i) {
-        size_t j = (i + 1) % 3;
-        normals.push_back(QVector3D::normal(possibleIntersection, triangle[i], triangle[j]));
-    }
-    if (QVector3D::dotProduct(normals[0], ray) <= 0)
-        return false;
-    if (QVector3D::dotProduct(normals[0], normals[1]) <= 0)
-        return false;
-    if (QVector3D::dotProduct(normals[0], normals[2]) <= 0)
-        return false;
-    if (nullptr != intersection)
-        *intersection = possibleIntersection;
-    return true;
-}
-
 void MousePicker::setPaintImages(const std::map<QUuid, QUuid> &paintImages)
 {
     m_paintImages = paintImages;
@@ -5,14 +5,15 @@
 #include <vector>
 #include <map>
 #include <set>
-#include "outcome.h"
+#include <memory>
+#include "mousepickindex.h"
 #include "paintmode.h"
 
 class MousePicker : public QObject
 {
     Q_OBJECT
 public:
-    MousePicker(const Outcome &outcome, const QVector3D &mouseRayNear, const QVector3D &mouseRayFar);
+    MousePicker(const std::shared_ptr<const MousePickIndex> &pickIndex, const QVector3D &mouseRayNear, const QVector3D &mouseRayFar);
     void setRadius(float radius);
     void setPaintImages(const std::map<QUuid, QUuid> &paintImages);
     void setPaintMode(PaintMode paintMode);
@@ -34,18 +35,10 @@ private:
     std::set<QUuid> m_changedPartIds;
     std::set<QUuid> m_mousePickMaskNodeIds;
     bool m_enablePaint = false;
-    Outcome m_outcome;
+    std::shared_ptr<const MousePickIndex> m_pickIndex;
     QVector3D m_mouseRayNear;
     QVector3D m_mouseRayFar;
     QVector3D m_targetPosition;
-    static bool intersectSegmentAndPlane(const QVector3D &segmentPoint0, const QVector3D &segmentPoint1,
-        const QVector3D &pointOnPlane, const QVector3D &planeNormal,
-        QVector3D *intersection=nullptr);
-    static bool intersectSegmentAndTriangle(const QVector3D &segmentPoint0, const QVector3D &segmentPoint1,
-        const std::vector<QVector3D> &triangle,
-        const QVector3D &triangleNormal,
-        QVector3D *intersection=nullptr);
-    bool calculateMouseModelPosition(QVector3D &mouseModelPosition);
     void paintToImage(const QUuid &partId, float x, float y, float radius, bool inverted=false);
 };
 
@@ -0,0 +1,152 @@
+#include <QtGlobal>
+#include <algorithm>
+#include <limits>
+#include "mousepickindex.h"
+
+MousePickIndex::MousePickIndex(const Outcome &outcome) :
+    m_meshId(outcome.meshId),
+    m_vertices(outcome.vertices),
+    m_triangles(outcome.triangles),
+    m_triangleNormals(outcome.triangleNormals),
+    m_paintMaps(outcome.paintMaps)
+{
+    std::vector<AabbTree::Box> triangleBoxes;
+    triangleBoxes.reserve(m_triangles.size());
+    for (const auto &triangleIndices: m_triangles) {
+        AabbTree::Box box;
+        box.lower = box.upper = m_vertices[triangleIndices[0]];
+        box.update(m_vertices[triangleIndices[1]]);
+        box.update(m_vertices[triangleIndices[2]]);
+        triangleBoxes.push_back(box);
+    }
+    m_triangleTree = new AabbTree(triangleBoxes);
+
+    std::vector<AabbTree::Box> paintNodeBoxes;
+    for (size_t mapIndex = 0; mapIndex < m_paintMaps.size(); ++mapIndex) {
+        const auto &paintNodes = m_paintMaps[mapIndex].paintNodes;
+        for (size_t nodeIndex = 0; nodeIndex < paintNodes.size(); ++nodeIndex) {
+            const auto &vertices = paintNodes[nodeIndex].vertices;
+            if (vertices.empty())
+                continue;
+            AabbTree::Box box;
+            box.lower = box.upper = vertices[0];
+            for (size_t i = 1; i < vertices.size(); ++i)
+                box.update(vertices[i]);
+            paintNodeBoxes.push_back(box);
+            m_paintNodeIndices.push_back({mapIndex, nodeIndex});
+        }
+    }
+    m_paintNodeTree = new AabbTree(paintNodeBoxes);
+}
+
+MousePickIndex::~MousePickIndex()
+{
+    delete m_triangleTree;
+    delete m_paintNodeTree;
+}
+
+quint64 MousePickIndex::meshId() const
+{
+    return m_meshId;
+}
+
+const std::vector<OutcomePaintMap> &MousePickIndex::paintMaps() const
+{
+    return m_paintMaps;
+}
+
+bool MousePickIndex::intersectSegment(const QVector3D &segmentPoint0, const QVector3D &segmentPoint1,
+    QVector3D *intersection) const
+{
+    std::vector<size_t> candidates;
+    m_triangleTree->querySegment(segmentPoint0, segmentPoint1, &candidates);
+    // Visit in triangle order so ties resolve the same way as a full scan
+    std::sort(candidates.begin(), candidates.end());
+
+    bool foundPosition = false;
+    auto ray = (segmentPoint0 - segmentPoint1).normalized();
+    float minDistance2 = std::numeric_limits<float>::max();
+    for (const auto &i: candidates) {
+        const auto &triangleIndices = m_triangles[i];
+        std::vector<QVector3D> triangle = {
+            m_vertices[triangleIndices[0]],
+            m_vertices[triangleIndices[1]],
+            m_vertices[triangleIndices[2]],
+        };
+        const auto &triangleNormal = m_triangleNormals[i];
+        if (QVector3D::dotProduct(triangleNormal, ray) <= 0)
+            continue;
+        QVector3D possibleIntersection;
+        if (intersectSegmentAndTriangle(segmentPoint0, segmentPoint1,
+                triangle,
+                triangleNormal,
+                &possibleIntersection)) {
+            float distance2 = (possibleIntersection - segmentPoint0).lengthSquared();
+            if (distance2 < minDistance2) {
+                *intersection = possibleIntersection;
+                minDistance2 = distance2;
+                foundPosition = true;
+            }
+        }
+    }
+    return foundPosition;
+}
+
+void MousePickIndex::findPaintNodes(const QVector3D &position, float radius,
+    std::vector<std::pair<size_t, size_t>> *paintNodeIndices) const
+{
+    AabbTree::Box box;
+    box.lower = box.upper = position;
+    std::vector<size_t> candidates;
+    m_paintNodeTree->queryBox(box.expanded(radius), &candidates);
+    // Keep the original order, painting is accumulated on the same image
+    std::sort(candidates.begin(), candidates.end());
+    paintNodeIndices->reserve(paintNodeIndices->size() + candidates.size());
+    for (const auto &i: candidates)
+        paintNodeIndices->push_back(m_paintNodeIndices[i]);
+}
+
+bool MousePickIndex::intersectSegmentAndPlane(const QVector3D &segmentPoint0, const QVector3D &segmentPoint1,
+    const QVector3D &pointOnPlane, const QVector3D &planeNormal,
+    QVector3D *intersection)
+{
+    auto u = segmentPoint1 - segmentPoint0;
+    auto w = segmentPoint0 - pointOnPlane;
+    auto d = QVector3D::dotProduct(planeNormal, u);
+    auto n = QVector3D::dotProduct(-planeNormal, w);
+    if (qAbs(d) < 0.00000001)
+        return false;
+    auto s = n / d;
+    if (s < 0 || s > 1 || qIsNaN(s) || qIsInf(s))
+        return false;
+    if (nullptr != intersection)
+        *intersection = segmentPoint0 + s * u;
+    return true;
+}
+
+bool MousePickIndex::intersectSegmentAndTriangle(const QVector3D &segmentPoint0, const QVector3D &segmentPoint1,
+    const std::vector<QVector3D> &triangle,
+    const QVector3D &triangleNormal,
+    QVector3D *intersection)
+{
+    QVector3D possibleIntersection;
+    if (!intersectSegmentAndPlane(segmentPoint0, segmentPoint1,
+            triangle[0], triangleNormal, &possibleIntersection)) {
+        return false;
+    }
+    auto ray = (segmentPoint0 - segmentPoint1).normalized();
+    std::vector<QVector3D> normals;
+    for (size_t i = 0; i < 3; ++i) {
+        size_t j = (i + 1) % 3;
+        normals.push_back(QVector3D::normal(possibleIntersection, triangle[i], triangle[j]));
+    }
+    if (QVector3D::dotProduct(normals[0], ray) <= 0)
+        return false;
+    if (QVector3D::dotProduct(normals[0], normals[1]) <= 0)
+        return false;
+    if (QVector3D::dotProduct(normals[0], normals[2]) <= 0)
+        return false;
+    if (nullptr != intersection)
+        *intersection = possibleIntersection;
+    return true;
+}
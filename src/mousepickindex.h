@@ -0,0 +1,39 @@
+#ifndef DUST3D_MOUSE_PICK_INDEX_H
+#define DUST3D_MOUSE_PICK_INDEX_H
+#include <QVector3D>
+#include <vector>
+#include "outcome.h"
+#include "aabbtree.h"
+
+// Immutable acceleration structure built once per generated mesh,
+// shared between all the mouse picks until the next mesh arrives.
+class MousePickIndex
+{
+public:
+    MousePickIndex(const Outcome &outcome);
+    ~MousePickIndex();
+    quint64 meshId() const;
+    const std::vector<OutcomePaintMap> &paintMaps() const;
+    bool intersectSegment(const QVector3D &segmentPoint0, const QVector3D &segmentPoint1,
+        QVector3D *intersection) const;
+    void findPaintNodes(const QVector3D &position, float radius,
+        std::vector<std::pair<size_t, size_t>> *paintNodeIndices) const;
+    static bool intersectSegmentAndPlane(const QVector3D &segmentPoint0, const QVector3D &segmentPoint1,
+        const QVector3D &pointOnPlane, const QVector3D &planeNormal,
+        QVector3D *intersection=nullptr);
+    static bool intersectSegmentAndTriangle(const QVector3D &segmentPoint0, const QVector3D &segmentPoint1,
+        const std::vector<QVector3D> &triangle,
+        const QVector3D &triangleNormal,
+        QVector3D *intersection=nullptr);
+private:
+    quint64 m_meshId = 0;
+    std::vector<QVector3D> m_vertices;
+    std::vector<std::vector<size_t>> m_triangles;
+    std::vector<QVector3D> m_triangleNormals;
+    std::vector<OutcomePaintMap> m_paintMaps;
+    std::vector<std::pair<size_t, size_t>> m_paintNodeIndices;
+    AabbTree *m_triangleTree = nullptr;
+    AabbTree *m_paintNodeTree = nullptr;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <cmath>
+#include <algorithm>
+#include "optimizevertexcache.h"
+
+static const int g_cacheSize = 32;
+
+static float vertexScore(int activeTriangleCount, int cachePosition)
+{
+    if (0 == activeTriangleCount)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // The last triangle's vertices get a fixed score, so the next triangle does not simply reuse the same edge
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - (float)(cachePosition - 3) / (g_cacheSize - 3), 1.5f);
+    }
+    // Boost vertices with few triangles left, so they get finished and do not leave lone triangles behind
+    score += 2.0f * std::pow((float)activeTriangleCount, -0.5f);
+    return score;
+}
+
+void optimizeVertexCache(std::vector<uint32_t> *triangleIndices, size_t vertexCount)
+{
+    size_t triangleCount = triangleIndices->size() / 3;
+    if (0 == triangleCount)
+        return;
+    const auto &indices = *triangleIndices;
+    
+    std::vector<uint32_t> vertexTriangleOffsets(vertexCount + 1, 0);
+    for (const auto &index: indices)
+        ++vertexTriangleOffsets[index + 1];
+    for (size_t i = 1; i < vertexTriangleOffsets.size(); ++i)
+        vertexTriangleOffsets[i] += vertexTriangleOffsets[i - 1];
+    std::vector<uint32_t> vertexTriangles(indices.size());
+    std::vector<uint32_t> activeTriangleCounts(vertexCount, 0);
+    for (size_t i = 0; i < indices.size(); ++i) {
+        uint32_t vertex = indices[i];
+        vertexTriangles[vertexTriangleOffsets[vertex] + activeTriangleCounts[vertex]++] = i / 3;
+    }
+    
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i)
+        vertexScores[i] = vertexScore(activeTriangleCounts[i], -1);
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t i = 0; i < triangleCount; ++i)
+        triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+    std::vector<bool> emittedTriangles(triangleCount, false);
+    
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    cache.reserve(g_cacheSize + 3);
+    newCache.reserve(g_cacheSize + 3);
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    
+    size_t scanCursor = 0;
+    int bestTriangle = -1;
+    float bestScore = -1.0f;
+    for (size_t i = 0; i < triangleCount; ++i) {
+        if (triangleScores[i] > bestScore) {
+            bestScore = triangleScores[i];
+            bestTriangle = i;
+        }
+    }
+    
+    while (bestTriangle >= 0) {
+        emittedTriangles[bestTriangle] = true;
+        const uint32_t *triangle = &indices[bestTriangle * 3];
+        for (int j = 0; j < 3; ++j) {
+            uint32_t vertex = triangle[j];
+            result.push_back(vertex);
+            // Move the emitted triangle to the end of the vertex's active list, and shrink the list
+            uint32_t *begin = &vertexTriangles[vertexTriangleOffsets[vertex]];
+            uint32_t *end = begin + activeTriangleCounts[vertex];
+            uint32_t *found = std::find(begin, end, (uint32_t)bestTriangle);
+            if (found != end) {
+                std::swap(*found, *(end - 1));
+                --activeTriangleCounts[vertex];
+            }
+        }
+        
+        newCache.clear();
+        newCache.insert(newCache.end(), triangle, triangle + 3);
+        for (const auto &vertex: cache) {
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                newCache.push_back(vertex);
+        }
+        for (size_t i = g_cacheSize; i < newCache.size(); ++i) {
+            uint32_t vertex = newCache[i];
+            cachePositions[vertex] = -1;
+            vertexScores[vertex] = vertexScore(activeTriangleCounts[vertex], -1);
+        }
+        if (newCache.size() > (size_t)g_cacheSize)
+            newCache.resize(g_cacheSize);
+        std::swap(cache, newCache);
+        for (size_t i = 0; i < cache.size(); ++i) {
+            uint32_t vertex = cache[i];
+            cachePositions[vertex] = i;
+            vertexScores[vertex] = vertexScore(activeTriangleCounts[vertex], i);
+        }
+        
+        bestTriangle = -1;
+        bestScore = -1.0f;
+        for (const auto &vertex: cache) {
+            uint32_t *begin = &vertexTriangles[vertexTriangleOffsets[vertex]];
+            uint32_t *end = begin + activeTriangleCounts[vertex];
+            for (uint32_t *it = begin; it != end; ++it) {
+                uint32_t triangleIndex = *it;
+                const uint32_t *other = &indices[triangleIndex * 3];
+                float score = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+                triangleScores[triangleIndex] = score;
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = triangleIndex;
+                }
+            }
+        }
+        
+        if (bestTriangle < 0) {
+            // Nothing connected to the cache is left, continue from the first triangle not emitted yet
+            while (scanCursor < triangleCount && emittedTriangles[scanCursor])
+                ++scanCursor;
+            if (scanCursor < triangleCount)
+                bestTriangle = scanCursor;
+        }
+    }
+    
+    triangleIndices->swap(result);
+}
+
+void optimizeVertexFetch(std::vector<uint32_t> *triangleIndices, size_t vertexCount, std::vector<uint32_t> *newToOldVertices)
+{
+    const uint32_t noneIndex = (uint32_t)-1;
+    std::vector<uint32_t> oldToNewVertices(vertexCount, noneIndex);
+    newToOldVertices->clear();
+    newToOldVertices->reserve(vertexCount);
+    for (auto &index: *triangleIndices) {
+        uint32_t &newIndex = oldToNewVertices[index];
+        if (noneIndex == newIndex) {
+            newIndex = newToOldVertices->size();
+            newToOldVertices->push_back(index);
+        }
+        index = newIndex;
+    }
+}
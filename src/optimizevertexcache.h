@@ -0,0 +1,12 @@
+#ifndef DUST3D_OPTIMIZE_VERTEX_CACHE_H
+#define DUST3D_OPTIMIZE_VERTEX_CACHE_H
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Reorders triangles for the post transform vertex cache (Tom Forsyth's linear speed algorithm)
+void optimizeVertexCache(std::vector<uint32_t> *triangleIndices, size_t vertexCount);
+// Renumbers vertices in the order they are first referenced, the returned list maps new index to old index
+void optimizeVertexFetch(std::vector<uint32_t> *triangleIndices, size_t vertexCount, std::vector<uint32_t> *newToOldVertices);
+
+#endif
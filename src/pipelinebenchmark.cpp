@@ -0,0 +1,286 @@
+#include <QElapsedTimer>
+#include <QXmlStreamReader>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QDebug>
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "pipelinebenchmark.h"
+#include "ds3file.h"
+#include "snapshot.h"
+#include "snapshotxml.h"
+#include "imageforever.h"
+#include "meshgenerator.h"
+#include "meshresultpostprocessor.h"
+#include "uvunwrap.h"
+#include "texturegenerator.h"
+#include "riggenerator.h"
+#include "motionsgenerator.h"
+#include "rigtype.h"
+#include "document.h"
+#include "util.h"
+
+PipelineBenchmark::PipelineBenchmark(const QStringList &filenames, int runs) :
+    m_filenames(filenames),
+    m_runs(std::max(runs, 1))
+{
+}
+
+QStringList PipelineBenchmark::sampleModels()
+{
+    return QStringList {
+        ":/resources/model-addax.ds3",
+        ":/resources/model-bicycle.ds3",
+        ":/resources/model-cat.ds3",
+        ":/resources/model-dog.ds3",
+        ":/resources/model-giraffe.ds3",
+        ":/resources/model-meerkat.ds3",
+        ":/resources/model-mosquito.ds3",
+        ":/resources/model-procedural-tree.ds3",
+        ":/resources/model-seagull.ds3",
+    };
+}
+
+qint64 PipelineBenchmark::peakResidentBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return (qint64)counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_SELF, &usage))
+        return 0;
+#if defined(Q_OS_MAC)
+    return (qint64)usage.ru_maxrss;
+#else
+    return (qint64)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+static double percentile(std::vector<double> values, double ratio)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)std::ceil(ratio * values.size());
+    return values[std::max(rank, (size_t)1) - 1];
+}
+
+bool PipelineBenchmark::runOnce(const QString &filename, std::vector<QString> *stageNames,
+    std::map<QString, std::vector<double>> *timings,
+    std::map<QString, qint64> *peaks)
+{
+    // Seed everything that may draw random numbers, so the runs do the same work
+    qsrand(0);
+    std::srand(0);
+    
+    QElapsedTimer timer;
+    timer.start();
+    auto finishStage = [&](const QString &name) {
+        if (timings->find(name) == timings->end())
+            stageNames->push_back(name);
+        (*timings)[name].push_back(timer.nsecsElapsed() / 1000000.0);
+        (*peaks)[name] = std::max((*peaks)[name], peakResidentBytes());
+        timer.restart();
+    };
+    
+    Ds3FileReader ds3Reader(filename);
+    Snapshot snapshot;
+    bool hasModel = false;
+    std::map<QUuid, QImage> images;
+    ds3Reader.loadImages(&images);
+    for (const auto &it: images)
+        (void)ImageForever::add(&it.second, it.first);
+    for (int i = 0; i < ds3Reader.items().size(); ++i) {
+        const Ds3ReaderItem &item = ds3Reader.items().at(i);
+        if (item.type == "model") {
+            QByteArray data = ds3Reader.itemView(item.name);
+            QXmlStreamReader stream(data);
+            loadSkeletonFromXmlStream(&snapshot, stream);
+            hasModel = true;
+        }
+    }
+    auto releaseImages = [&]() {
+        for (const auto &it: images)
+            ImageForever::remove(it.first);
+    };
+    if (!hasModel) {
+        qDebug() << "No model found in" << filename;
+        releaseImages();
+        return false;
+    }
+    if (snapshot.canvas.find("originX") == snapshot.canvas.end() ||
+            snapshot.canvas.find("originY") == snapshot.canvas.end() ||
+            snapshot.canvas.find("originZ") == snapshot.canvas.end()) {
+        QRectF mainProfile;
+        QRectF sideProfile;
+        snapshot.resolveBoundingBox(&mainProfile, &sideProfile);
+        snapshot.canvas["originX"] = QString::number(mainProfile.x() + mainProfile.width() / 2);
+        snapshot.canvas["originY"] = QString::number(mainProfile.y() + mainProfile.height() / 2);
+        snapshot.canvas["originZ"] = QString::number(sideProfile.x() + sideProfile.width() / 2);
+    }
+    finishStage("load");
+    
+    // The cold run fills a fresh cache context, the warm run regenerates the unchanged document with it,
+    // which is what an edit of the root properties costs in the editor
+    GeneratedCacheContext *cacheContext = new GeneratedCacheContext;
+    MeshGenerator *meshGenerator = new MeshGenerator(new Snapshot(snapshot));
+    meshGenerator->setGeneratedCacheContext(cacheContext);
+    meshGenerator->generate();
+    Outcome *outcome = meshGenerator->takeOutcome();
+    delete meshGenerator;
+    finishStage("meshCold");
+    
+    meshGenerator = new MeshGenerator(new Snapshot(snapshot));
+    meshGenerator->setGeneratedCacheContext(cacheContext);
+    meshGenerator->generate();
+    delete meshGenerator;
+    delete cacheContext;
+    finishStage("meshWarm");
+    
+    if (nullptr == outcome) {
+        qDebug() << "Mesh generation failed for" << filename;
+        releaseImages();
+        return false;
+    }
+    
+    {
+        std::vector<std::vector<QVector2D>> triangleVertexUvs;
+        std::set<int> seamVertices;
+        std::map<QUuid, std::vector<QRectF>> partUvRects;
+        uvUnwrap(*outcome, triangleVertexUvs, seamVertices, partUvRects);
+    }
+    finishStage("uvUnwrap");
+    
+    MeshResultPostProcessor *postProcessor = new MeshResultPostProcessor(*outcome);
+    postProcessor->poseProcess();
+    Outcome *postProcessedOutcome = postProcessor->takePostProcessedOutcome();
+    delete postProcessor;
+    delete outcome;
+    finishStage("postprocess");
+    
+    TextureGenerator *textureGenerator = new TextureGenerator(*postProcessedOutcome, new Snapshot(snapshot));
+    textureGenerator->generate();
+    delete textureGenerator;
+    finishStage("texture");
+    
+    RigType rigType = RigTypeFromString(valueOfKeyInMapOrEmpty(snapshot.canvas, "rigType").toUtf8().constData());
+    if (RigType::None != rigType) {
+        RigGenerator *rigGenerator = new RigGenerator(rigType, *postProcessedOutcome);
+        rigGenerator->generate();
+        std::vector<RiggerBone> *rigBones = nullptr;
+        std::map<int, RiggerVertexWeights> *rigWeights = nullptr;
+        std::shared_ptr<const Outcome> riggedOutcome = rigGenerator->outcome();
+        if (rigGenerator->isSucceed()) {
+            rigBones = rigGenerator->takeResultBones();
+            rigWeights = rigGenerator->takeResultWeights();
+        }
+        delete rigGenerator;
+        finishStage("rig");
+        
+        if (nullptr != rigBones && nullptr != rigWeights && nullptr != riggedOutcome && !snapshot.motions.empty()) {
+            MotionsGenerator *motionsGenerator = new MotionsGenerator(rigType, rigBones, rigWeights, *riggedOutcome);
+            for (const auto &pose: snapshot.poses) {
+                const auto &poseAttributes = pose.first;
+                float yTranslationScale = 1.0;
+                auto findYtranslationScale = poseAttributes.find("yTranslationScale");
+                if (findYtranslationScale != poseAttributes.end())
+                    yTranslationScale = findYtranslationScale->second.toFloat();
+                motionsGenerator->addPoseToLibrary(QUuid(valueOfKeyInMapOrEmpty(poseAttributes, "id")),
+                    pose.second, yTranslationScale);
+            }
+            for (const auto &motion: snapshot.motions) {
+                QUuid motionId = QUuid(valueOfKeyInMapOrEmpty(motion.first, "id"));
+                std::vector<MotionClip> clips;
+                for (const auto &attributes: motion.second) {
+                    MotionClip clip(valueOfKeyInMapOrEmpty(attributes, "linkData"),
+                        valueOfKeyInMapOrEmpty(attributes, "linkDataType"));
+                    clip.duration = valueOfKeyInMapOrEmpty(attributes, "duration").toFloat();
+                    clips.push_back(clip);
+                }
+                motionsGenerator->addMotionToLibrary(motionId, clips);
+                motionsGenerator->addRequirement(motionId);
+            }
+            motionsGenerator->generate();
+            delete motionsGenerator;
+            finishStage("motions");
+        }
+        
+        delete rigBones;
+        delete rigWeights;
+    }
+    
+    delete postProcessedOutcome;
+    releaseImages();
+    return true;
+}
+
+void PipelineBenchmark::run()
+{
+    m_results.clear();
+    for (const auto &filename: m_filenames) {
+        Result result;
+        result.filename = filename;
+        result.succeed = true;
+        std::vector<QString> stageNames;
+        std::map<QString, std::vector<double>> timings;
+        std::map<QString, qint64> peaks;
+        for (int i = 0; i < m_runs; ++i) {
+            if (!runOnce(filename, &stageNames, &timings, &peaks)) {
+                result.succeed = false;
+                break;
+            }
+        }
+        for (const auto &name: stageNames) {
+            StageResult stage;
+            stage.name = name;
+            stage.medianMilliseconds = percentile(timings[name], 0.5);
+            stage.p95Milliseconds = percentile(timings[name], 0.95);
+            stage.peakResidentBytes = peaks[name];
+            result.stages.push_back(stage);
+        }
+        m_results.push_back(result);
+    }
+}
+
+const std::vector<PipelineBenchmark::Result> &PipelineBenchmark::results()
+{
+    return m_results;
+}
+
+QByteArray PipelineBenchmark::toJson() const
+{
+    QJsonArray models;
+    for (const auto &result: m_results) {
+        QJsonArray stages;
+        for (const auto &stage: result.stages) {
+            QJsonObject item;
+            item["name"] = stage.name;
+            item["medianMilliseconds"] = stage.medianMilliseconds;
+            item["p95Milliseconds"] = stage.p95Milliseconds;
+            item["peakResidentBytes"] = stage.peakResidentBytes;
+            stages.append(item);
+        }
+        QJsonObject model;
+        model["filename"] = result.filename;
+        model["succeed"] = result.succeed;
+        model["stages"] = stages;
+        models.append(model);
+    }
+    QJsonObject root;
+    root["runs"] = m_runs;
+    root["models"] = models;
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
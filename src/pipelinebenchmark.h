@@ -0,0 +1,46 @@
+#ifndef DUST3D_PIPELINE_BENCHMARK_H
+#define DUST3D_PIPELINE_BENCHMARK_H
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <vector>
+#include <map>
+
+// Runs the generation pipelines over a corpus of .ds3 files several times and reports the median
+// and 95th percentile latency of every stage, together with the peak resident memory of the process
+class PipelineBenchmark
+{
+public:
+    struct StageResult
+    {
+        QString name;
+        double medianMilliseconds = 0;
+        double p95Milliseconds = 0;
+        qint64 peakResidentBytes = 0;
+    };
+    
+    struct Result
+    {
+        QString filename;
+        bool succeed = false;
+        std::vector<StageResult> stages;
+    };
+    
+    PipelineBenchmark(const QStringList &filenames, int runs);
+    void run();
+    const std::vector<Result> &results();
+    QByteArray toJson() const;
+    static QStringList sampleModels();
+    static qint64 peakResidentBytes();
+    
+private:
+    QStringList m_filenames;
+    int m_runs = 1;
+    std::vector<Result> m_results;
+    
+    bool runOnce(const QString &filename, std::vector<QString> *stageNames,
+        std::map<QString, std::vector<double>> *timings,
+        std::map<QString, qint64> *peaks);
+};
+
+#endif
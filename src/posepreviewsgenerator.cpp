@@ -1,18 +1,21 @@
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 #include <QGuiApplication>
 #include <QElapsedTimer>
 #include "posepreviewsgenerator.h"
-#include "posemeshcreator.h"
+#include "skinnedmeshcreator.h"
 #include "poserconstruct.h"
 #include "posedocument.h"
+#include "profiler.h"
 
 PosePreviewsGenerator::PosePreviewsGenerator(RigType rigType,
         const std::vector<RiggerBone> *rigBones,
         const std::map<int, RiggerVertexWeights> *rigWeights,
-        const Outcome &outcome) :
+        const std::shared_ptr<const Outcome> &outcome) :
     m_rigType(rigType),
     m_rigBones(*rigBones),
     m_rigWeights(*rigWeights),
-    m_outcome(new Outcome(outcome))
+    m_outcome(outcome)
 {
 }
 
@@ -21,7 +24,6 @@ PosePreviewsGenerator::~PosePreviewsGenerator()
     for (auto &item: m_previews) {
         delete item.second;
     }
-    delete m_outcome;
 }
 
 void PosePreviewsGenerator::addPose(std::pair<QUuid, int> idAndFrame, const std::map<QString, std::map<QString, QString>> &pose)
@@ -29,6 +31,14 @@ void PosePreviewsGenerator::addPose(std::pair<QUuid, int> idAndFrame, const std:
     m_poses.push_back(std::make_pair(idAndFrame, pose));
 }
 
+std::set<QUuid> PosePreviewsGenerator::poseIds() const
+{
+    std::set<QUuid> poseIds;
+    for (const auto &pose: m_poses)
+        poseIds.insert(pose.first.first);
+    return poseIds;
+}
+
 const std::set<std::pair<QUuid, int>> &PosePreviewsGenerator::generatedPreviewPoseIdAndFrames()
 {
     return m_generatedPoseIdAndFrames;
@@ -45,26 +55,43 @@ void PosePreviewsGenerator::process()
 {
     QElapsedTimer countTimeConsumed;
     countTimeConsumed.start();
-
-    Poser *poser = newPoser(m_rigType, m_rigBones);
-    for (const auto &pose: m_poses) {
-        PoseDocument poseDocument;
-        poseDocument.fromParameters(&m_rigBones, pose.second);
-        std::map<QString, std::map<QString, QString>> translatedParameters;
-        poseDocument.toParameters(translatedParameters);
-        poser->parameters() = translatedParameters;
-        poser->commit();
-        
-        PoseMeshCreator *poseMeshCreator = new PoseMeshCreator(poser->resultNodes(), *m_outcome, m_rigWeights);
-        poseMeshCreator->createMesh();
-        m_previews[pose.first] = poseMeshCreator->takeResultMesh();
-        delete poseMeshCreator;
-        
-        poser->reset();
+    
+    {
+        Profiler::Scope profile("posePreviews", "animation");
+            
+        // The bind pose is prepared once and only read by the workers, each worker has its own poser
+        const SkinnedMeshCreator skinnedMeshCreator(*m_outcome, m_rigWeights);
+        std::vector<MeshLoader *> results(m_poses.size(), nullptr);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, m_poses.size()),
+                [&](const tbb::blocked_range<size_t> &range) {
+            Poser *poser = newPoser(m_rigType, m_rigBones);
+            for (size_t i = range.begin(); i != range.end(); ++i) {
+                const auto &pose = m_poses[i];
+                PoseDocument poseDocument;
+                poseDocument.fromParameters(&m_rigBones, pose.second);
+                std::map<QString, std::map<QString, QString>> translatedParameters;
+                poseDocument.toParameters(translatedParameters);
+                poser->parameters() = translatedParameters;
+                poser->commit();
+                
+                const auto &resultNodes = poser->resultNodes();
+                std::vector<QMatrix4x4> matricies(resultNodes.size());
+                for (size_t j = 0; j < resultNodes.size(); ++j)
+                    matricies[j] = resultNodes[j].transformMatrix;
+                results[i] = skinnedMeshCreator.createMeshFromTransform(matricies);
+                
+                poser->reset();
+            }
+            delete poser;
+        });
         
-        m_generatedPoseIdAndFrames.insert(pose.first);
+        for (size_t i = 0; i < m_poses.size(); ++i) {
+            const auto &idAndFrame = m_poses[i].first;
+            delete m_previews[idAndFrame];
+            m_previews[idAndFrame] = results[i];
+            m_generatedPoseIdAndFrames.insert(idAndFrame);
+        }
     }
-    delete poser;
     
     qDebug() << "The pose previews generation took" << countTimeConsumed.elapsed() << "milliseconds";
     
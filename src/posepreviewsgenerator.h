@@ -4,6 +4,7 @@
 #include <map>
 #include <QUuid>
 #include <vector>
+#include <memory>
 #include "meshloader.h"
 #include "rigger.h"
 #include "outcome.h"
@@ -16,9 +17,10 @@ public:
     PosePreviewsGenerator(RigType rigType,
         const std::vector<RiggerBone> *rigBones,
         const std::map<int, RiggerVertexWeights> *rigWeights,
-        const Outcome &outcome);
+        const std::shared_ptr<const Outcome> &outcome);
     ~PosePreviewsGenerator();
     void addPose(std::pair<QUuid, int> idAndFrame, const std::map<QString, std::map<QString, QString>> &pose);
+    std::set<QUuid> poseIds() const;
     const std::set<std::pair<QUuid, int>> &generatedPreviewPoseIdAndFrames();
     MeshLoader *takePreview(std::pair<QUuid, int> idAndFrame);
 signals:
@@ -29,7 +31,7 @@ private:
     RigType m_rigType = RigType::None;
     std::vector<RiggerBone> m_rigBones;
     std::map<int, RiggerVertexWeights> m_rigWeights;
-    Outcome *m_outcome = nullptr;
+    std::shared_ptr<const Outcome> m_outcome;
     std::vector<std::pair<std::pair<QUuid, int>, std::map<QString, std::map<QString, QString>>>> m_poses;
     std::map<std::pair<QUuid, int>, MeshLoader *> m_previews;
     std::set<std::pair<QUuid, int>> m_generatedPoseIdAndFrames;
@@ -0,0 +1,151 @@
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QDebug>
+#include "profiler.h"
+
+std::atomic<bool> Profiler::m_enabled {false};
+std::vector<Profiler::Event> *Profiler::m_events = nullptr;
+std::map<QString, qint64> Profiler::m_counters;
+
+static QMutex g_profilerMutex;
+
+static QElapsedTimer &profilerClock()
+{
+    static QElapsedTimer clock;
+    return clock;
+}
+
+Profiler::Scope::Scope(const char *name, const char *category) :
+    m_name(name),
+    m_category(category)
+{
+    if (Profiler::isEnabled())
+        m_begin = Profiler::now();
+}
+
+Profiler::Scope::~Scope()
+{
+    if (m_begin < 0 || !Profiler::isEnabled())
+        return;
+    Event event;
+    event.name = m_name;
+    event.category = m_category;
+    event.phase = 'X';
+    event.timestamp = m_begin;
+    event.duration = Profiler::now() - m_begin;
+    event.threadId = Profiler::currentThreadId();
+    event.args = std::move(m_args);
+    Profiler::addEvent(std::move(event));
+}
+
+void Profiler::Scope::setArg(const char *name, qint64 value)
+{
+    if (m_begin < 0)
+        return;
+    m_args.push_back({name, value});
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+    QMutexLocker locker(&g_profilerMutex);
+    if (enabled && !profilerClock().isValid())
+        profilerClock().start();
+    if (enabled && nullptr == m_events)
+        m_events = new std::vector<Event>;
+    m_enabled = enabled;
+}
+
+bool Profiler::isEnabled()
+{
+    return m_enabled;
+}
+
+qint64 Profiler::now()
+{
+    return profilerClock().nsecsElapsed() / 1000;
+}
+
+int Profiler::currentThreadId()
+{
+    static std::atomic<int> nextThreadId {1};
+    thread_local int threadId = nextThreadId++;
+    return threadId;
+}
+
+void Profiler::addEvent(Event &&event)
+{
+    QMutexLocker locker(&g_profilerMutex);
+    if (nullptr == m_events)
+        return;
+    m_events->push_back(std::move(event));
+}
+
+void Profiler::increase(const char *counterName, qint64 value)
+{
+    if (!isEnabled())
+        return;
+    Event event;
+    event.name = counterName;
+    event.category = "counter";
+    event.phase = 'C';
+    event.timestamp = now();
+    event.duration = 0;
+    event.threadId = currentThreadId();
+    QMutexLocker locker(&g_profilerMutex);
+    if (nullptr == m_events)
+        return;
+    // Counter events carry the running total, so the trace viewer draws them as a growing track
+    qint64 &total = m_counters[counterName];
+    total += value;
+    event.args.push_back({"value", total});
+    m_events->push_back(std::move(event));
+}
+
+std::map<QString, qint64> Profiler::counters()
+{
+    QMutexLocker locker(&g_profilerMutex);
+    return m_counters;
+}
+
+bool Profiler::saveChromeTrace(const QString &filename)
+{
+    QJsonArray traceEvents;
+    {
+        QMutexLocker locker(&g_profilerMutex);
+        if (nullptr == m_events)
+            return false;
+        for (const auto &it: *m_events) {
+            QJsonObject event;
+            event["name"] = it.name;
+            event["cat"] = it.category;
+            event["ph"] = QString(QChar(it.phase));
+            event["ts"] = it.timestamp;
+            if ('X' == it.phase)
+                event["dur"] = it.duration;
+            event["pid"] = 1;
+            event["tid"] = it.threadId;
+            if (!it.args.empty()) {
+                QJsonObject args;
+                for (const auto &arg: it.args)
+                    args[arg.first] = arg.second;
+                event["args"] = args;
+            }
+            traceEvents.append(event);
+        }
+    }
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Open trace file failed:" << filename;
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef DUST3D_PROFILER_H
+#define DUST3D_PROFILER_H
+#include <QString>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <utility>
+
+// Timed stages and counters of the generation pipelines, collected from any thread
+// and written in the Chrome trace event format (open with chrome://tracing or Perfetto).
+// Nothing is recorded until enabled, so the scopes can stay in the hot paths.
+class Profiler
+{
+public:
+    class Scope
+    {
+    public:
+        Scope(const char *name, const char *category="mesh");
+        ~Scope();
+        void setArg(const char *name, qint64 value);
+    private:
+        const char *m_name = nullptr;
+        const char *m_category = nullptr;
+        qint64 m_begin = -1;
+        std::vector<std::pair<const char *, qint64>> m_args;
+    };
+    
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+    static void increase(const char *counterName, qint64 value=1);
+    static std::map<QString, qint64> counters();
+    static bool saveChromeTrace(const QString &filename);
+    
+private:
+    struct Event
+    {
+        const char *name;
+        const char *category;
+        char phase;
+        qint64 timestamp;
+        qint64 duration;
+        int threadId;
+        std::vector<std::pair<const char *, qint64>> args;
+    };
+    
+    static std::atomic<bool> m_enabled;
+    static std::vector<Event> *m_events;
+    static std::map<QString, qint64> m_counters;
+    static qint64 now();
+    static int currentThreadId();
+    static void addEvent(Event &&event);
+};
+
+#endif
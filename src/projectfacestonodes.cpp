@@ -1,7 +1,10 @@
 #include <tbb/parallel_for.h>
 #include <tbb/blocked_range.h>
 #include <cmath>
+#include <algorithm>
+#include <limits>
 #include "projectfacestonodes.h"
+#include "aabbtree.h"
 #include "util.h"
 
 class FacesToNearestNodesProjector
@@ -10,11 +13,13 @@ public:
     FacesToNearestNodesProjector(const std::vector<QVector3D> *vertices,
             const std::vector<std::vector<size_t>> *faces,
             const std::vector<std::pair<QVector3D, float>> *sourceNodes,
-            std::vector<size_t> *faceSources) :
+            std::vector<size_t> *faceSources,
+            const AabbTree *nodeTree=nullptr) :
         m_vertices(vertices),
         m_faces(faces),
         m_sourceNodes(sourceNodes),
-        m_faceSources(faceSources)
+        m_faceSources(faceSources),
+        m_nodeTree(nodeTree)
     {
     }
     bool test(const std::vector<size_t> &face,
@@ -22,12 +27,7 @@ public:
             float nodeRadius,
             float *distance) const
     {
-        QVector3D faceCenter;
-        for (const auto &it: face) {
-            faceCenter += (*m_vertices)[it];
-        }
-        if (face.size() > 0)
-            faceCenter /= face.size();
+        QVector3D faceCenter = calculateFaceCenter(face);
         auto ray = (nodePosition - faceCenter).normalized();
         auto inversedFaceNormal = -polygonNormal(*m_vertices, face);
         *distance = (faceCenter - nodePosition).length();
@@ -39,14 +39,38 @@ public:
         }
         return true;
     }
+    QVector3D calculateFaceCenter(const std::vector<size_t> &face) const
+    {
+        QVector3D faceCenter;
+        for (const auto &it: face) {
+            faceCenter += (*m_vertices)[it];
+        }
+        if (face.size() > 0)
+            faceCenter /= face.size();
+        return faceCenter;
+    }
     void operator()(const tbb::blocked_range<size_t> &range) const
     {
+        std::vector<size_t> candidates;
         for (size_t i = range.begin(); i != range.end(); ++i) {
+            const auto &face = (*m_faces)[i];
+            candidates.clear();
+            if (nullptr != m_nodeTree) {
+                AabbTree::Box box;
+                box.lower = box.upper = calculateFaceCenter(face);
+                m_nodeTree->queryBox(box, &candidates);
+                // Same visiting order as the full scan, so ties pick the same node
+                std::sort(candidates.begin(), candidates.end());
+            } else {
+                candidates.resize(m_sourceNodes->size());
+                for (size_t j = 0; j < candidates.size(); ++j)
+                    candidates[j] = j;
+            }
             std::vector<std::pair<size_t, float>> distanceWithNodes;
-            for (size_t j = 0; j < m_sourceNodes->size(); ++j) {
+            for (const auto &j: candidates) {
                 const auto &node = (*m_sourceNodes)[j];
                 float distance = 0.0f;
-                if (!test((*m_faces)[i], node.first, node.second, &distance))
+                if (!test(face, node.first, node.second, &distance))
                     continue;
                 distanceWithNodes.push_back(std::make_pair(j, distance));
             }
@@ -62,6 +86,7 @@ private:
     const std::vector<std::vector<size_t>> *m_faces = nullptr;
     const std::vector<std::pair<QVector3D, float>> *m_sourceNodes = nullptr;
     std::vector<size_t> *m_faceSources = nullptr;
+    const AabbTree *m_nodeTree = nullptr;
 };
 
 void projectFacesToNodes(const std::vector<QVector3D> &vertices,
@@ -69,7 +94,31 @@ void projectFacesToNodes(const std::vector<QVector3D> &vertices,
     const std::vector<std::pair<QVector3D, float>> &sourceNodes,
     std::vector<size_t> *faceSources)
 {
+    // A node can only be chosen by faces whose center is within 1.5 times of its radius,
+    // the boxes are slightly enlarged so float rounding never drops a candidate
+    std::vector<AabbTree::Box> nodeBoxes(sourceNodes.size());
+    for (size_t i = 0; i < sourceNodes.size(); ++i) {
+        const auto &node = sourceNodes[i];
+        float reach = std::abs(node.second) * 1.5f;
+        reach += reach * 0.001f + 0.000001f;
+        if (!std::isfinite(reach))
+            reach = std::numeric_limits<float>::max();
+        nodeBoxes[i].lower = nodeBoxes[i].upper = node.first;
+        nodeBoxes[i] = nodeBoxes[i].expanded(reach);
+    }
+    AabbTree nodeTree(nodeBoxes);
+    
     // Resolve the faces's source nodes
+    faceSources->resize(faces.size(), std::numeric_limits<size_t>::max());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, faces.size()),
+        FacesToNearestNodesProjector(&vertices, &faces, &sourceNodes, faceSources, &nodeTree));
+}
+
+void projectFacesToNodesBruteForce(const std::vector<QVector3D> &vertices,
+    const std::vector<std::vector<size_t>> &faces,
+    const std::vector<std::pair<QVector3D, float>> &sourceNodes,
+    std::vector<size_t> *faceSources)
+{
     faceSources->resize(faces.size(), std::numeric_limits<size_t>::max());
     tbb::parallel_for(tbb::blocked_range<size_t>(0, faces.size()),
         FacesToNearestNodesProjector(&vertices, &faces, &sourceNodes, faceSources));
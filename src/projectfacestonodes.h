@@ -7,5 +7,10 @@ void projectFacesToNodes(const std::vector<QVector3D> &vertices,
     const std::vector<std::vector<size_t>> &faces,
     const std::vector<std::pair<QVector3D, float>> &sourceNodes,
     std::vector<size_t> *faceSources);
+// Tests every face against every node, kept as the reference of projectFacesToNodes
+void projectFacesToNodesBruteForce(const std::vector<QVector3D> &vertices,
+    const std::vector<std::vector<size_t>> &faces,
+    const std::vector<std::pair<QVector3D, float>> &sourceNodes,
+    std::vector<size_t> *faceSources);
 
 #endif
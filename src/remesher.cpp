@@ -1,10 +1,20 @@
 #include <instant-meshes-api.h>
+#include <tbb/task_arena.h>
 #include <cmath>
 #include <QElapsedTimer>
+#include <QMutex>
 #include "remesher.h"
 #include "util.h"
 #include "projectfacestonodes.h"
 
+// Instant-Meshes keeps its results in global buffers, only one remesh can run at a time
+static QMutex g_remeshMutex;
+
+// Remesh is called from inside TBB tasks and Instant-Meshes runs its own parallel loops,
+// waiting on them in a separated arena keeps the thread holding the lock from picking up
+// an outer task which would remesh again and lock itself
+static tbb::task_arena g_remeshArena;
+
 Remesher::Remesher()
 {
 }
@@ -20,6 +30,16 @@ void Remesher::setMesh(const std::vector<QVector3D> &vertices,
     m_triangles = triangles;
 }
 
+void Remesher::setCancelFlag(const std::atomic<bool> *cancelled)
+{
+    m_cancelled = cancelled;
+}
+
+bool Remesher::isCancelled() const
+{
+    return nullptr != m_cancelled && *m_cancelled;
+}
+
 const std::vector<QVector3D> &Remesher::getRemeshedVertices() const
 {
     return m_remeshedVertices;
@@ -58,21 +78,29 @@ void Remesher::remesh(float targetVertexMultiplyFactor)
         }});
         totalArea += areaOfTriangle(m_vertices[triangle[0]], m_vertices[triangle[1]], m_vertices[triangle[2]]);
     }
+    if (isCancelled())
+        return;
+    QMutexLocker locker(&g_remeshMutex);
+    // The wait for another remesh can be long, check again before starting this one
+    if (isCancelled())
+        return;
     const Dust3D_InstantMeshesVertex *resultVertices = nullptr;
     size_t nResultVertices = 0;
     const Dust3D_InstantMeshesTriangle *resultTriangles = nullptr;
     size_t nResultTriangles = 0;
     const Dust3D_InstantMeshesQuad *resultQuads = nullptr;
     size_t nResultQuads = 0;
-    Dust3D_instantMeshesRemesh(inputVertices.data(), inputVertices.size(),
-        inputTriangles.data(), inputTriangles.size(),
-        (size_t)(targetVertexMultiplyFactor * 30 * std::sqrt(totalArea) / 0.02f),
-        &resultVertices,
-        &nResultVertices,
-        &resultTriangles,
-        &nResultTriangles,
-        &resultQuads,
-        &nResultQuads);
+    g_remeshArena.execute([&]() {
+        Dust3D_instantMeshesRemesh(inputVertices.data(), inputVertices.size(),
+            inputTriangles.data(), inputTriangles.size(),
+            (size_t)(targetVertexMultiplyFactor * 30 * std::sqrt(totalArea) / 0.02f),
+            &resultVertices,
+            &nResultVertices,
+            &resultTriangles,
+            &nResultTriangles,
+            &resultQuads,
+            &nResultQuads);
+    });
     m_remeshedVertices.resize(nResultVertices);
     memcpy(m_remeshedVertices.data(), resultVertices, sizeof(Dust3D_InstantMeshesVertex) * nResultVertices);
     m_remeshedFaces.reserve(nResultTriangles + nResultQuads);
@@ -93,6 +121,9 @@ void Remesher::remesh(float targetVertexMultiplyFactor)
             source.indices[3]
         });
     }
+    locker.unlock();
+    if (isCancelled())
+        return;
     resolveSources();
 }
 
@@ -4,6 +4,7 @@
 #include <vector>
 #include <QVector3D>
 #include <QUuid>
+#include <atomic>
 
 class Remesher : public QObject
 {
@@ -15,6 +16,7 @@ public:
         const std::vector<std::vector<size_t>> &triangles);
     void setNodes(const std::vector<std::pair<QVector3D, float>> &nodes,
         const std::vector<std::pair<QUuid, QUuid>> &sourceIds);
+    void setCancelFlag(const std::atomic<bool> *cancelled);
     void remesh(float targetVertexMultiplyFactor);
     const std::vector<QVector3D> &getRemeshedVertices() const;
     const std::vector<std::vector<size_t>> &getRemeshedFaces() const;
@@ -27,6 +29,8 @@ private:
     std::vector<std::pair<QUuid, QUuid>> m_remeshedVertexSources;
     std::vector<std::pair<QVector3D, float>> m_nodes;
     std::vector<std::pair<QUuid, QUuid>> m_sourceIds;
+    const std::atomic<bool> *m_cancelled = nullptr;
+    bool isCancelled() const;
     void resolveSources();
 };
 
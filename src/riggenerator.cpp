@@ -10,6 +10,7 @@
 #include "riggenerator.h"
 #include "util.h"
 #include "boundingboxmesh.h"
+#include "profiler.h"
 #include "theme.h"
 
 class GroupEndpointsStitcher
@@ -61,23 +62,26 @@ private:
 
 RigGenerator::RigGenerator(RigType rigType, const Outcome &outcome) :
     m_rigType(rigType),
-    m_outcome(new Outcome(outcome))
+    m_outcome(std::make_shared<Outcome>(outcome))
+{
+}
+
+RigGenerator::RigGenerator(RigType rigType, const std::shared_ptr<const Outcome> &outcome) :
+    m_rigType(rigType),
+    m_outcome(outcome)
 {
 }
 
 RigGenerator::~RigGenerator()
 {
-    delete m_outcome;
     delete m_resultMesh;
     delete m_resultBones;
     delete m_resultWeights;
 }
 
-Outcome *RigGenerator::takeOutcome()
+std::shared_ptr<const Outcome> RigGenerator::outcome() const
 {
-    Outcome *outcome = m_outcome;
-    m_outcome = nullptr;
-    return outcome;
+    return m_outcome;
 }
 
 std::vector<RiggerBone> *RigGenerator::takeResultBones()
@@ -1128,6 +1132,8 @@ void RigGenerator::buildDemoMesh()
 
 void RigGenerator::generate()
 {
+    Profiler::Scope profile("rig", "post");
+    
     buildNeighborMap();
     buildBoneNodeChain();
     buildSkeleton();
@@ -4,6 +4,7 @@
 #include <QThread>
 #include <QDebug>
 #include <unordered_set>
+#include <memory>
 #include "outcome.h"
 #include "meshloader.h"
 #include "rigger.h"
@@ -14,12 +15,13 @@ class RigGenerator : public QObject
     Q_OBJECT
 public:
     RigGenerator(RigType rigType, const Outcome &outcome);
+    RigGenerator(RigType rigType, const std::shared_ptr<const Outcome> &outcome);
     ~RigGenerator();
     MeshLoader *takeResultMesh();
     std::vector<RiggerBone> *takeResultBones();
     std::map<int, RiggerVertexWeights> *takeResultWeights();
     const std::vector<std::pair<QtMsgType, QString>> &messages();
-    Outcome *takeOutcome();
+    std::shared_ptr<const Outcome> outcome() const;
     bool isSucceed();
     void generate();
 signals:
@@ -36,7 +38,7 @@ private:
     };
     
     RigType m_rigType = RigType::None;
-    Outcome *m_outcome = nullptr;
+    std::shared_ptr<const Outcome> m_outcome;
     MeshLoader *m_resultMesh = nullptr;
     std::vector<RiggerBone> *m_resultBones = nullptr;
     std::map<int, RiggerVertexWeights> *m_resultWeights = nullptr;
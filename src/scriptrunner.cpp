@@ -1,4 +1,5 @@
 #include <QDebug>
+#include <QGuiApplication>
 #include <QElapsedTimer>
 #include <QUuid>
 #include <QFile>
@@ -849,6 +850,7 @@ int ScriptRunner::createSelectInput(const QString &name, int defaultSelectedInde
 void ScriptRunner::process()
 {
     run();
+    this->moveToThread(QGuiApplication::instance()->thread());
     emit finished();
 }
 
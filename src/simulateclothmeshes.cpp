@@ -4,16 +4,17 @@
 #include "positionkey.h"
 #include "util.h"
 #include "clothsimulator.h"
+#include "clothcollision.h"
 
 class ClothMeshesSimulator
 {
 public:
     ClothMeshesSimulator(std::vector<ClothMesh> *clothMeshes,
-            const std::vector<QVector3D> *clothCollisionVertices,
-            const std::vector<std::vector<size_t>> *clothCollisionTriangles) :
+            const ClothCollision *clothCollision,
+            const std::atomic<bool> *cancelled) :
         m_clothMeshes(clothMeshes),
-        m_clothCollisionVertices(clothCollisionVertices),
-        m_clothCollisionTriangles(clothCollisionTriangles)
+        m_clothCollision(clothCollision),
+        m_cancelled(cancelled)
     {
     }
     void simulate(ClothMesh *clothMesh) const
@@ -60,13 +61,15 @@ public:
         }
         ClothSimulator clothSimulator(filteredClothVertices,
             filteredClothFaces,
-            *m_clothCollisionVertices,
-            *m_clothCollisionTriangles,
+            m_clothCollision,
             externalForces);
         clothSimulator.setStiffness(clothMesh->clothStiffness);
         clothSimulator.create();
-        for (size_t i = 0; i < clothMesh->clothIteration; ++i)
+        for (size_t i = 0; i < clothMesh->clothIteration; ++i) {
+            if (nullptr != m_cancelled && *m_cancelled)
+                return;
             clothSimulator.step();
+        }
         clothSimulator.getCurrentVertices(&filteredClothVertices);
         for (size_t i = 0; i < filteredClothVertices.size(); ++i) {
             filteredClothVertices[i] -= postProcessDirections[i];
@@ -80,16 +83,19 @@ public:
     }
 private:
     std::vector<ClothMesh> *m_clothMeshes = nullptr;
-    const std::vector<QVector3D> *m_clothCollisionVertices = nullptr;
-    const std::vector<std::vector<size_t>> *m_clothCollisionTriangles = nullptr;
+    const ClothCollision *m_clothCollision = nullptr;
+    const std::atomic<bool> *m_cancelled = nullptr;
 };
 
 void simulateClothMeshes(std::vector<ClothMesh> *clothMeshes,
     const std::vector<QVector3D> *clothCollisionVertices,
-    const std::vector<std::vector<size_t>> *clothCollisionTriangles)
+    const std::vector<std::vector<size_t>> *clothCollisionTriangles,
+    const std::atomic<bool> *cancelled)
 {
+    // The body collision is built once and shared read-only by all the cloth meshes
+    ClothCollision clothCollision(*clothCollisionVertices, *clothCollisionTriangles);
     tbb::parallel_for(tbb::blocked_range<size_t>(0, clothMeshes->size()),
         ClothMeshesSimulator(clothMeshes,
-            clothCollisionVertices,
-            clothCollisionTriangles));
+            &clothCollision,
+            cancelled));
 }
@@ -3,6 +3,7 @@
 #include <QVector3D>
 #include <vector>
 #include <QUuid>
+#include <atomic>
 #include "clothforce.h"
 
 struct ClothMesh
@@ -19,6 +20,7 @@ struct ClothMesh
 
 void simulateClothMeshes(std::vector<ClothMesh> *clothMeshes,
     const std::vector<QVector3D> *clothCollisionVertices,
-    const std::vector<std::vector<size_t>> *clothCollisionTriangles);
+    const std::vector<std::vector<size_t>> *clothCollisionTriangles,
+    const std::atomic<bool> *cancelled=nullptr);
 
 #endif
@@ -1,24 +1,39 @@
+#include <cstring>
+#include <tuple>
 #include "skinnedmeshcreator.h"
 #include "theme.h"
 
 SkinnedMeshCreator::SkinnedMeshCreator(const Outcome &outcome,
-        const std::map<int, RiggerVertexWeights> &resultWeights) :
-    m_outcome(outcome),
-    m_resultWeights(resultWeights)
+        const std::map<int, RiggerVertexWeights> &resultWeights)
 {
-    m_verticesOldIndices.resize(m_outcome.triangles.size());
-    m_verticesBindNormals.resize(m_outcome.triangles.size());
-    m_verticesBindPositions.resize(m_outcome.triangles.size());
-    const std::vector<std::vector<QVector3D>> *triangleVertexNormals = m_outcome.triangleVertexNormals();
-    for (size_t triangleIndex = 0; triangleIndex < m_outcome.triangles.size(); triangleIndex++) {
+    // Corners sharing the same vertex and normal are skinned only once
+    auto floatBits = [](float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    };
+    const RiggerVertexWeights noWeights;
+    std::map<std::tuple<size_t, uint32_t, uint32_t, uint32_t>, uint32_t> cornerToVertexMap;
+    const std::vector<std::vector<QVector3D>> *triangleVertexNormals = outcome.triangleVertexNormals();
+    m_skinning.reserve(outcome.vertices.size());
+    m_cornerVertices.reserve(outcome.triangles.size() * 3);
+    for (size_t triangleIndex = 0; triangleIndex < outcome.triangles.size(); triangleIndex++) {
         for (int j = 0; j < 3; j++) {
-            int oldIndex = m_outcome.triangles[triangleIndex][j];
-            m_verticesOldIndices[triangleIndex].push_back(oldIndex);
-            m_verticesBindPositions[triangleIndex].push_back(m_outcome.vertices[oldIndex]);
+            size_t oldIndex = outcome.triangles[triangleIndex][j];
+            QVector3D normal;
             if (nullptr != triangleVertexNormals)
-                m_verticesBindNormals[triangleIndex].push_back((*triangleVertexNormals)[triangleIndex][j]);
-            else
-                m_verticesBindNormals[triangleIndex].push_back(QVector3D());
+                normal = (*triangleVertexNormals)[triangleIndex][j];
+            auto key = std::make_tuple(oldIndex, floatBits(normal.x()), floatBits(normal.y()), floatBits(normal.z()));
+            auto findVertex = cornerToVertexMap.find(key);
+            if (findVertex != cornerToVertexMap.end()) {
+                m_cornerVertices.push_back(findVertex->second);
+                continue;
+            }
+            auto findWeights = resultWeights.find((int)oldIndex);
+            uint32_t vertexIndex = (uint32_t)m_skinning.addVertex(outcome.vertices[oldIndex], normal,
+                findWeights == resultWeights.end() ? noWeights : findWeights->second);
+            cornerToVertexMap.insert({key, vertexIndex});
+            m_cornerVertices.push_back(vertexIndex);
         }
     }
     
@@ -26,58 +41,48 @@ SkinnedMeshCreator::SkinnedMeshCreator(const Outcome &outcome,
     for (const auto &node: outcome.nodes)
         sourceNodeToColorMap.insert({{node.partId, node.nodeId}, node.color});
     
-    m_triangleColors.resize(m_outcome.triangles.size(), Theme::white);
+    m_triangleColors.resize(outcome.triangles.size(), Theme::white);
     const std::vector<std::pair<QUuid, QUuid>> *triangleSourceNodes = outcome.triangleSourceNodes();
     if (nullptr != triangleSourceNodes) {
-        for (size_t triangleIndex = 0; triangleIndex < m_outcome.triangles.size(); triangleIndex++) {
+        for (size_t triangleIndex = 0; triangleIndex < outcome.triangles.size(); triangleIndex++) {
             const auto &source = (*triangleSourceNodes)[triangleIndex];
             m_triangleColors[triangleIndex] = sourceNodeToColorMap[source];
         }
     }
 }
 
-MeshLoader *SkinnedMeshCreator::createMeshFromTransform(const std::vector<QMatrix4x4> &matricies)
+MeshLoader *SkinnedMeshCreator::createMeshFromTransform(const std::vector<QMatrix4x4> &matricies) const
 {
-    std::vector<std::vector<QVector3D>> transformedPositions = m_verticesBindPositions;
-    std::vector<std::vector<QVector3D>> transformedPoseNormals = m_verticesBindNormals;
-    
-    if (!matricies.empty()) {
-        for (size_t i = 0; i < transformedPositions.size(); ++i) {
-            for (size_t j = 0; j < 3; ++j) {
-                const auto &weight = m_resultWeights[m_verticesOldIndices[i][j]];
-                QMatrix4x4 mixedMatrix;
-                transformedPositions[i][j] = QVector3D();
-                transformedPoseNormals[i][j] = QVector3D();
-                for (int x = 0; x < 4; x++) {
-                    float factor = weight.boneWeights[x];
-                    if (factor > 0) {
-                        transformedPositions[i][j] += matricies[weight.boneIndices[x]] * m_verticesBindPositions[i][j] * factor;
-                        transformedPoseNormals[i][j] += matricies[weight.boneIndices[x]] * m_verticesBindNormals[i][j] * factor;
-                    }
-                }
-            }
-        }
-    }
+    std::vector<float> transformedPositions;
+    std::vector<float> transformedPoseNormals;
+    if (!matricies.empty())
+        m_skinning.skin(matricies, &transformedPositions, &transformedPoseNormals);
+    else
+        m_skinning.bind(&transformedPositions, &transformedPoseNormals);
     
-    ShaderVertex *triangleVertices = new ShaderVertex[m_outcome.triangles.size() * 3];
+    ShaderVertex *triangleVertices = new ShaderVertex[m_cornerVertices.size()];
     int triangleVerticesNum = 0;
-    for (size_t triangleIndex = 0; triangleIndex < m_outcome.triangles.size(); triangleIndex++) {
+    for (size_t triangleIndex = 0; triangleIndex < m_triangleColors.size(); triangleIndex++) {
+        const auto &sourceColor = m_triangleColors[triangleIndex];
+        float colorR = sourceColor.redF();
+        float colorG = sourceColor.greenF();
+        float colorB = sourceColor.blueF();
         for (int i = 0; i < 3; i++) {
             ShaderVertex &currentVertex = triangleVertices[triangleVerticesNum++];
-            const auto &sourcePosition = transformedPositions[triangleIndex][i];
-            const auto &sourceColor = m_triangleColors[triangleIndex];
-            const auto &sourceNormal = transformedPoseNormals[triangleIndex][i];
-            currentVertex.posX = sourcePosition.x();
-            currentVertex.posY = sourcePosition.y();
-            currentVertex.posZ = sourcePosition.z();
+            size_t vertexIndex = m_cornerVertices[triangleIndex * 3 + i];
+            const float *sourcePosition = &transformedPositions[vertexIndex * 4];
+            const float *sourceNormal = &transformedPoseNormals[vertexIndex * 4];
+            currentVertex.posX = sourcePosition[0];
+            currentVertex.posY = sourcePosition[1];
+            currentVertex.posZ = sourcePosition[2];
             currentVertex.texU = 0;
             currentVertex.texV = 0;
-            currentVertex.colorR = sourceColor.redF();
-            currentVertex.colorG = sourceColor.greenF();
-            currentVertex.colorB = sourceColor.blueF();
-            currentVertex.normX = sourceNormal.x();
-            currentVertex.normY = sourceNormal.y();
-            currentVertex.normZ = sourceNormal.z();
+            currentVertex.colorR = colorR;
+            currentVertex.colorG = colorG;
+            currentVertex.colorB = colorB;
+            currentVertex.normX = sourceNormal[0];
+            currentVertex.normY = sourceNormal[1];
+            currentVertex.normZ = sourceNormal[2];
             currentVertex.metalness = MeshLoader::m_defaultMetalness;
             currentVertex.roughness = MeshLoader::m_defaultRoughness;
         }
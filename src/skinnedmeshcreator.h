@@ -7,19 +7,17 @@
 #include "meshloader.h"
 #include "outcome.h"
 #include "jointnodetree.h"
+#include "linearblendskinning.h"
 
 class SkinnedMeshCreator
 {
 public:
     SkinnedMeshCreator(const Outcome &outcome,
         const std::map<int, RiggerVertexWeights> &resultWeights);
-    MeshLoader *createMeshFromTransform(const std::vector<QMatrix4x4> &matricies);
+    MeshLoader *createMeshFromTransform(const std::vector<QMatrix4x4> &matricies) const;
 private:
-    Outcome m_outcome;
-    std::map<int, RiggerVertexWeights> m_resultWeights;
-    std::vector<std::vector<int>> m_verticesOldIndices;
-    std::vector<std::vector<QVector3D>> m_verticesBindPositions;
-    std::vector<std::vector<QVector3D>> m_verticesBindNormals;
+    LinearBlendSkinning m_skinning;
+    std::vector<uint32_t> m_cornerVertices;
     std::vector<QColor> m_triangleColors;
 };
 
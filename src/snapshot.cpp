@@ -53,3 +53,44 @@ void Snapshot::resolveBoundingBox(QRectF *mainProfile, QRectF *sideProfile, cons
 }
 
 
+
+void Snapshot::resolveTables()
+{
+    // Snapshots loaded from files or generated by scripts only come with the attribute maps
+    if (tablesResolved)
+        return;
+    nodeTable = SnapshotNodeTable();
+    edgeTable = SnapshotEdgeTable();
+    for (const auto &nodeIt: nodes) {
+        const auto &node = nodeIt.second;
+        bool hasCutFace = false;
+        QString cutFace;
+        float cutRotation = 0;
+        const auto &cutFaceIt = node.find("cutFace");
+        if (cutFaceIt != node.end()) {
+            cutFace = cutFaceIt->second;
+            hasCutFace = true;
+            const auto &cutRotationIt = node.find("cutRotation");
+            if (cutRotationIt != node.end())
+                cutRotation = cutRotationIt->second.toFloat();
+        }
+        nodeTable.add(QUuid(nodeIt.first),
+            QUuid(valueOfKeyInMapOrEmpty(node, "partId")),
+            valueOfKeyInMapOrEmpty(node, "radius").toFloat(),
+            valueOfKeyInMapOrEmpty(node, "x").toFloat(),
+            valueOfKeyInMapOrEmpty(node, "y").toFloat(),
+            valueOfKeyInMapOrEmpty(node, "z").toFloat(),
+            BoneMarkFromString(valueOfKeyInMapOrEmpty(node, "boneMark").toUtf8().constData()),
+            hasCutFace,
+            cutFace,
+            cutRotation);
+    }
+    for (const auto &edgeIt: edges) {
+        const auto &edge = edgeIt.second;
+        edgeTable.add(QUuid(edgeIt.first),
+            QUuid(valueOfKeyInMapOrEmpty(edge, "partId")),
+            QUuid(valueOfKeyInMapOrEmpty(edge, "from")),
+            QUuid(valueOfKeyInMapOrEmpty(edge, "to")));
+    }
+    tablesResolved = true;
+}
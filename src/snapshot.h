@@ -5,10 +5,71 @@
 #include <QString>
 #include <QRectF>
 #include <QSizeF>
+#include <QUuid>
+#include "bonemark.h"
 extern "C" {
 #include <crc64.h>
 }
 
+// Typed columns of the nodes and edges, filled alongside the attribute maps,
+// so the mesh generation does not parse numbers and ids out of strings
+class SnapshotNodeTable
+{
+public:
+    std::vector<QUuid> ids;
+    std::vector<QUuid> partIds;
+    std::vector<float> radiuses;
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<float> zs;
+    std::vector<BoneMark> boneMarks;
+    std::vector<bool> hasCutFaces;
+    std::vector<QString> cutFaces;
+    std::vector<float> cutRotations;
+    
+    size_t size() const
+    {
+        return ids.size();
+    }
+    
+    void add(const QUuid &id, const QUuid &partId, float radius, float x, float y, float z,
+        BoneMark boneMark=BoneMark::None, bool hasCutFace=false, const QString &cutFace=QString(), float cutRotation=0)
+    {
+        ids.push_back(id);
+        partIds.push_back(partId);
+        radiuses.push_back(radius);
+        xs.push_back(x);
+        ys.push_back(y);
+        zs.push_back(z);
+        boneMarks.push_back(boneMark);
+        hasCutFaces.push_back(hasCutFace);
+        cutFaces.push_back(cutFace);
+        cutRotations.push_back(cutRotation);
+    }
+};
+
+class SnapshotEdgeTable
+{
+public:
+    std::vector<QUuid> ids;
+    std::vector<QUuid> partIds;
+    std::vector<QUuid> fromNodeIds;
+    std::vector<QUuid> toNodeIds;
+    
+    size_t size() const
+    {
+        return ids.size();
+    }
+    
+    void add(const QUuid &id, const QUuid &partId, const QUuid &fromNodeId, const QUuid &toNodeId)
+    {
+        ids.push_back(id);
+        partIds.push_back(partId);
+        fromNodeIds.push_back(fromNodeId);
+        toNodeIds.push_back(toNodeId);
+    }
+};
+
 class Snapshot
 {
 public:
@@ -21,6 +82,9 @@ public:
     std::vector<std::pair<std::map<QString, QString>, std::vector<std::pair<std::map<QString, QString>, std::map<QString, std::map<QString, QString>>>>>> poses; // std::pair<Pose attributes, frames> frame: std::pair<Frame attributes, Frame parameters>
     std::vector<std::pair<std::map<QString, QString>, std::vector<std::map<QString, QString>>>> motions; // std::pair<Motion attributes, clips>
     std::vector<std::pair<std::map<QString, QString>, std::vector<std::pair<std::map<QString, QString>, std::vector<std::map<QString, QString>>>>>> materials; // std::pair<Material attributes, layers>  layer: std::pair<Layer attributes, maps>
+    SnapshotNodeTable nodeTable;
+    SnapshotEdgeTable edgeTable;
+    bool tablesResolved = false;
     
     uint64_t hash() const
     {
@@ -118,6 +182,7 @@ public:
         return crc64(0, buffer.data(), buffer.size());
     }
 
+    void resolveTables();
     void resolveBoundingBox(QRectF *mainProfile, QRectF *sideProfile, const QString &partId=QString()) const;
 };
 
@@ -1,18 +1,73 @@
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 #include <QPainter>
 #include <QGuiApplication>
 #include <QRegion>
 #include <QPolygon>
 #include <QElapsedTimer>
 #include <QRadialGradient>
+#include <functional>
 #include "texturegenerator.h"
 #include "theme.h"
 #include "util.h"
+#include "profiler.h"
 #include "texturetype.h"
 #include "material.h"
 #include "preferences.h"
 
 QColor TextureGenerator::m_defaultTextureColor = Qt::transparent;
 
+class MetalnessRoughnessAmbientOcclusionMerger
+{
+public:
+    MetalnessRoughnessAmbientOcclusionMerger(const QImage *metalnessImage,
+            const QImage *roughnessImage,
+            const QImage *ambientOcclusionImage,
+            QImage *targetImage) :
+        m_metalnessBits(nullptr == metalnessImage ? nullptr : metalnessImage->constBits()),
+        m_roughnessBits(nullptr == roughnessImage ? nullptr : roughnessImage->constBits()),
+        m_ambientOcclusionBits(nullptr == ambientOcclusionImage ? nullptr : ambientOcclusionImage->constBits()),
+        m_targetBits(targetImage->bits()),
+        m_bytesPerLine(targetImage->bytesPerLine()),
+        m_width(targetImage->width())
+    {
+    }
+    void operator()(const tbb::blocked_range<size_t> &range) const
+    {
+        for (size_t row = range.begin(); row != range.end(); ++row) {
+            size_t offset = row * m_bytesPerLine;
+            // Same as QColor(255, 255, 0), channels without a source map keep these defaults
+            QRgb *target = (QRgb *)(m_targetBits + offset);
+            for (int col = 0; col < m_width; ++col)
+                target[col] = 0xffffff00;
+            if (nullptr != m_metalnessBits)
+                mergeChannel((const QRgb *)(m_metalnessBits + offset), 0, target, m_width);
+            if (nullptr != m_roughnessBits)
+                mergeChannel((const QRgb *)(m_roughnessBits + offset), 8, target, m_width);
+            if (nullptr != m_ambientOcclusionBits)
+                mergeChannel((const QRgb *)(m_ambientOcclusionBits + offset), 16, target, m_width);
+        }
+    }
+private:
+    const uchar *m_metalnessBits = nullptr;
+    const uchar *m_roughnessBits = nullptr;
+    const uchar *m_ambientOcclusionBits = nullptr;
+    uchar *m_targetBits = nullptr;
+    size_t m_bytesPerLine = 0;
+    int m_width = 0;
+    
+    // Branch free loop over raw ARGB32 pixels, the gray formula is the one qGray() uses
+    static void mergeChannel(const QRgb *source, int shift, QRgb *target, int width)
+    {
+        const QRgb mask = ~((QRgb)0xff << shift);
+        for (int col = 0; col < width; ++col) {
+            QRgb pixel = source[col];
+            QRgb gray = (((pixel >> 16) & 0xff) * 11 + ((pixel >> 8) & 0xff) * 16 + (pixel & 0xff) * 5) / 32;
+            target[col] = (target[col] & mask) | (gray << shift);
+        }
+    }
+};
+
 TextureGenerator::TextureGenerator(const Outcome &outcome, Snapshot *snapshot) :
     m_resultTextureGuideImage(nullptr),
     m_resultTextureImage(nullptr),
@@ -197,7 +252,7 @@ void TextureGenerator::prepare()
                 materialId = findUpdatedMaterialIdResult->second;
             float tileScale = 1.0;
             initializeMaterialTexturesFromSnapshot(*m_snapshot, materialId, materialTextures, tileScale);
-            const QImage *image = materialTextures.textureImages[i];
+            const QImage *image = materialTextures.textureImages[i].get();
             if (nullptr != image) {
                 if (TextureType::BaseColor == forWhat)
                     addPartColorMap(bmeshNode.partId, image, tileScale);
@@ -221,6 +276,8 @@ bool TextureGenerator::hasTransparencySettings()
 
 void TextureGenerator::generate()
 {
+    Profiler::Scope profile("texture", "post");
+    
     m_resultMesh = new MeshLoader(*m_outcome);
     
     if (nullptr == m_outcome->triangleVertexUvs())
@@ -258,88 +315,33 @@ void TextureGenerator::generate()
         partColorSolubilityMap.insert({item.partId, item.colorSolubility});
     }
     
-    auto createImageBeginTime = countTimeConsumed.elapsed();
-    
-    m_resultTextureColorImage = new QImage(TextureGenerator::m_textureSize, TextureGenerator::m_textureSize, QImage::Format_ARGB32);
-    m_resultTextureColorImage->fill(m_hasTransparencySettings ? m_defaultTextureColor : Qt::white);
-    
-    m_resultTextureBorderImage = new QImage(TextureGenerator::m_textureSize, TextureGenerator::m_textureSize, QImage::Format_ARGB32);
-    m_resultTextureBorderImage->fill(Qt::transparent);
-    
-    m_resultTextureNormalImage = new QImage(TextureGenerator::m_textureSize, TextureGenerator::m_textureSize, QImage::Format_ARGB32);
-    m_resultTextureNormalImage->fill(QColor(128, 128, 255));
-    
-    m_resultTextureMetalnessRoughnessAmbientOcclusionImage = new QImage(TextureGenerator::m_textureSize, TextureGenerator::m_textureSize, QImage::Format_ARGB32);
-    m_resultTextureMetalnessRoughnessAmbientOcclusionImage->fill(QColor(255, 255, 0));
-    
-    m_resultTextureMetalnessImage = new QImage(TextureGenerator::m_textureSize, TextureGenerator::m_textureSize, QImage::Format_ARGB32);
-    m_resultTextureMetalnessImage->fill(Qt::black);
-    
-    m_resultTextureRoughnessImage = new QImage(TextureGenerator::m_textureSize, TextureGenerator::m_textureSize, QImage::Format_ARGB32);
-    m_resultTextureRoughnessImage->fill(Qt::white);
-    
-    m_resultTextureAmbientOcclusionImage = new QImage(TextureGenerator::m_textureSize, TextureGenerator::m_textureSize, QImage::Format_ARGB32);
-    m_resultTextureAmbientOcclusionImage->fill(Qt::white);
-    
-    auto createImageEndTime = countTimeConsumed.elapsed();
-    
-    QColor borderColor = Qt::darkGray;
-    QPen pen(borderColor);
-    
-    QPainter texturePainter;
-    texturePainter.begin(m_resultTextureColorImage);
-    texturePainter.setRenderHint(QPainter::Antialiasing);
-    texturePainter.setRenderHint(QPainter::HighQualityAntialiasing);
-    
-    QPainter textureBorderPainter;
-    textureBorderPainter.begin(m_resultTextureBorderImage);
-    textureBorderPainter.setRenderHint(QPainter::Antialiasing);
-    textureBorderPainter.setRenderHint(QPainter::HighQualityAntialiasing);
-    
-    QPainter textureNormalPainter;
-    textureNormalPainter.begin(m_resultTextureNormalImage);
-    textureNormalPainter.setRenderHint(QPainter::Antialiasing);
-    textureNormalPainter.setRenderHint(QPainter::HighQualityAntialiasing);
-    
-    QPainter textureMetalnessPainter;
-    textureMetalnessPainter.begin(m_resultTextureMetalnessImage);
-    textureMetalnessPainter.setRenderHint(QPainter::Antialiasing);
-    textureMetalnessPainter.setRenderHint(QPainter::HighQualityAntialiasing);
-    
-    QPainter textureRoughnessPainter;
-    textureRoughnessPainter.begin(m_resultTextureRoughnessImage);
-    textureRoughnessPainter.setRenderHint(QPainter::Antialiasing);
-    textureRoughnessPainter.setRenderHint(QPainter::HighQualityAntialiasing);
+    hasNormalMap = !m_partNormalTextureMap.empty();
+    hasMetalnessMap = !m_partMetalnessTextureMap.empty();
+    hasRoughnessMap = !m_partRoughnessTextureMap.empty();
+    hasAmbientOcclusionMap = !m_partAmbientOcclusionTextureMap.empty();
+    bool hasMetalnessRoughnessAmbientOcclusionMap = hasMetalnessMap || hasRoughnessMap || hasAmbientOcclusionMap;
     
-    QPainter textureAmbientOcclusionPainter;
-    textureAmbientOcclusionPainter.begin(m_resultTextureAmbientOcclusionImage);
-    textureAmbientOcclusionPainter.setRenderHint(QPainter::Antialiasing);
-    textureAmbientOcclusionPainter.setRenderHint(QPainter::HighQualityAntialiasing);
+    auto createTextureImage = [&](const QColor &color) {
+        QImage *image = new QImage(TextureGenerator::m_textureSize, TextureGenerator::m_textureSize, QImage::Format_ARGB32);
+        image->fill(color);
+        return image;
+    };
     
-    auto paintTextureBeginTime = countTimeConsumed.elapsed();
-    texturePainter.setPen(Qt::NoPen);
+    auto beginPainter = [](QPainter &painter, QImage *image) {
+        painter.begin(image);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setRenderHint(QPainter::HighQualityAntialiasing);
+    };
     
-    for (const auto &it: partUvRects) {
-        const auto &partId = it.first;
-        const auto &rects = it.second;
-        auto findSourceColorResult = partColorMap.find(partId);
-        if (findSourceColorResult != partColorMap.end()) {
-            const auto &color = findSourceColorResult->second;
-            QBrush brush(color);
-            float fillExpandSize = 2;
-            for (const auto &rect: rects) {
-                QRectF translatedRect = {
-                    rect.left() * TextureGenerator::m_textureSize - fillExpandSize,
-                    rect.top() * TextureGenerator::m_textureSize - fillExpandSize,
-                    rect.width() * TextureGenerator::m_textureSize + fillExpandSize * 2,
-                    rect.height() * TextureGenerator::m_textureSize + fillExpandSize * 2
-                };
-                texturePainter.fillRect(translatedRect, brush);
-            }
-        }
-    }
+    // QPixmap needs a GUI application and is not safe outside the GUI thread,
+    // so the tiles are drawn from QImage backed brushes instead
+    auto drawTiledImage = [](QPainter &painter, const QRectF &rect, const QImage &image, const QPointF &offset) {
+        QBrush brush(image);
+        brush.setTransform(QTransform::fromTranslate(rect.left() - offset.x(), rect.top() - offset.y()));
+        painter.fillRect(rect, brush);
+    };
     
-    auto drawTexture = [&](const std::map<QUuid, std::pair<QPixmap, QPixmap>> &map, QPainter &painter, bool useAlpha) {
+    auto drawTexture = [&](const std::map<QUuid, std::pair<QImage, QImage>> &map, QPainter &painter, bool useAlpha) {
         for (const auto &it: partUvRects) {
             const auto &partId = it.first;
             const auto &rects = it.second;
@@ -353,8 +355,8 @@ void TextureGenerator::generate()
             }
             auto findTextureResult = map.find(partId);
             if (findTextureResult != map.end()) {
-                const auto &pixmap = findTextureResult->second.first;
-                const auto &rotatedPixmap = findTextureResult->second.second;
+                const auto &image = findTextureResult->second.first;
+                const auto &rotatedImage = findTextureResult->second.second;
                 painter.setOpacity(alpha);
                 for (const auto &rect: rects) {
                     QRectF translatedRect = {
@@ -364,9 +366,9 @@ void TextureGenerator::generate()
                         rect.height() * TextureGenerator::m_textureSize
                     };
                     if (translatedRect.width() < translatedRect.height()) {
-                        painter.drawTiledPixmap(translatedRect, rotatedPixmap, QPointF(rect.top(), rect.left()));
+                        drawTiledImage(painter, translatedRect, rotatedImage, QPointF(rect.top(), rect.left()));
                     } else {
-                        painter.drawTiledPixmap(translatedRect, pixmap, rect.topLeft());
+                        drawTiledImage(painter, translatedRect, image, rect.topLeft());
                     }
                 }
                 painter.setOpacity(1.0);
@@ -374,8 +376,8 @@ void TextureGenerator::generate()
         }
     };
     
-    auto convertTextureImageToPixmap = [&](const std::map<QUuid, std::pair<QImage, float>> &sourceMap,
-            std::map<QUuid, std::pair<QPixmap, QPixmap>> &targetMap) {
+    auto prepareTiledTextureImage = [&](const std::map<QUuid, std::pair<QImage, float>> &sourceMap,
+            std::map<QUuid, std::pair<QImage, QImage>> &targetMap) {
         for (const auto &it: sourceMap) {
             float tileScale = it.second.second;
             const auto &image = it.second.first;
@@ -386,28 +388,12 @@ void TextureGenerator::generate()
             matrix.translate(center.x(), center.y());
             matrix.rotate(90);
             auto rotatedImage = scaledImage.transformed(matrix).mirrored(true, false);
-            targetMap[it.first] = std::make_pair(QPixmap::fromImage(scaledImage),
-                QPixmap::fromImage(rotatedImage));
+            targetMap[it.first] = std::make_pair(scaledImage, rotatedImage);
         }
     };
     
-    std::map<QUuid, std::pair<QPixmap, QPixmap>> partColorTexturePixmaps;
-    std::map<QUuid, std::pair<QPixmap, QPixmap>> partNormalTexturePixmaps;
-    std::map<QUuid, std::pair<QPixmap, QPixmap>> partMetalnessTexturePixmaps;
-    std::map<QUuid, std::pair<QPixmap, QPixmap>> partRoughnessTexturePixmaps;
-    std::map<QUuid, std::pair<QPixmap, QPixmap>> partAmbientOcclusionTexturePixmaps;
-    
-    convertTextureImageToPixmap(m_partColorTextureMap, partColorTexturePixmaps);
-    convertTextureImageToPixmap(m_partNormalTextureMap, partNormalTexturePixmaps);
-    convertTextureImageToPixmap(m_partMetalnessTextureMap, partMetalnessTexturePixmaps);
-    convertTextureImageToPixmap(m_partRoughnessTextureMap, partRoughnessTexturePixmaps);
-    convertTextureImageToPixmap(m_partAmbientOcclusionTextureMap, partAmbientOcclusionTexturePixmaps);
-    
-    drawTexture(partColorTexturePixmaps, texturePainter, true);
-    drawTexture(partNormalTexturePixmaps, textureNormalPainter, false);
-    drawTexture(partMetalnessTexturePixmaps, textureMetalnessPainter, false);
-    drawTexture(partRoughnessTexturePixmaps, textureRoughnessPainter, false);
-    drawTexture(partAmbientOcclusionTexturePixmaps, textureAmbientOcclusionPainter, false);
+    std::map<QUuid, std::pair<QImage, QImage>> partColorTextureImages;
+    QPainter texturePainter;
     
     auto drawBySolubility = [&](const QUuid &partId, size_t triangleIndex, size_t firstVertexIndex, size_t secondVertexIndex,
             const QUuid &neighborPartId) {
@@ -452,23 +438,23 @@ void TextureGenerator::generate()
                     clippedRect.height() * TextureGenerator::m_textureSize
                 };
                 texturePainter.setOpacity(alpha);
-                auto findTextureResult = partColorTexturePixmaps.find(neighborPartId);
-                if (findTextureResult != partColorTexturePixmaps.end()) {
-                    const auto &pixmap = findTextureResult->second.first;
-                    const auto &rotatedPixmap = findTextureResult->second.second;
+                auto findTextureResult = partColorTextureImages.find(neighborPartId);
+                if (findTextureResult != partColorTextureImages.end()) {
+                    const auto &image = findTextureResult->second.first;
+                    const auto &rotatedImage = findTextureResult->second.second;
                     
                     QImage tmpImage(translatedRect.width(), translatedRect.height(), QImage::Format_ARGB32);
-                    QPixmap tmpPixmap = QPixmap::fromImage(tmpImage);
+                    tmpImage.fill(Qt::transparent);
                     QPainter tmpPainter;
                     QRectF tmpImageFrame = QRectF(0, 0, translatedRect.width(), translatedRect.height());
                     
                     // Fill tiled texture
-                    tmpPainter.begin(&tmpPixmap);
+                    tmpPainter.begin(&tmpImage);
                     tmpPainter.setOpacity(alpha);
                     if (it.width() < it.height()) {
-                        tmpPainter.drawTiledPixmap(tmpImageFrame, rotatedPixmap, QPointF(translatedRect.top(), translatedRect.left()));
+                        drawTiledImage(tmpPainter, tmpImageFrame, rotatedImage, QPointF(translatedRect.top(), translatedRect.left()));
                     } else {
-                        tmpPainter.drawTiledPixmap(tmpImageFrame, pixmap, translatedRect.topLeft());
+                        drawTiledImage(tmpPainter, tmpImageFrame, image, translatedRect.topLeft());
                     }
                     tmpPainter.setOpacity(1.0);
                     tmpPainter.end();
@@ -480,12 +466,12 @@ void TextureGenerator::generate()
                     gradient.setColorAt(0.0, findNeighborColor->second);
                     gradient.setColorAt(1.0, Qt::transparent);
                     
-                    tmpPainter.begin(&tmpPixmap);
+                    tmpPainter.begin(&tmpImage);
                     tmpPainter.setCompositionMode(QPainter::CompositionMode_DestinationIn);
                     tmpPainter.fillRect(tmpImageFrame, gradient);
                     tmpPainter.end();
                     
-                    texturePainter.drawPixmap(translatedRect, tmpPixmap, tmpImageFrame);
+                    texturePainter.drawImage(translatedRect, tmpImage, tmpImageFrame);
                 } else {
                     QRadialGradient gradient(QPointF(middlePoint.x() * TextureGenerator::m_textureSize,
                         middlePoint.y() * TextureGenerator::m_textureSize),
@@ -500,119 +486,110 @@ void TextureGenerator::generate()
         }
     };
     
-    std::map<std::pair<size_t, size_t>, std::tuple<size_t, size_t, size_t>> halfEdgeToTriangleMap;
-    for (size_t i = 0; i < m_outcome->triangles.size(); ++i) {
-        const auto &triangleIndices = m_outcome->triangles[i];
-        if (triangleIndices.size() != 3) {
-            qDebug() << "Found invalid triangle indices";
-            continue;
-        }
-        for (size_t j = 0; j < triangleIndices.size(); ++j) {
-            size_t k = (j + 1) % triangleIndices.size();
-            halfEdgeToTriangleMap.insert(std::make_pair(std::make_pair(triangleIndices[j], triangleIndices[k]),
-                std::make_tuple(i, j, k)));
-        }
-    }
-    for (const auto &it: halfEdgeToTriangleMap) {
-        auto oppositeHalfEdge = std::make_pair(it.first.second, it.first.first);
-        const auto &opposite = halfEdgeToTriangleMap.find(oppositeHalfEdge);
-        if (opposite == halfEdgeToTriangleMap.end())
-            continue;
-        const std::pair<QUuid, QUuid> &source = triangleSourceNodes[std::get<0>(it.second)];
-        const std::pair<QUuid, QUuid> &oppositeSource = triangleSourceNodes[std::get<0>(opposite->second)];
-        if (source.first == oppositeSource.first)
-            continue;
-        drawBySolubility(source.first, std::get<0>(it.second), std::get<1>(it.second), std::get<2>(it.second), oppositeSource.first);
-        drawBySolubility(oppositeSource.first, std::get<0>(opposite->second), std::get<1>(opposite->second), std::get<2>(opposite->second), source.first);
-    }
+    // Each map is painted with its own painter on its own image, so they do not depend on each other
+    std::vector<std::function<void ()>> paintTasks;
     
-    // Draw belly white
-    texturePainter.setCompositionMode(QPainter::CompositionMode_SoftLight);
-    for (size_t triangleIndex = 0; triangleIndex < m_outcome->triangles.size(); ++triangleIndex) {
-        const auto &normal = triangleNormals[triangleIndex];
-        const std::pair<QUuid, QUuid> &source = triangleSourceNodes[triangleIndex];
-        const auto &partId = source.first;
-        if (m_countershadedPartIds.find(partId) == m_countershadedPartIds.end())
-            continue;
-        
-        const auto &allRects = partUvRects.find(partId);
-        if (allRects == partUvRects.end()) {
-            qDebug() << "Found part uv rects failed";
-            continue;
-        }
+    paintTasks.push_back([&]() {
+        m_resultTextureColorImage = createTextureImage(m_hasTransparencySettings ? m_defaultTextureColor : Qt::white);
+        beginPainter(texturePainter, m_resultTextureColorImage);
+        texturePainter.setPen(Qt::NoPen);
         
-        const auto &findOutcomeNode = nodeMap.find(source);
-        if (findOutcomeNode == nodeMap.end())
-            continue;
-        const OutcomeNode *outcomeNode = findOutcomeNode->second;
-        if (qAbs(QVector3D::dotProduct(outcomeNode->direction, QVector3D(0, 1, 0))) >= 0.707) {
-            if (QVector3D::dotProduct(normal, QVector3D(0, 0, 1)) <= 0.0)
-                continue;
-        } else {
-            if (QVector3D::dotProduct(normal, QVector3D(0, -1, 0)) <= 0.0)
-                continue;
+        for (const auto &it: partUvRects) {
+            const auto &partId = it.first;
+            const auto &rects = it.second;
+            auto findSourceColorResult = partColorMap.find(partId);
+            if (findSourceColorResult != partColorMap.end()) {
+                const auto &color = findSourceColorResult->second;
+                QBrush brush(color);
+                float fillExpandSize = 2;
+                for (const auto &rect: rects) {
+                    QRectF translatedRect = {
+                        rect.left() * TextureGenerator::m_textureSize - fillExpandSize,
+                        rect.top() * TextureGenerator::m_textureSize - fillExpandSize,
+                        rect.width() * TextureGenerator::m_textureSize + fillExpandSize * 2,
+                        rect.height() * TextureGenerator::m_textureSize + fillExpandSize * 2
+                    };
+                    texturePainter.fillRect(translatedRect, brush);
+                }
+            }
         }
         
-        const auto &triangleIndices = m_outcome->triangles[triangleIndex];
-        if (triangleIndices.size() != 3) {
-            qDebug() << "Found invalid triangle indices";
-            continue;
-        }
+        prepareTiledTextureImage(m_partColorTextureMap, partColorTextureImages);
+        drawTexture(partColorTextureImages, texturePainter, true);
         
-        const std::vector<QVector2D> &uv = triangleVertexUvs[triangleIndex];
-        QVector2D middlePoint = (uv[0] + uv[1] + uv[2]) / 3.0;
-        float finalRadius = (uv[0].distanceToPoint(uv[1]) +
-            uv[1].distanceToPoint(uv[2]) +
-            uv[2].distanceToPoint(uv[0])) / 3.0;
-        QRadialGradient gradient(QPointF(middlePoint.x() * TextureGenerator::m_textureSize,
-            middlePoint.y() * TextureGenerator::m_textureSize),
-            finalRadius * TextureGenerator::m_textureSize);
-        gradient.setColorAt(0.0, Qt::white);
-        gradient.setColorAt(1.0, Qt::transparent);
-        for (const auto &it: allRects->second) {
-            if (it.contains(middlePoint.x(), middlePoint.y())) {
-                QRectF fillTarget((middlePoint.x() - finalRadius),
-                    (middlePoint.y() - finalRadius),
-                    (finalRadius + finalRadius),
-                    (finalRadius + finalRadius));
-                auto clippedRect = it.intersected(fillTarget);
-                QRectF translatedRect = {
-                    clippedRect.left() * TextureGenerator::m_textureSize,
-                    clippedRect.top() * TextureGenerator::m_textureSize,
-                    clippedRect.width() * TextureGenerator::m_textureSize,
-                    clippedRect.height() * TextureGenerator::m_textureSize
-                };
-                texturePainter.fillRect(translatedRect, gradient);
+        std::map<std::pair<size_t, size_t>, std::tuple<size_t, size_t, size_t>> halfEdgeToTriangleMap;
+        for (size_t i = 0; i < m_outcome->triangles.size(); ++i) {
+            const auto &triangleIndices = m_outcome->triangles[i];
+            if (triangleIndices.size() != 3) {
+                qDebug() << "Found invalid triangle indices";
+                continue;
+            }
+            for (size_t j = 0; j < triangleIndices.size(); ++j) {
+                size_t k = (j + 1) % triangleIndices.size();
+                halfEdgeToTriangleMap.insert(std::make_pair(std::make_pair(triangleIndices[j], triangleIndices[k]),
+                    std::make_tuple(i, j, k)));
             }
         }
-        
-        // Fill the neighbor halfedges
-        for (int i = 0; i < 3; ++i) {
-            int j = (i + 1) % 3;
-            auto oppositeHalfEdge = std::make_pair(triangleIndices[j], triangleIndices[i]);
+        for (const auto &it: halfEdgeToTriangleMap) {
+            auto oppositeHalfEdge = std::make_pair(it.first.second, it.first.first);
             const auto &opposite = halfEdgeToTriangleMap.find(oppositeHalfEdge);
             if (opposite == halfEdgeToTriangleMap.end())
                 continue;
-            auto oppositeTriangleIndex = std::get<0>(opposite->second);
-            const std::pair<QUuid, QUuid> &oppositeSource = triangleSourceNodes[oppositeTriangleIndex];
-            if (partId == oppositeSource.first)
+            const std::pair<QUuid, QUuid> &source = triangleSourceNodes[std::get<0>(it.second)];
+            const std::pair<QUuid, QUuid> &oppositeSource = triangleSourceNodes[std::get<0>(opposite->second)];
+            if (source.first == oppositeSource.first)
+                continue;
+            drawBySolubility(source.first, std::get<0>(it.second), std::get<1>(it.second), std::get<2>(it.second), oppositeSource.first);
+            drawBySolubility(oppositeSource.first, std::get<0>(opposite->second), std::get<1>(opposite->second), std::get<2>(opposite->second), source.first);
+        }
+        
+        // Draw belly white
+        texturePainter.setCompositionMode(QPainter::CompositionMode_SoftLight);
+        for (size_t triangleIndex = 0; triangleIndex < m_outcome->triangles.size(); ++triangleIndex) {
+            const auto &normal = triangleNormals[triangleIndex];
+            const std::pair<QUuid, QUuid> &source = triangleSourceNodes[triangleIndex];
+            const auto &partId = source.first;
+            if (m_countershadedPartIds.find(partId) == m_countershadedPartIds.end())
                 continue;
-            const auto &oppositeAllRects = partUvRects.find(oppositeSource.first);
-            if (oppositeAllRects == partUvRects.end()) {
+        
+            const auto &allRects = partUvRects.find(partId);
+            if (allRects == partUvRects.end()) {
                 qDebug() << "Found part uv rects failed";
                 continue;
             }
-            const std::vector<QVector2D> &oppositeUv = triangleVertexUvs[oppositeTriangleIndex];
-            QVector2D oppositeMiddlePoint = (oppositeUv[std::get<1>(opposite->second)] + oppositeUv[std::get<2>(opposite->second)]) * 0.5;
-            QRadialGradient oppositeGradient(QPointF(oppositeMiddlePoint.x() * TextureGenerator::m_textureSize,
-                oppositeMiddlePoint.y() * TextureGenerator::m_textureSize),
+        
+            const auto &findOutcomeNode = nodeMap.find(source);
+            if (findOutcomeNode == nodeMap.end())
+                continue;
+            const OutcomeNode *outcomeNode = findOutcomeNode->second;
+            if (qAbs(QVector3D::dotProduct(outcomeNode->direction, QVector3D(0, 1, 0))) >= 0.707) {
+                if (QVector3D::dotProduct(normal, QVector3D(0, 0, 1)) <= 0.0)
+                    continue;
+            } else {
+                if (QVector3D::dotProduct(normal, QVector3D(0, -1, 0)) <= 0.0)
+                    continue;
+            }
+        
+            const auto &triangleIndices = m_outcome->triangles[triangleIndex];
+            if (triangleIndices.size() != 3) {
+                qDebug() << "Found invalid triangle indices";
+                continue;
+            }
+        
+            const std::vector<QVector2D> &uv = triangleVertexUvs[triangleIndex];
+            QVector2D middlePoint = (uv[0] + uv[1] + uv[2]) / 3.0;
+            float finalRadius = (uv[0].distanceToPoint(uv[1]) +
+                uv[1].distanceToPoint(uv[2]) +
+                uv[2].distanceToPoint(uv[0])) / 3.0;
+            QRadialGradient gradient(QPointF(middlePoint.x() * TextureGenerator::m_textureSize,
+                middlePoint.y() * TextureGenerator::m_textureSize),
                 finalRadius * TextureGenerator::m_textureSize);
-            oppositeGradient.setColorAt(0.0, Qt::white);
-            oppositeGradient.setColorAt(1.0, Qt::transparent);
-            for (const auto &it: oppositeAllRects->second) {
-                if (it.contains(oppositeMiddlePoint.x(), oppositeMiddlePoint.y())) {
-                    QRectF fillTarget((oppositeMiddlePoint.x() - finalRadius),
-                        (oppositeMiddlePoint.y() - finalRadius),
+            gradient.setColorAt(0.0, Qt::white);
+            gradient.setColorAt(1.0, Qt::transparent);
+            for (const auto &it: allRects->second) {
+                if (it.contains(middlePoint.x(), middlePoint.y())) {
+                    QRectF fillTarget((middlePoint.x() - finalRadius),
+                        (middlePoint.y() - finalRadius),
                         (finalRadius + finalRadius),
                         (finalRadius + finalRadius));
                     auto clippedRect = it.intersected(fillTarget);
@@ -622,74 +599,119 @@ void TextureGenerator::generate()
                         clippedRect.width() * TextureGenerator::m_textureSize,
                         clippedRect.height() * TextureGenerator::m_textureSize
                     };
-                    texturePainter.fillRect(translatedRect, oppositeGradient);
+                    texturePainter.fillRect(translatedRect, gradient);
+                }
+            }
+        
+            // Fill the neighbor halfedges
+            for (int i = 0; i < 3; ++i) {
+                int j = (i + 1) % 3;
+                auto oppositeHalfEdge = std::make_pair(triangleIndices[j], triangleIndices[i]);
+                const auto &opposite = halfEdgeToTriangleMap.find(oppositeHalfEdge);
+                if (opposite == halfEdgeToTriangleMap.end())
+                    continue;
+                auto oppositeTriangleIndex = std::get<0>(opposite->second);
+                const std::pair<QUuid, QUuid> &oppositeSource = triangleSourceNodes[oppositeTriangleIndex];
+                if (partId == oppositeSource.first)
+                    continue;
+                const auto &oppositeAllRects = partUvRects.find(oppositeSource.first);
+                if (oppositeAllRects == partUvRects.end()) {
+                    qDebug() << "Found part uv rects failed";
+                    continue;
+                }
+                const std::vector<QVector2D> &oppositeUv = triangleVertexUvs[oppositeTriangleIndex];
+                QVector2D oppositeMiddlePoint = (oppositeUv[std::get<1>(opposite->second)] + oppositeUv[std::get<2>(opposite->second)]) * 0.5;
+                QRadialGradient oppositeGradient(QPointF(oppositeMiddlePoint.x() * TextureGenerator::m_textureSize,
+                    oppositeMiddlePoint.y() * TextureGenerator::m_textureSize),
+                    finalRadius * TextureGenerator::m_textureSize);
+                oppositeGradient.setColorAt(0.0, Qt::white);
+                oppositeGradient.setColorAt(1.0, Qt::transparent);
+                for (const auto &it: oppositeAllRects->second) {
+                    if (it.contains(oppositeMiddlePoint.x(), oppositeMiddlePoint.y())) {
+                        QRectF fillTarget((oppositeMiddlePoint.x() - finalRadius),
+                            (oppositeMiddlePoint.y() - finalRadius),
+                            (finalRadius + finalRadius),
+                            (finalRadius + finalRadius));
+                        auto clippedRect = it.intersected(fillTarget);
+                        QRectF translatedRect = {
+                            clippedRect.left() * TextureGenerator::m_textureSize,
+                            clippedRect.top() * TextureGenerator::m_textureSize,
+                            clippedRect.width() * TextureGenerator::m_textureSize,
+                            clippedRect.height() * TextureGenerator::m_textureSize
+                        };
+                        texturePainter.fillRect(translatedRect, oppositeGradient);
+                    }
                 }
             }
         }
-    }
-    
-    hasNormalMap = !m_partNormalTextureMap.empty();
-    hasMetalnessMap = !m_partMetalnessTextureMap.empty();
-    hasRoughnessMap = !m_partRoughnessTextureMap.empty();
-    hasAmbientOcclusionMap = !m_partAmbientOcclusionTextureMap.empty();
-    
-    auto paintTextureEndTime = countTimeConsumed.elapsed();
-    
-    pen.setWidth(0);
-    textureBorderPainter.setPen(pen);
-    auto paintBorderBeginTime = countTimeConsumed.elapsed();
-    for (auto i = 0u; i < triangleVertexUvs.size(); i++) {
-        const std::vector<QVector2D> &uv = triangleVertexUvs[i];
-        for (auto j = 0; j < 3; j++) {
-            int from = j;
-            int to = (j + 1) % 3;
-            textureBorderPainter.drawLine(uv[from][0] * TextureGenerator::m_textureSize, uv[from][1] * TextureGenerator::m_textureSize,
-                uv[to][0] * TextureGenerator::m_textureSize, uv[to][1] * TextureGenerator::m_textureSize);
+        
+        texturePainter.end();
+    });
+    
+    paintTasks.push_back([&]() {
+        m_resultTextureBorderImage = createTextureImage(Qt::transparent);
+        QPainter textureBorderPainter;
+        beginPainter(textureBorderPainter, m_resultTextureBorderImage);
+        QPen pen(Qt::darkGray);
+        pen.setWidth(0);
+        textureBorderPainter.setPen(pen);
+        for (auto i = 0u; i < triangleVertexUvs.size(); i++) {
+            const std::vector<QVector2D> &uv = triangleVertexUvs[i];
+            for (auto j = 0; j < 3; j++) {
+                int from = j;
+                int to = (j + 1) % 3;
+                textureBorderPainter.drawLine(uv[from][0] * TextureGenerator::m_textureSize, uv[from][1] * TextureGenerator::m_textureSize,
+                    uv[to][0] * TextureGenerator::m_textureSize, uv[to][1] * TextureGenerator::m_textureSize);
+            }
         }
-    }
-    auto paintBorderEndTime = countTimeConsumed.elapsed();
-    
-    texturePainter.end();
-    textureBorderPainter.end();
-    textureNormalPainter.end();
-    textureMetalnessPainter.end();
-    textureRoughnessPainter.end();
-    textureAmbientOcclusionPainter.end();
+        textureBorderPainter.end();
+    });
+    
+    auto addMapPaintTask = [&](const std::map<QUuid, std::pair<QImage, float>> &sourceMap, QImage **image, const QColor &color) {
+        const auto *sourceMapPointer = &sourceMap;
+        paintTasks.push_back([&, sourceMapPointer, image, color]() {
+            *image = createTextureImage(color);
+            std::map<QUuid, std::pair<QImage, QImage>> tiledTextureImages;
+            prepareTiledTextureImage(*sourceMapPointer, tiledTextureImages);
+            QPainter painter;
+            beginPainter(painter, *image);
+            drawTexture(tiledTextureImages, painter, false);
+            painter.end();
+        });
+    };
     
-    if (!hasNormalMap) {
-        delete m_resultTextureNormalImage;
-        m_resultTextureNormalImage = nullptr;
+    // Maps which would be thrown away are not painted at all
+    if (hasNormalMap)
+        addMapPaintTask(m_partNormalTextureMap, &m_resultTextureNormalImage, QColor(128, 128, 255));
+    if (hasMetalnessRoughnessAmbientOcclusionMap) {
+        if (hasMetalnessMap)
+            addMapPaintTask(m_partMetalnessTextureMap, &m_resultTextureMetalnessImage, Qt::black);
+        if (hasRoughnessMap)
+            addMapPaintTask(m_partRoughnessTextureMap, &m_resultTextureRoughnessImage, Qt::white);
+        if (hasAmbientOcclusionMap)
+            addMapPaintTask(m_partAmbientOcclusionTextureMap, &m_resultTextureAmbientOcclusionImage, Qt::white);
+    } else {
+        m_resultTextureMetalnessImage = createTextureImage(Qt::black);
+        m_resultTextureRoughnessImage = createTextureImage(Qt::white);
+        m_resultTextureAmbientOcclusionImage = createTextureImage(Qt::white);
     }
     
+    auto paintTextureBeginTime = countTimeConsumed.elapsed();
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, paintTasks.size(), 1),
+        [&](const tbb::blocked_range<size_t> &range) {
+            for (size_t i = range.begin(); i != range.end(); ++i)
+                paintTasks[i]();
+        });
+    auto paintTextureEndTime = countTimeConsumed.elapsed();
+    
     auto mergeMetalnessRoughnessAmbientOcclusionBeginTime = countTimeConsumed.elapsed();
-    if (!hasMetalnessMap && !hasRoughnessMap && !hasAmbientOcclusionMap) {
-        delete m_resultTextureMetalnessRoughnessAmbientOcclusionImage;
-        m_resultTextureMetalnessRoughnessAmbientOcclusionImage = nullptr;
-    } else {
-        for (int row = 0; row < m_resultTextureMetalnessRoughnessAmbientOcclusionImage->height(); ++row) {
-            for (int col = 0; col < m_resultTextureMetalnessRoughnessAmbientOcclusionImage->width(); ++col) {
-                QColor color(255, 255, 0);
-                if (hasMetalnessMap)
-                    color.setBlue(qGray(m_resultTextureMetalnessImage->pixel(col, row)));
-                if (hasRoughnessMap)
-                    color.setGreen(qGray(m_resultTextureRoughnessImage->pixel(col, row)));
-                if (hasAmbientOcclusionMap)
-                    color.setRed(qGray(m_resultTextureAmbientOcclusionImage->pixel(col, row)));
-                m_resultTextureMetalnessRoughnessAmbientOcclusionImage->setPixelColor(col, row, color);
-            }
-        }
-        if (!hasMetalnessMap) {
-            delete m_resultTextureMetalnessImage;
-            m_resultTextureMetalnessImage = nullptr;
-        }
-        if (!hasRoughnessMap) {
-            delete m_resultTextureRoughnessImage;
-            m_resultTextureRoughnessImage = nullptr;
-        }
-        if (!hasAmbientOcclusionMap) {
-            delete m_resultTextureAmbientOcclusionImage;
-            m_resultTextureAmbientOcclusionImage = nullptr;
-        }
+    if (hasMetalnessRoughnessAmbientOcclusionMap) {
+        m_resultTextureMetalnessRoughnessAmbientOcclusionImage = new QImage(TextureGenerator::m_textureSize, TextureGenerator::m_textureSize, QImage::Format_ARGB32);
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, TextureGenerator::m_textureSize),
+            MetalnessRoughnessAmbientOcclusionMerger(m_resultTextureMetalnessImage,
+                m_resultTextureRoughnessImage,
+                m_resultTextureAmbientOcclusionImage,
+                m_resultTextureMetalnessRoughnessAmbientOcclusionImage));
     }
     auto mergeMetalnessRoughnessAmbientOcclusionEndTime = countTimeConsumed.elapsed();
     
@@ -725,9 +747,7 @@ void TextureGenerator::generate()
     auto createResultEndTime = countTimeConsumed.elapsed();
     
     qDebug() << "The texture[" << TextureGenerator::m_textureSize << "x" << TextureGenerator::m_textureSize << "] generation took" << countTimeConsumed.elapsed() << "milliseconds";
-    qDebug() << "   :create image took" << (createImageEndTime - createImageBeginTime) << "milliseconds";
-    qDebug() << "   :paint texture took" << (paintTextureEndTime - paintTextureBeginTime) << "milliseconds";
-    qDebug() << "   :paint border took" << (paintBorderEndTime - paintBorderBeginTime) << "milliseconds";
+    qDebug() << "   :paint texture and border took" << (paintTextureEndTime - paintTextureBeginTime) << "milliseconds";
     qDebug() << "   :merge metalness, roughness, and ambient occlusion texture took" << (mergeMetalnessRoughnessAmbientOcclusionEndTime - mergeMetalnessRoughnessAmbientOcclusionBeginTime) << "milliseconds";
     qDebug() << "   :create result took" << (createResultEndTime - createResultBeginTime) << "milliseconds";
 }
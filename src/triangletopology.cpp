@@ -0,0 +1,80 @@
+#include <algorithm>
+#include "triangletopology.h"
+
+TriangleTopology::TriangleTopology(const std::vector<std::vector<size_t>> &triangles, size_t vertexCount)
+{
+    m_halfEdges.reserve(triangles.size() * 3);
+    m_vertexCornerOffsets.resize(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        const auto &triangle = triangles[i];
+        if (triangle.size() != 3)
+            continue;
+        for (size_t j = 0; j < 3; ++j) {
+            size_t k = (j + 1) % 3;
+            size_t l = (j + 2) % 3;
+            m_halfEdges.push_back({makeKey(triangle[j], triangle[k]), (uint32_t)i, (uint32_t)triangle[l]});
+            if (triangle[j] < vertexCount)
+                ++m_vertexCornerOffsets[triangle[j] + 1];
+        }
+    }
+
+    // Duplicated half edges only happen on non-manifold input, the last one wins as it did with std::map insertion
+    std::stable_sort(m_halfEdges.begin(), m_halfEdges.end(), [](const HalfEdge &first, const HalfEdge &second) {
+        return first.key < second.key;
+    });
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < m_halfEdges.size(); ++i) {
+        if (i + 1 < m_halfEdges.size() && m_halfEdges[i + 1].key == m_halfEdges[i].key)
+            continue;
+        m_halfEdges[uniqueCount++] = m_halfEdges[i];
+    }
+    m_halfEdges.resize(uniqueCount);
+
+    for (size_t i = 1; i < m_vertexCornerOffsets.size(); ++i)
+        m_vertexCornerOffsets[i] += m_vertexCornerOffsets[i - 1];
+    m_vertexCorners.resize(m_vertexCornerOffsets[vertexCount]);
+    std::vector<uint32_t> fillPositions(m_vertexCornerOffsets.begin(), m_vertexCornerOffsets.end() - 1);
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        const auto &triangle = triangles[i];
+        if (triangle.size() != 3)
+            continue;
+        for (size_t j = 0; j < 3; ++j) {
+            if (triangle[j] >= vertexCount)
+                continue;
+            m_vertexCorners[fillPositions[triangle[j]]++] = {(uint32_t)i, (uint32_t)j};
+        }
+    }
+}
+
+const std::vector<TriangleTopology::HalfEdge> &TriangleTopology::halfEdges() const
+{
+    return m_halfEdges;
+}
+
+const TriangleTopology::HalfEdge *TriangleTopology::findHalfEdge(size_t from, size_t to) const
+{
+    uint64_t key = makeKey(from, to);
+    auto findResult = std::lower_bound(m_halfEdges.begin(), m_halfEdges.end(), key, [](const HalfEdge &halfEdge, uint64_t key) {
+        return halfEdge.key < key;
+    });
+    if (findResult == m_halfEdges.end() || findResult->key != key)
+        return nullptr;
+    return &(*findResult);
+}
+
+size_t TriangleTopology::vertexTriangleCount(size_t vertexIndex) const
+{
+    if (vertexIndex + 1 >= m_vertexCornerOffsets.size())
+        return 0;
+    return m_vertexCornerOffsets[vertexIndex + 1] - m_vertexCornerOffsets[vertexIndex];
+}
+
+const TriangleTopology::Corner *TriangleTopology::vertexCornersBegin(size_t vertexIndex) const
+{
+    return m_vertexCorners.data() + m_vertexCornerOffsets[vertexIndex];
+}
+
+const TriangleTopology::Corner *TriangleTopology::vertexCornersEnd(size_t vertexIndex) const
+{
+    return m_vertexCorners.data() + m_vertexCornerOffsets[vertexIndex + 1];
+}
@@ -0,0 +1,54 @@
+#ifndef DUST3D_TRIANGLE_TOPOLOGY_H
+#define DUST3D_TRIANGLE_TOPOLOGY_H
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Flat adjacency of a triangle mesh, built once and shared by the routines
+// which used to build their own std::map based edge maps.
+// Half edges are kept sorted by (from, to), so iterating them visits the same
+// order as a std::map<std::pair<size_t, size_t>, ...> would.
+class TriangleTopology
+{
+public:
+    struct HalfEdge
+    {
+        uint64_t key;
+        uint32_t triangleIndex;
+        uint32_t oppositeVertex;
+
+        size_t from() const
+        {
+            return (size_t)(key >> 32);
+        }
+        size_t to() const
+        {
+            return (size_t)(key & 0xffffffff);
+        }
+    };
+
+    struct Corner
+    {
+        uint32_t triangleIndex;
+        uint32_t cornerIndex;
+    };
+
+    TriangleTopology(const std::vector<std::vector<size_t>> &triangles, size_t vertexCount);
+    const std::vector<HalfEdge> &halfEdges() const;
+    const HalfEdge *findHalfEdge(size_t from, size_t to) const;
+    size_t vertexTriangleCount(size_t vertexIndex) const;
+    const Corner *vertexCornersBegin(size_t vertexIndex) const;
+    const Corner *vertexCornersEnd(size_t vertexIndex) const;
+
+    static uint64_t makeKey(size_t from, size_t to)
+    {
+        return ((uint64_t)from << 32) | (uint64_t)(uint32_t)to;
+    }
+
+private:
+    std::vector<HalfEdge> m_halfEdges;
+    std::vector<uint32_t> m_vertexCornerOffsets;
+    std::vector<Corner> m_vertexCorners;
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include "util.h"
 #include "version.h"
+#include "triangletopology.h"
 
 QString valueOfKeyInMapOrEmpty(const std::map<QString, QString> &map, const QString &key)
 {
@@ -148,7 +149,19 @@ void angleSmooth(const std::vector<QVector3D> &vertices,
     float thresholdAngleDegrees,
     std::vector<QVector3D> &triangleVertexNormals)
 {
-    std::vector<std::vector<std::pair<size_t, size_t>>> triangleVertexNormalsMapByIndices(vertices.size());
+    TriangleTopology topology(triangles, vertices.size());
+    angleSmooth(vertices, triangles, topology, triangleNormals, thresholdAngleDegrees, triangleVertexNormals);
+}
+
+void angleSmooth(const std::vector<QVector3D> &vertices,
+    const std::vector<std::vector<size_t>> &triangles,
+    const TriangleTopology &topology,
+    const std::vector<QVector3D> &triangleNormals,
+    float thresholdAngleDegrees,
+    std::vector<QVector3D> &triangleVertexNormals)
+{
+    const size_t noneSlot = std::numeric_limits<size_t>::max();
+    std::vector<size_t> cornerSlots(triangles.size() * 3, noneSlot);
     std::vector<QVector3D> angleAreaWeightedNormals;
     for (size_t triangleIndex = 0; triangleIndex < triangles.size(); ++triangleIndex) {
         const auto &sourceTriangle = triangles[triangleIndex];
@@ -168,31 +181,25 @@ void angleSmooth(const std::vector<QVector3D> &vertices,
                 qDebug() << "Invalid vertex index" << sourceTriangle[i] << "vertices size" << vertices.size();
                 continue;
             }
-            triangleVertexNormalsMapByIndices[sourceTriangle[i]].push_back({triangleIndex, angleAreaWeightedNormals.size()});
+            cornerSlots[triangleIndex * 3 + i] = angleAreaWeightedNormals.size();
             angleAreaWeightedNormals.push_back(triangleNormals[triangleIndex] * area * angles[i]);
         }
     }
     triangleVertexNormals = angleAreaWeightedNormals;
-    std::map<std::pair<size_t, size_t>, float> degreesBetweenFacesMap;
     for (size_t vertexIndex = 0; vertexIndex < vertices.size(); ++vertexIndex) {
-        const auto &triangleVertices = triangleVertexNormalsMapByIndices[vertexIndex];
-        for (const auto &triangleVertex: triangleVertices) {
-            for (const auto &otherTriangleVertex: triangleVertices) {
-                if (triangleVertex.first == otherTriangleVertex.first)
+        const auto *cornersBegin = topology.vertexCornersBegin(vertexIndex);
+        const auto *cornersEnd = topology.vertexCornersEnd(vertexIndex);
+        for (const auto *corner = cornersBegin; corner != cornersEnd; ++corner) {
+            size_t slot = cornerSlots[corner->triangleIndex * 3 + corner->cornerIndex];
+            for (const auto *otherCorner = cornersBegin; otherCorner != cornersEnd; ++otherCorner) {
+                if (corner->triangleIndex == otherCorner->triangleIndex)
                     continue;
-                float degrees = 0;
-                auto findDegreesResult = degreesBetweenFacesMap.find({triangleVertex.first, otherTriangleVertex.first});
-                if (findDegreesResult == degreesBetweenFacesMap.end()) {
-                    degrees = degreesBetweenVectors(triangleNormals[triangleVertex.first], triangleNormals[otherTriangleVertex.first]);
-                    degreesBetweenFacesMap.insert({{triangleVertex.first, otherTriangleVertex.first}, degrees});
-                    degreesBetweenFacesMap.insert({{otherTriangleVertex.first, triangleVertex.first}, degrees});
-                } else {
-                    degrees = findDegreesResult->second;
-                }
+                // The angle is symmetric, recalculating is cheaper than looking up a cache of face pairs
+                float degrees = degreesBetweenVectors(triangleNormals[corner->triangleIndex], triangleNormals[otherCorner->triangleIndex]);
                 if (degrees > thresholdAngleDegrees) {
                     continue;
                 }
-                triangleVertexNormals[triangleVertex.second] += angleAreaWeightedNormals[otherTriangleVertex.second];
+                triangleVertexNormals[slot] += angleAreaWeightedNormals[cornerSlots[otherCorner->triangleIndex * 3 + otherCorner->cornerIndex]];
             }
         }
     }
@@ -201,46 +208,43 @@ void angleSmooth(const std::vector<QVector3D> &vertices,
 }
 
 void recoverQuads(const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &triangles, const std::set<std::pair<PositionKey, PositionKey>> &sharedQuadEdges, std::vector<std::vector<size_t>> &triangleAndQuads)
+{
+    TriangleTopology topology(triangles, vertices.size());
+    recoverQuads(vertices, triangles, topology, sharedQuadEdges, triangleAndQuads);
+}
+
+void recoverQuads(const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &triangles, const TriangleTopology &topology, const std::set<std::pair<PositionKey, PositionKey>> &sharedQuadEdges, std::vector<std::vector<size_t>> &triangleAndQuads)
 {
     std::vector<PositionKey> verticesPositionKeys;
+    verticesPositionKeys.reserve(vertices.size());
     for (const auto &position: vertices) {
         verticesPositionKeys.push_back(PositionKey(position));
     }
-    std::map<std::pair<size_t, size_t>, std::pair<size_t, size_t>> triangleEdgeMap;
-    for (size_t i = 0; i < triangles.size(); i++) {
-        const auto &faceIndices = triangles[i];
-        if (faceIndices.size() == 3) {
-            triangleEdgeMap[std::make_pair(faceIndices[0], faceIndices[1])] = std::make_pair(i, faceIndices[2]);
-            triangleEdgeMap[std::make_pair(faceIndices[1], faceIndices[2])] = std::make_pair(i, faceIndices[0]);
-            triangleEdgeMap[std::make_pair(faceIndices[2], faceIndices[0])] = std::make_pair(i, faceIndices[1]);
-        }
-    }
-    std::unordered_set<size_t> unionedFaces;
-    std::vector<std::vector<size_t>> newUnionedFaceIndices;
-    for (const auto &edge: triangleEdgeMap) {
-        if (unionedFaces.find(edge.second.first) != unionedFaces.end())
+    std::vector<bool> unionedFaces(triangles.size(), false);
+    for (const auto &edge: topology.halfEdges()) {
+        if (unionedFaces[edge.triangleIndex])
             continue;
-        auto pair = std::make_pair(verticesPositionKeys[edge.first.first], verticesPositionKeys[edge.first.second]);
+        auto pair = std::make_pair(verticesPositionKeys[edge.from()], verticesPositionKeys[edge.to()]);
         if (sharedQuadEdges.find(pair) != sharedQuadEdges.end()) {
-            auto oppositeEdge = triangleEdgeMap.find(std::make_pair(edge.first.second, edge.first.first));
-            if (oppositeEdge == triangleEdgeMap.end()) {
+            const auto *oppositeEdge = topology.findHalfEdge(edge.to(), edge.from());
+            if (nullptr == oppositeEdge) {
                 qDebug() << "Find opposite edge failed";
             } else {
-                if (unionedFaces.find(oppositeEdge->second.first) == unionedFaces.end()) {
-                    unionedFaces.insert(edge.second.first);
-                    unionedFaces.insert(oppositeEdge->second.first);
+                if (!unionedFaces[oppositeEdge->triangleIndex]) {
+                    unionedFaces[edge.triangleIndex] = true;
+                    unionedFaces[oppositeEdge->triangleIndex] = true;
                     std::vector<size_t> indices;
-                    indices.push_back(edge.second.second);
-                    indices.push_back(edge.first.first);
-                    indices.push_back(oppositeEdge->second.second);
-                    indices.push_back(edge.first.second);
+                    indices.push_back(edge.oppositeVertex);
+                    indices.push_back(edge.from());
+                    indices.push_back(oppositeEdge->oppositeVertex);
+                    indices.push_back(edge.to());
                     triangleAndQuads.push_back(indices);
                 }
             }
         }
     }
     for (size_t i = 0; i < triangles.size(); i++) {
-        if (unionedFaces.find(i) == unionedFaces.end()) {
+        if (!unionedFaces[i]) {
             triangleAndQuads.push_back(triangles[i]);
         }
     }
@@ -250,37 +254,34 @@ size_t weldSeam(const std::vector<QVector3D> &sourceVertices, const std::vector<
     float allowedSmallestDistance, const std::set<PositionKey> &excludePositions,
     std::vector<QVector3D> &destVertices, std::vector<std::vector<size_t>> &destTriangles)
 {
-    std::unordered_set<int> excludeVertices;
+    TriangleTopology topology(sourceTriangles, sourceVertices.size());
+    return weldSeam(sourceVertices, sourceTriangles, topology, allowedSmallestDistance, excludePositions,
+        destVertices, destTriangles);
+}
+
+size_t weldSeam(const std::vector<QVector3D> &sourceVertices, const std::vector<std::vector<size_t>> &sourceTriangles,
+    const TriangleTopology &topology,
+    float allowedSmallestDistance, const std::set<PositionKey> &excludePositions,
+    std::vector<QVector3D> &destVertices, std::vector<std::vector<size_t>> &destTriangles)
+{
+    std::vector<bool> excludeVertices(sourceVertices.size(), false);
     for (size_t i = 0; i < sourceVertices.size(); ++i) {
         if (excludePositions.find(sourceVertices[i]) != excludePositions.end())
-            excludeVertices.insert(i);
+            excludeVertices[i] = true;
     }
     float squareOfAllowedSmallestDistance = allowedSmallestDistance * allowedSmallestDistance;
-    std::map<int, int> weldVertexToMap;
-    std::unordered_set<int> weldTargetVertices;
-    std::unordered_set<int> processedFaces;
-    std::map<std::pair<int, int>, std::pair<int, int>> triangleEdgeMap;
-    std::unordered_map<int, int> vertexAdjFaceCountMap;
-    for (int i = 0; i < (int)sourceTriangles.size(); i++) {
-        const auto &faceIndices = sourceTriangles[i];
-        if (faceIndices.size() == 3) {
-            vertexAdjFaceCountMap[faceIndices[0]]++;
-            vertexAdjFaceCountMap[faceIndices[1]]++;
-            vertexAdjFaceCountMap[faceIndices[2]]++;
-            triangleEdgeMap[std::make_pair(faceIndices[0], faceIndices[1])] = std::make_pair(i, faceIndices[2]);
-            triangleEdgeMap[std::make_pair(faceIndices[1], faceIndices[2])] = std::make_pair(i, faceIndices[0]);
-            triangleEdgeMap[std::make_pair(faceIndices[2], faceIndices[0])] = std::make_pair(i, faceIndices[1]);
-        }
-    }
+    const int noneVertex = -1;
+    std::vector<int> weldVertexToMap(sourceVertices.size(), noneVertex);
+    std::vector<bool> processedFaces(sourceTriangles.size(), false);
     for (int i = 0; i < (int)sourceTriangles.size(); i++) {
-        if (processedFaces.find(i) != processedFaces.end())
+        if (processedFaces[i])
             continue;
         const auto &faceIndices = sourceTriangles[i];
         if (faceIndices.size() == 3) {
             bool indicesSeamCheck[3] = {
-                excludeVertices.find(faceIndices[0]) == excludeVertices.end(),
-                excludeVertices.find(faceIndices[1]) == excludeVertices.end(),
-                excludeVertices.find(faceIndices[2]) == excludeVertices.end()
+                !excludeVertices[faceIndices[0]],
+                !excludeVertices[faceIndices[1]],
+                !excludeVertices[faceIndices[2]]
             };
             for (int j = 0; j < 3; j++) {
                 int next = (j + 1) % 3;
@@ -289,28 +290,25 @@ size_t weldSeam(const std::vector<QVector3D> &sourceVertices, const std::vector<
                     std::pair<int, int> edge = std::make_pair(faceIndices[j], faceIndices[next]);
                     int thirdVertexIndex = faceIndices[nextNext];
                     if ((sourceVertices[edge.first] - sourceVertices[edge.second]).lengthSquared() < squareOfAllowedSmallestDistance) {
-                        auto oppositeEdge = std::make_pair(edge.second, edge.first);
-                        auto findOppositeFace = triangleEdgeMap.find(oppositeEdge);
-                        if (findOppositeFace == triangleEdgeMap.end()) {
+                        const auto *findOppositeFace = topology.findHalfEdge(edge.second, edge.first);
+                        if (nullptr == findOppositeFace) {
                             qDebug() << "Find opposite edge failed";
                             continue;
                         }
-                        int oppositeFaceIndex = findOppositeFace->second.first;
+                        int oppositeFaceIndex = findOppositeFace->triangleIndex;
                         if (((sourceVertices[edge.first] - sourceVertices[thirdVertexIndex]).lengthSquared() <
                                     (sourceVertices[edge.second] - sourceVertices[thirdVertexIndex]).lengthSquared()) &&
-                                vertexAdjFaceCountMap[edge.second] <= 4 &&
-                                weldVertexToMap.find(edge.second) == weldVertexToMap.end()) {
+                                topology.vertexTriangleCount(edge.second) <= 4 &&
+                                noneVertex == weldVertexToMap[edge.second]) {
                             weldVertexToMap[edge.second] = edge.first;
-                            weldTargetVertices.insert(edge.first);
-                            processedFaces.insert(i);
-                            processedFaces.insert(oppositeFaceIndex);
+                            processedFaces[i] = true;
+                            processedFaces[oppositeFaceIndex] = true;
                             break;
-                        } else if (vertexAdjFaceCountMap[edge.first] <= 4 &&
-                                weldVertexToMap.find(edge.first) == weldVertexToMap.end()) {
+                        } else if (topology.vertexTriangleCount(edge.first) <= 4 &&
+                                noneVertex == weldVertexToMap[edge.first]) {
                             weldVertexToMap[edge.first] = edge.second;
-                            weldTargetVertices.insert(edge.second);
-                            processedFaces.insert(i);
-                            processedFaces.insert(oppositeFaceIndex);
+                            processedFaces[i] = true;
+                            processedFaces[oppositeFaceIndex] = true;
                             break;
                         }
                     }
@@ -320,7 +318,7 @@ size_t weldSeam(const std::vector<QVector3D> &sourceVertices, const std::vector<
     }
     int weldedCount = 0;
     int faceCountAfterWeld = 0;
-    std::map<int, int> oldToNewVerticesMap;
+    std::vector<int> oldToNewVerticesMap(sourceVertices.size(), noneVertex);
     for (int i = 0; i < (int)sourceTriangles.size(); i++) {
         const auto &faceIndices = sourceTriangles[i];
         std::vector<int> mappedFaceIndices;
@@ -329,10 +327,10 @@ size_t weldSeam(const std::vector<QVector3D> &sourceVertices, const std::vector<
             int finalIndex = index;
             int mapTimes = 0;
             while (mapTimes < 500) {
-                auto findMapResult = weldVertexToMap.find(finalIndex);
-                if (findMapResult == weldVertexToMap.end())
+                int mapTo = weldVertexToMap[finalIndex];
+                if (noneVertex == mapTo)
                     break;
-                finalIndex = findMapResult->second;
+                finalIndex = mapTo;
                 mapTimes++;
             }
             if (mapTimes >= 500) {
@@ -359,14 +357,14 @@ size_t weldSeam(const std::vector<QVector3D> &sourceVertices, const std::vector<
         faceCountAfterWeld++;
         std::vector<size_t> newFace;
         for (const auto &index: mappedFaceIndices) {
-            auto findMap = oldToNewVerticesMap.find(index);
-            if (findMap == oldToNewVerticesMap.end()) {
+            int mapTo = oldToNewVerticesMap[index];
+            if (noneVertex == mapTo) {
                 size_t newIndex = destVertices.size();
                 newFace.push_back(newIndex);
                 destVertices.push_back(sourceVertices[index]);
-                oldToNewVerticesMap.insert({index, newIndex});
+                oldToNewVerticesMap[index] = newIndex;
             } else {
-                newFace.push_back(findMap->second);
+                newFace.push_back(mapTo);
             }
         }
         destTriangles.push_back(newFace);
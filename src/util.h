@@ -9,6 +9,8 @@
 #include <set>
 #include "positionkey.h"
 
+class TriangleTopology;
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -35,8 +37,19 @@ void angleSmooth(const std::vector<QVector3D> &vertices,
     const std::vector<QVector3D> &triangleNormals,
     float thresholdAngleDegrees,
     std::vector<QVector3D> &triangleVertexNormals);
+void angleSmooth(const std::vector<QVector3D> &vertices,
+    const std::vector<std::vector<size_t>> &triangles,
+    const TriangleTopology &topology,
+    const std::vector<QVector3D> &triangleNormals,
+    float thresholdAngleDegrees,
+    std::vector<QVector3D> &triangleVertexNormals);
 void recoverQuads(const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &triangles, const std::set<std::pair<PositionKey, PositionKey>> &sharedQuadEdges, std::vector<std::vector<size_t>> &triangleAndQuads);
+void recoverQuads(const std::vector<QVector3D> &vertices, const std::vector<std::vector<size_t>> &triangles, const TriangleTopology &topology, const std::set<std::pair<PositionKey, PositionKey>> &sharedQuadEdges, std::vector<std::vector<size_t>> &triangleAndQuads);
+size_t weldSeam(const std::vector<QVector3D> &sourceVertices, const std::vector<std::vector<size_t>> &sourceTriangles,
+    float allowedSmallestDistance, const std::set<PositionKey> &excludePositions,
+    std::vector<QVector3D> &destVertices, std::vector<std::vector<size_t>> &destTriangles);
 size_t weldSeam(const std::vector<QVector3D> &sourceVertices, const std::vector<std::vector<size_t>> &sourceTriangles,
+    const TriangleTopology &topology,
     float allowedSmallestDistance, const std::set<PositionKey> &excludePositions,
     std::vector<QVector3D> &destVertices, std::vector<std::vector<size_t>> &destTriangles);
 bool isManifold(const std::vector<std::vector<size_t>> &faces);